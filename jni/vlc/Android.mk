@@ -87,8 +87,10 @@ LOCAL_SRC_FILES := \
     src/input/stream_demux.c \
     src/input/stream_filter.c \
     src/input/stream_memory.c \
+    src/input/standby.c \
     src/input/subtitles.c \
     src/input/var.c \
+    src/input/view.c \
     src/interface/dialog.c \
     src/interface/interface.c \
     src/interface/intf_eject.c \
@@ -190,6 +190,53 @@ LIBVLC_API int libvlc_media_player_is_playing ( libvlc_media_player_t *p_mi );
  */
 LIBVLC_API int libvlc_media_player_play ( libvlc_media_player_t *p_mi );
 
+/**
+ * Switch to another media and start playing it. Contrary to
+ * libvlc_media_player_set_media() followed by libvlc_media_player_play(),
+ * the video and audio outputs and the decoders of the previous media are
+ * kept alive and reused when possible (for decoders, when the new stream
+ * has the same codec and format), which makes channel changes much faster.
+ *
+ * \param p_mi the Media Player
+ * \param p_md the new Media (must not be NULL)
+ * \return 0 if playback started, or -1 on error.
+ */
+LIBVLC_API int libvlc_media_player_switch_media( libvlc_media_player_t *p_mi,
+                                                 libvlc_media_t *p_md );
+
+/**
+ * Keep a media connected in the background, reading its stream and caching
+ * its last group of pictures without decoding it. A later
+ * libvlc_media_player_switch_media() to the same media then starts from the
+ * cached data instead of connecting and probing again.
+ *
+ * \param p_mi the Media Player
+ * \param i_slot the standby slot (0 or 1, e.g. next and previous channel)
+ * \param p_md the Media to keep ready, or NULL to free the slot
+ * \return 0 on success, -1 on error.
+ */
+LIBVLC_API int libvlc_media_player_set_standby( libvlc_media_player_t *p_mi,
+                                                unsigned i_slot,
+                                                libvlc_media_t *p_md );
+
+/**
+ * Play one program of the transport stream played by another media player,
+ * without reading nor demuxing the stream again (e.g. preview thumbnails of
+ * the other services of a multiplex). The source player no longer outputs
+ * that program itself. The view ends with libvlc_media_player_stop(), or
+ * receives nothing anymore once the source is stopped. If the source cannot
+ * hand the program over (not a transport stream, or the program is already
+ * viewed), the view player reports libvlc_MediaPlayerEncounteredError.
+ *
+ * \param p_mi the Media Player to play the program with
+ * \param p_source the Media Player playing the transport stream
+ * \param i_program the program number
+ * \return 0 if playback started, or -1 on error.
+ */
+LIBVLC_API int libvlc_media_player_play_view( libvlc_media_player_t *p_mi,
+                                              libvlc_media_player_t *p_source,
+                                              int i_program );
+
 /**
  * Pause or resume (no effect if there is no media)
  *
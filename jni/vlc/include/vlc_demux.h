@@ -116,6 +116,11 @@ enum demux_query_e
      * -1 means all group, 0 default group (first es added) */
     DEMUX_SET_GROUP,            /* arg1= int, arg2=const vlc_list_t *   can fail */
 
+    /* DEMUX_SET_GROUP_OUTPUT sends the ES of a group (program) to another
+     * es_out than the demux one, whatever the selected group is. The es_out
+     * must stay valid until it is reset (NULL) or the demux is closed. */
+    DEMUX_SET_GROUP_OUTPUT,     /* arg1= int, arg2= es_out_t *  can fail */
+
     /* Ask the demux to demux until the given date at the next pf_demux call
      * but not more (and not less, at the precision available of course).
      * XXX: not mandatory (except for subtitle demux) but I will help a lot
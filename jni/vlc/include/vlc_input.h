@@ -258,6 +258,16 @@ typedef struct input_thread_private_t input_thread_private_t;
  */
 typedef struct input_resource_t input_resource_t;
 
+/**
+ * This defines an opaque standby input handler.
+ */
+typedef struct input_standby_t input_standby_t;
+
+/**
+ * This defines an opaque input view handler.
+ */
+typedef struct input_view_t input_view_t;
+
 /**
  * Main structure representing an input thread. This structure is mostly
  * private. The only public fields are READ-ONLY. You must use the helpers
@@ -675,9 +685,49 @@ VLC_API void input_resource_Release( input_resource_t * );
  */
 VLC_API void input_resource_TerminateVout( input_resource_t * );
 
+/**
+ * Sets whether the audio and video decoders of the inputs stopped from now on
+ * are kept loaded for the next input, which reuses them when its streams have
+ * the same format (e.g. while switching to another media).
+ */
+VLC_API void input_resource_SetKeepDecoders( input_resource_t *, bool );
+
 /**
  * This function releases all resources (object).
  */
 VLC_API void input_resource_Terminate( input_resource_t * );
 
+/**
+ * It creates a standby input: the access of the given item is opened, with
+ * the options of the item, and kept reading in the background, caching the
+ * last group of pictures, so that an input can later be started from it
+ * without any connection or probing delay (see the "input-standby" input
+ * variable).
+ */
+VLC_API input_standby_t * input_standby_New( vlc_object_t *, input_item_t * ) VLC_USED;
+#define input_standby_New(a,b) input_standby_New(VLC_OBJECT(a),b)
+
+/**
+ * It stops and destroys a standby input that has not been used.
+ */
+VLC_API void input_standby_Delete( input_standby_t * );
+
+/**
+ * It returns the MRL of a standby input.
+ */
+VLC_API const char * input_standby_GetMRL( input_standby_t * );
+
+/**
+ * It creates a view of a program of an input: an input given the view
+ * (see the "input-view" input variable) plays that program, demuxed by the
+ * source input, instead of its own stream. The program is no longer
+ * output by the source itself. Only the TS demuxer supports it.
+ */
+VLC_API input_view_t * input_view_New( input_thread_t *p_source, int i_program ) VLC_USED;
+
+/**
+ * It releases a view that has not been given to an input.
+ */
+VLC_API void input_view_Release( input_view_t * );
+
 #endif
@@ -280,6 +280,19 @@ struct input_stats_t
     int64_t i_read_bytes;
     float f_input_bitrate;
     float f_average_input_bitrate;
+    int64_t i_socket_rcvbuf;    /**< effective socket buffer sizes */
+    int64_t i_socket_sndbuf;
+
+    /* Adaptive streaming */
+    int64_t i_adaptive_bandwidth;   /**< estimated throughput (bits/s) */
+    int64_t i_adaptive_variant;     /**< selected variant (bits/s) */
+    int64_t i_adaptive_buffer;      /**< segments downloaded ahead */
+    int64_t i_adaptive_switches;    /**< number of variant switches */
+
+    /* Block allocator (for the whole process) */
+    int64_t i_block_hits;           /**< blocks reused from a thread cache */
+    int64_t i_block_misses;         /**< blocks of a cached size allocated */
+    int64_t i_block_remote;         /**< blocks released by another thread */
 
     /* Demux */
     int64_t i_demux_read_packets;
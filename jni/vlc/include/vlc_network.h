@@ -157,12 +157,39 @@ VLC_API ssize_t net_Write( vlc_object_t *p_this, int fd, const v_socket_t *, con
 VLC_API char * net_Gets( vlc_object_t *p_this, int fd, const v_socket_t * );
 #define net_Gets(a,b,c) net_Gets(VLC_OBJECT(a),b,c)
 
+/* Buffered reading, for line based protocols */
+typedef struct net_reader_t net_reader_t;
+
+VLC_API net_reader_t * net_ReaderNew( int fd, const v_socket_t * ) VLC_USED;
+VLC_API void net_ReaderDelete( net_reader_t * );
+VLC_API size_t net_ReaderPending( const net_reader_t * );
+VLC_API ssize_t net_ReaderRead( vlc_object_t *p_this, net_reader_t *, void *p_data, size_t i_data, bool b_retry );
+#define net_ReaderRead(a,b,c,d,e) net_ReaderRead(VLC_OBJECT(a),b,c,d,e)
+VLC_API char * net_ReaderGets( vlc_object_t *p_this, net_reader_t * );
+#define net_ReaderGets(a,b) net_ReaderGets(VLC_OBJECT(a),b)
+
 
 VLC_API ssize_t net_Printf( vlc_object_t *p_this, int fd, const v_socket_t *, const char *psz_fmt, ... ) VLC_FORMAT( 4, 5 );
 #define net_Printf(o,fd,vs,...) net_Printf(VLC_OBJECT(o),fd,vs, __VA_ARGS__)
 VLC_API ssize_t net_vaPrintf( vlc_object_t *p_this, int fd, const v_socket_t *, const char *psz_fmt, va_list args );
 #define net_vaPrintf(a,b,c,d,e) net_vaPrintf(VLC_OBJECT(a),b,c,d,e)
 
+/* Messages assembled in memory and sent with a single write */
+typedef struct
+{
+    char   *psz_data;
+    size_t  i_length;
+    size_t  i_size;
+    bool    b_error;
+} net_buffer_t;
+
+VLC_API void net_BufferInit( net_buffer_t * );
+VLC_API void net_BufferClean( net_buffer_t * );
+VLC_API void net_BufferAppend( net_buffer_t *, const void *p_data, size_t i_data );
+VLC_API void net_BufferPrintf( net_buffer_t *, const char *psz_fmt, ... ) VLC_FORMAT( 2, 3 );
+VLC_API ssize_t net_BufferSend( vlc_object_t *p_this, int fd, const v_socket_t *, net_buffer_t * );
+#define net_BufferSend(a,b,c,d) net_BufferSend(VLC_OBJECT(a),b,c,d)
+
 VLC_API int vlc_inet_pton(int af, const char *src, void *dst);
 VLC_API const char *vlc_inet_ntop(int af, const void *src,
                                   char *dst, socklen_t cnt);
@@ -236,6 +263,8 @@ VLC_API int vlc_poll(struct pollfd *fds, unsigned nfds, int timeout);
 
 VLC_API int vlc_getnameinfo( const struct sockaddr *, int, char *, int, int *, int );
 VLC_API int vlc_getaddrinfo( vlc_object_t *, const char *, int, const struct addrinfo *, struct addrinfo ** );
+/* Forgets the cached addresses of a host (LibVLC core only) */
+void vlc_getaddrinfo_Flush( const char *node );
 
 
 static inline bool
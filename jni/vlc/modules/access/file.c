@@ -53,6 +53,9 @@
 #   include <sys/vfs.h>
 #   include <linux/magic.h>
 #endif
+#ifdef HAVE_MMAP
+#   include <sys/mman.h>
+#endif
 
 #if defined( WIN32 )
 #   include <io.h>
@@ -88,6 +91,11 @@ struct access_sys_t
     /* */
     unsigned caching;
     bool b_pace_control;
+
+#ifdef HAVE_MMAP
+    size_t mmap_window; /* mapped bytes per block */
+    uint64_t page_mask;
+#endif
 };
 
 #if !defined (WIN32) && !defined (__OS2__)
@@ -131,6 +139,11 @@ static bool IsRemote (int fd)
 # define posix_fadvise(fd, off, len, adv)
 #endif
 
+#ifdef HAVE_MMAP
+/* Size of the file windows mapped by FileBlock() */
+# define FILE_MMAP_WINDOW (1 << 20)
+#endif
+
 /*****************************************************************************
  * Open: open the file
  *****************************************************************************/
@@ -222,6 +235,9 @@ int Open( vlc_object_t *p_this )
     if (IsRemote(fd))
         p_sys->caching += var_InheritInteger (p_access, "network-caching");
     p_sys->b_pace_control = true;
+#ifdef HAVE_MMAP
+    p_sys->mmap_window = 0;
+#endif
 
     if (S_ISREG (st.st_mode))
         p_access->info.i_size = st.st_size;
@@ -248,6 +264,23 @@ int Open( vlc_object_t *p_this )
 # endif
 #endif
     }
+
+#ifdef HAVE_MMAP
+    /* Local regular files are handed out as mapped windows, without copying
+     * them. Remote files are excluded: a mapping faults (SIGBUS) if the file
+     * is truncated behind our back, which is far more likely there. */
+    if (S_ISREG (st.st_mode) && !IsRemote (fd)
+     && var_InheritBool (p_access, "file-mmap"))
+    {
+        long page = sysconf (_SC_PAGESIZE);
+        if (page > 0)
+        {
+            p_sys->mmap_window = FILE_MMAP_WINDOW;
+            p_sys->page_mask = ~(uint64_t)(page - 1);
+            p_access->pf_block = FileBlock;
+        }
+    }
+#endif
     return VLC_SUCCESS;
 
 error:
@@ -334,6 +367,70 @@ ssize_t FileRead( access_t *p_access, uint8_t *p_buffer, size_t i_len )
 }
 
 
+#ifdef HAVE_MMAP
+/*****************************************************************************
+ * Block: map the next window of the file
+ *****************************************************************************/
+block_t *FileBlock (access_t *p_access)
+{
+    access_sys_t *p_sys = p_access->p_sys;
+    int fd = p_sys->fd;
+    uint64_t pos = p_access->info.i_pos;
+
+    /* The file may grow while it is being recorded. Mapping past its end
+     * would fault, so the size is checked before mapping at the end. */
+    if ((pos >= p_access->info.i_size)
+     || !(++p_sys->i_nb_reads % INPUT_FSTAT_NB_READS))
+    {
+        struct stat st;
+
+        if ((fstat (fd, &st) == 0)
+         && (p_access->info.i_size != (uint64_t)st.st_size))
+        {
+            p_access->info.i_size = st.st_size;
+            p_access->info.i_update |= INPUT_UPDATE_SIZE;
+        }
+    }
+    if (pos >= p_access->info.i_size)
+    {
+        p_access->info.b_eof = true;
+        return NULL;
+    }
+
+    uint64_t offset = pos & p_sys->page_mask;
+    size_t length = __MIN (p_sys->mmap_window, p_access->info.i_size - offset);
+    /* Demuxers may modify the blocks in place (e.g. TS descrambling):
+     * the pages are private and copied on write */
+    void *addr = mmap (NULL, length, PROT_READ|PROT_WRITE, MAP_PRIVATE,
+                       fd, offset);
+    if (addr == MAP_FAILED)
+    {
+        msg_Err (p_access, "cannot map file (%m)");
+        p_access->info.b_eof = true;
+        return NULL;
+    }
+#ifdef MADV_SEQUENTIAL
+    /* read this window ahead and let pages go once they were used */
+    madvise (addr, length, MADV_SEQUENTIAL);
+#endif
+#ifdef MADV_WILLNEED
+    madvise (addr, length, MADV_WILLNEED);
+#endif
+    /* start reading the next window from the disk already */
+    posix_fadvise (fd, offset + length, p_sys->mmap_window,
+                   POSIX_FADV_WILLNEED);
+
+    block_t *block = block_mmap_Alloc (addr, length);
+    if (block == NULL)
+        return NULL;
+
+    block->p_buffer += pos - offset;
+    block->i_buffer -= pos - offset;
+    p_access->info.i_pos += block->i_buffer;
+    return block;
+}
+#endif
+
 /*****************************************************************************
  * Seek: seek to a specific location in a file
  *****************************************************************************/
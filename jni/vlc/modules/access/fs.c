@@ -38,6 +38,11 @@
 #define NETWORK_CACHING_LONGTEXT N_( \
     "Supplementary caching value for remote files, in milliseconds." )
 
+#define MMAP_TEXT N_("Map files in memory")
+#define MMAP_LONGTEXT N_( \
+    "Read local files through memory mappings instead of copying them. " \
+    "This saves CPU, but a file truncated while it is played may crash." )
+
 #define RECURSIVE_TEXT N_("Subdirectory behavior")
 #define RECURSIVE_LONGTEXT N_( \
         "Select whether subdirectories must be expanded.\n" \
@@ -67,6 +72,7 @@ vlc_module_begin ()
     add_integer( "network-caching", 3 * DEFAULT_PTS_DELAY / 1000,
                  NETWORK_CACHING_TEXT, NETWORK_CACHING_LONGTEXT, true )
         change_safe()
+    add_bool( "file-mmap", true, MMAP_TEXT, MMAP_LONGTEXT, true )
     add_obsolete_string( "file-cat" )
     set_capability( "access", 50 )
     add_shortcut( "file", "fd", "stream" )
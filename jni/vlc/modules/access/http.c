@@ -53,6 +53,9 @@
 #endif
 
 #include <assert.h>
+#ifndef WIN32
+#   include <poll.h>
+#endif
 
 #ifdef HAVE_LIBPROXY
 #    include <proxy.h>
@@ -100,6 +103,10 @@ static void Close( vlc_object_t * );
 #define REFERER_TEXT N_("HTTP referer value")
 #define REFERER_LONGTEXT N_("Customize the HTTP referer, simulating a previous document")
 
+#define RCVBUF_TEXT N_("Socket receive buffer size")
+#define RCVBUF_LONGTEXT N_("Receive buffer size of the HTTP connections " \
+    "(in bytes), unless net-rcvbuf is set.")
+
 #define UA_TEXT N_("User Agent")
 #define UA_LONGTEXT N_("You can use a custom User agent or use a known one")
 
@@ -129,6 +136,8 @@ vlc_module_begin ()
         change_safe()
     add_bool( "http-forward-cookies", true, FORWARD_COOKIES_TEXT,
               FORWARD_COOKIES_LONGTEXT, true )
+    add_integer( "http-rcvbuf", 1024 * 1024, RCVBUF_TEXT,
+                 RCVBUF_LONGTEXT, true )
     /* 'itpc' = iTunes Podcast */
     add_shortcut( "http", "https", "unsv", "itpc", "icyx" )
     set_callbacks( Open, Close )
@@ -144,6 +153,7 @@ struct access_sys_t
     bool b_error;
     vlc_tls_t  *p_tls;
     v_socket_t *p_vs;
+    net_reader_t *p_reader;
 
     /* From uri */
     vlc_url_t url;
@@ -213,6 +223,10 @@ static int Connect( access_t *, uint64_t );
 static int Request( access_t *p_access, uint64_t i_tell );
 static void Disconnect( access_t * );
 
+/* Keep-alive connections */
+static int  PoolGet( const char *psz_host, int i_port );
+static void PoolPut( const char *psz_host, int i_port, int fd );
+
 /* Small Cookie utilities. Cookies support is partial. */
 static char * cookie_get_content( const char * cookie );
 static char * cookie_get_domain( const char * cookie );
@@ -220,7 +234,8 @@ static char * cookie_get_name( const char * cookie );
 static void cookie_append( vlc_array_t * cookies, char * cookie );
 
 
-static void AuthReply( access_t *p_acces, const char *psz_prefix,
+static void AuthReply( access_t *p_acces, net_buffer_t *p_req,
+                       const char *psz_prefix,
                        vlc_url_t *p_url, http_auth_t *p_auth );
 static int AuthCheckReply( access_t *p_access, const char *psz_header,
                            vlc_url_t *p_url, http_auth_t *p_auth );
@@ -285,6 +300,7 @@ static int OpenWithCookies( vlc_object_t *p_this, const char *psz_access,
 #endif
     p_sys->p_tls = NULL;
     p_sys->p_vs = NULL;
+    p_sys->p_reader = NULL;
     p_sys->i_icy_meta = 0;
     p_sys->i_icy_offset = 0;
     p_sys->psz_icy_name = NULL;
@@ -299,6 +315,14 @@ static int OpenWithCookies( vlc_object_t *p_this, const char *psz_access,
 
     p_sys->cookies = saved_cookies;
 
+    /* Socket tuning, see net_SetSockOpts() */
+    if( var_InheritInteger( p_access, "net-rcvbuf" ) <= 0 )
+    {
+        var_Create( p_access, "net-rcvbuf", VLC_VAR_INTEGER );
+        var_SetInteger( p_access, "net-rcvbuf",
+                        var_InheritInteger( p_access, "http-rcvbuf" ) );
+    }
+
     http_auth_Init( &p_sys->auth );
     http_auth_Init( &p_sys->proxy_auth );
 
@@ -766,7 +790,7 @@ static ssize_t Read( access_t *p_access, uint8_t *p_buffer, size_t i_len )
 
         if( p_sys->i_chunk <= 0 )
         {
-            char *psz = net_Gets( p_access, p_sys->fd, p_sys->p_vs );
+            char *psz = net_ReaderGets( p_access, p_sys->p_reader );
             /* read the chunk header */
             if( psz == NULL )
             {
@@ -805,7 +829,7 @@ static ssize_t Read( access_t *p_access, uint8_t *p_buffer, size_t i_len )
             i_len = i_next;
     }
 
-    i_read = net_Read( p_access, p_sys->fd, p_sys->p_vs, p_buffer, i_len, false );
+    i_read = net_ReaderRead( p_access, p_sys->p_reader, p_buffer, i_len, false );
 
     if( i_read > 0 )
     {
@@ -815,7 +839,7 @@ static ssize_t Read( access_t *p_access, uint8_t *p_buffer, size_t i_len )
             if( p_sys->i_chunk <= 0 )
             {
                 /* read the empty line */
-                char *psz = net_Gets( p_access, p_sys->fd, p_sys->p_vs );
+                char *psz = net_ReaderGets( p_access, p_sys->p_reader );
                 free( psz );
             }
         }
@@ -886,8 +910,7 @@ static int ReadICYMeta( access_t *p_access )
     int i_read;
 
     /* Read meta data length */
-    i_read = net_Read( p_access, p_sys->fd, p_sys->p_vs, &buffer, 1,
-                       true );
+    i_read = net_ReaderRead( p_access, p_sys->p_reader, &buffer, 1, true );
     if( i_read <= 0 )
         return VLC_EGENERIC;
     if( buffer == 0 )
@@ -897,8 +920,8 @@ static int ReadICYMeta( access_t *p_access )
     /* msg_Dbg( p_access, "ICY meta size=%u", i_read); */
 
     psz_meta = malloc( i_read + 1 );
-    if( net_Read( p_access, p_sys->fd, p_sys->p_vs,
-                  (uint8_t *)psz_meta, i_read, true ) != i_read )
+    if( net_ReaderRead( p_access, p_sys->p_reader,
+                        (uint8_t *)psz_meta, i_read, true ) != i_read )
     {
         free( psz_meta );
         return VLC_EGENERIC;
@@ -1120,8 +1143,25 @@ static int Connect( access_t *p_access, uint64_t i_tell )
     p_access->info.i_pos  = i_tell;
     p_access->info.b_eof  = false;
 
-    /* Open connection */
+    /* Open connection, reusing an idle one to the same server if any */
     assert( p_sys->fd == -1 ); /* No open sockets (leaking fds is BAD) */
+    if( !p_sys->b_ssl )
+        p_sys->fd = PoolGet( srv.psz_host, srv.i_port );
+    if( p_sys->fd != -1 )
+    {
+        msg_Dbg( p_access, "reusing connection to %s:%d",
+                 srv.psz_host, srv.i_port );
+        p_sys->i_code = 0;
+        if( Request( p_access, i_tell ) == VLC_SUCCESS )
+            return 0;
+        /* the server may have dropped it before answering */
+        if( p_sys->i_code != 0 || !vlc_object_alive( p_access )
+         || p_sys->b_error )
+            return -2;
+        msg_Dbg( p_access, "reused connection failed, opening a new one" );
+        return Connect( p_access, i_tell );
+    }
+
     p_sys->fd = net_ConnectTCP( p_access, srv.psz_host, srv.i_port );
     if( p_sys->fd == -1 )
     {
@@ -1129,10 +1169,7 @@ static int Connect( access_t *p_access, uint64_t i_tell )
         return -1;
     }
 
-	int optVal = 1024*1024 ;
-   	int optLen = sizeof(int);
     setsockopt (p_sys->fd, SOL_SOCKET, SO_KEEPALIVE, &(int){ 1 }, sizeof (int));
-	setsockopt (p_sys->fd, SOL_SOCKET, SO_RCVBUF,    (char*)&optVal,   optLen );
 
     /* Initialize TLS/SSL session */
     if( p_sys->b_ssl )
@@ -1221,22 +1258,37 @@ static int Request( access_t *p_access, uint64_t i_tell )
     v_socket_t     *pvs = p_sys->p_vs;
     p_sys->b_persist = false;
 
+    if( p_sys->p_reader == NULL )
+    {
+        p_sys->p_reader = net_ReaderNew( p_sys->fd, pvs );
+        if( p_sys->p_reader == NULL )
+        {
+            Disconnect( p_access );
+            return VLC_ENOMEM;
+        }
+    }
+
     p_sys->i_remaining = 0;
+
+    /* The request is sent at once, see net_BufferSend() */
+    net_buffer_t req;
+    net_BufferInit( &req );
+
     if( p_sys->b_proxy )
     {
         if( p_sys->url.psz_path )
         {
-            net_Printf( p_access, p_sys->fd, NULL,
-                        "GET http://%s:%d%s HTTP/1.%d\r\n",
-                        p_sys->url.psz_host, p_sys->url.i_port,
-                        p_sys->url.psz_path, p_sys->i_version );
+            net_BufferPrintf( &req,
+                              "GET http://%s:%d%s HTTP/1.%d\r\n",
+                              p_sys->url.psz_host, p_sys->url.i_port,
+                              p_sys->url.psz_path, p_sys->i_version );
         }
         else
         {
-            net_Printf( p_access, p_sys->fd, NULL,
-                        "GET http://%s:%d/ HTTP/1.%d\r\n",
-                        p_sys->url.psz_host, p_sys->url.i_port,
-                        p_sys->i_version );
+            net_BufferPrintf( &req,
+                              "GET http://%s:%d/ HTTP/1.%d\r\n",
+                              p_sys->url.psz_host, p_sys->url.i_port,
+                              p_sys->i_version );
         }
     }
     else
@@ -1248,36 +1300,35 @@ static int Request( access_t *p_access, uint64_t i_tell )
         }
         if( p_sys->url.i_port != (pvs ? 443 : 80) )
         {
-            net_Printf( p_access, p_sys->fd, pvs,
-                        "GET %s HTTP/1.%d\r\nHost: %s:%d\r\n",
-                        psz_path, p_sys->i_version, p_sys->url.psz_host,
-                        p_sys->url.i_port );
+            net_BufferPrintf( &req,
+                              "GET %s HTTP/1.%d\r\nHost: %s:%d\r\n",
+                              psz_path, p_sys->i_version, p_sys->url.psz_host,
+                              p_sys->url.i_port );
         }
         else
         {
-            net_Printf( p_access, p_sys->fd, pvs,
-                        "GET %s HTTP/1.%d\r\nHost: %s\r\n",
-                        psz_path, p_sys->i_version, p_sys->url.psz_host );
+            net_BufferPrintf( &req,
+                              "GET %s HTTP/1.%d\r\nHost: %s\r\n",
+                              psz_path, p_sys->i_version, p_sys->url.psz_host );
         }
     }
     /* User Agent */
-    net_Printf( p_access, p_sys->fd, pvs,
-                "User-Agent: %s\r\n",
-                p_sys->psz_user_agent );
+    net_BufferPrintf( &req,
+                      "User-Agent: %s\r\n",
+                      p_sys->psz_user_agent );
     /* Referrer */
     if (p_sys->psz_referrer)
     {
-        net_Printf( p_access, p_sys->fd, pvs,
-                    "Referer: %s\r\n",
-                    p_sys->psz_referrer);
+        net_BufferPrintf( &req,
+                          "Referer: %s\r\n",
+                          p_sys->psz_referrer);
     }
     /* Offset */
     if( p_sys->i_version == 1 && ! p_sys->b_continuous )
     {
         p_sys->b_persist = true;
-        net_Printf( p_access, p_sys->fd, pvs,
-                    "Range: bytes=%"PRIu64"-\r\n", i_tell );
-        net_Printf( p_access, p_sys->fd, pvs, "Connection: close\r\n" );
+        net_BufferPrintf( &req,
+                          "Range: bytes=%"PRIu64"-\r\n", i_tell );
     }
 
     /* Cookies */
@@ -1298,8 +1349,7 @@ static int Request( access_t *p_access, uint64_t i_tell )
             if( is_in_right_domain )
             {
                 msg_Dbg( p_access, "Sending Cookie %s", psz_cookie_content );
-                if( net_Printf( p_access, p_sys->fd, pvs, "Cookie: %s\r\n", psz_cookie_content ) < 0 )
-                    msg_Err( p_access, "failed to send Cookie" );
+                net_BufferPrintf( &req, "Cookie: %s\r\n", psz_cookie_content );
             }
             free( psz_cookie_content );
             free( psz_cookie_domain );
@@ -1308,17 +1358,18 @@ static int Request( access_t *p_access, uint64_t i_tell )
 
     /* Authentication */
     if( p_sys->url.psz_username || p_sys->url.psz_password )
-        AuthReply( p_access, "", &p_sys->url, &p_sys->auth );
+        AuthReply( p_access, &req, "", &p_sys->url, &p_sys->auth );
 
     /* Proxy Authentication */
     if( p_sys->proxy.psz_username || p_sys->proxy.psz_password )
-        AuthReply( p_access, "Proxy-", &p_sys->proxy, &p_sys->proxy_auth );
+        AuthReply( p_access, &req, "Proxy-", &p_sys->proxy, &p_sys->proxy_auth );
 
     /* ICY meta data request */
-    net_Printf( p_access, p_sys->fd, pvs, "Icy-MetaData: 1\r\n" );
+    net_BufferPrintf( &req, "Icy-MetaData: 1\r\n" );
 
 
-    if( net_Printf( p_access, p_sys->fd, pvs, "\r\n" ) < 0 )
+    net_BufferPrintf( &req, "\r\n" );
+    if( net_BufferSend( p_access, p_sys->fd, pvs, &req ) < 0 )
     {
         msg_Err( p_access, "failed to send request" );
         Disconnect( p_access );
@@ -1326,7 +1377,7 @@ static int Request( access_t *p_access, uint64_t i_tell )
     }
 
     /* Read Answer */
-    if( ( psz = net_Gets( p_access, p_sys->fd, pvs ) ) == NULL )
+    if( ( psz = net_ReaderGets( p_access, p_sys->p_reader ) ) == NULL )
     {
         msg_Err( p_access, "failed to read answer" );
         goto error;
@@ -1335,6 +1386,9 @@ static int Request( access_t *p_access, uint64_t i_tell )
     {
         p_sys->psz_protocol = "HTTP";
         p_sys->i_code = atoi( &psz[9] );
+        /* HTTP/1.0 servers close the connection by default */
+        if( psz[7] != '1' )
+            p_sys->b_persist = false;
     }
     else if( !strncmp( psz, "ICY", 3 ) )
     {
@@ -1374,7 +1428,7 @@ static int Request( access_t *p_access, uint64_t i_tell )
 
     for( ;; )
     {
-        char *psz = net_Gets( p_access, p_sys->fd, pvs );
+        char *psz = net_ReaderGets( p_access, p_sys->p_reader );
         char *p;
 
         if( psz == NULL )
@@ -1434,11 +1488,9 @@ static int Request( access_t *p_access, uint64_t i_tell )
         }
         else if( !strcasecmp( psz, "Connection" ) ) {
             msg_Dbg( p_access, "Connection: %s",p );
-            int i = -1;
-            sscanf(p, "close%n",&i);
-            if( i >= 0 ) {
+            /* The header is a list of tokens, case insensitive */
+            if( strcasestr( p, "close" ) != NULL )
                 p_sys->b_persist = false;
-            }
         }
         else if( !strcasecmp( psz, "Location" ) )
         {
@@ -1612,16 +1664,38 @@ static int Request( access_t *p_access, uint64_t i_tell )
     return VLC_SUCCESS;
 
 error:
+    p_sys->b_persist = false;
     Disconnect( p_access );
     return VLC_EGENERIC;
 }
 
 /*****************************************************************************
- * Disconnect:
+ * Disconnect: give the connection back to the pool if the whole response
+ * body has been read and the server keeps it open, close it otherwise.
  *****************************************************************************/
 static void Disconnect( access_t *p_access )
 {
     access_sys_t *p_sys = p_access->p_sys;
+    bool b_reuse = p_sys->fd != -1 && p_sys->p_tls == NULL
+     && p_sys->b_persist && !p_sys->b_error && !p_sys->b_chunked
+     && p_sys->b_has_size && p_sys->i_remaining == 0
+     && p_sys->psz_protocol && !strcmp( p_sys->psz_protocol, "HTTP" )
+     && p_sys->p_reader && net_ReaderPending( p_sys->p_reader ) == 0;
+
+    if( p_sys->p_reader != NULL )
+    {
+        net_ReaderDelete( p_sys->p_reader );
+        p_sys->p_reader = NULL;
+    }
+
+    if( b_reuse )
+    {
+        vlc_url_t *srv = p_sys->b_proxy ? &p_sys->proxy : &p_sys->url;
+        PoolPut( srv->psz_host, srv->i_port, p_sys->fd );
+        p_sys->fd = -1;
+        p_sys->b_persist = false;
+        return;
+    }
 
     if( p_sys->p_tls != NULL)
     {
@@ -1637,6 +1711,100 @@ static void Disconnect( access_t *p_access )
 
 }
 
+/*****************************************************************************
+ * Keep-alive connection pool: idle HTTP/1.1 connections, shared by all the
+ * http access instances (including the ones HLS opens for each segment and
+ * playlist), keyed by host and port.
+ *****************************************************************************/
+#define POOL_SIZE 8
+#define POOL_IDLE_MAX (10 * CLOCK_FREQ)
+
+static struct
+{
+    char    *psz_host;
+    int      i_port;
+    int      fd;
+    mtime_t  i_date;
+} pool[POOL_SIZE];
+static vlc_mutex_t pool_lock = VLC_STATIC_MUTEX;
+
+static void PoolDrop( int i )
+{
+    net_Close( pool[i].fd );
+    free( pool[i].psz_host );
+    pool[i].psz_host = NULL;
+}
+
+/* A connection the server has closed, or that has unexpected pending
+ * data, is readable. */
+static bool PoolIsStale( int fd )
+{
+    struct pollfd ufd = { .fd = fd, .events = POLLIN };
+    return vlc_poll( &ufd, 1, 0 ) != 0;
+}
+
+static int PoolGet( const char *psz_host, int i_port )
+{
+    const mtime_t now = mdate();
+    int fd = -1;
+
+    vlc_mutex_lock( &pool_lock );
+    for( int i = 0; i < POOL_SIZE; i++ )
+    {
+        if( pool[i].psz_host == NULL )
+            continue;
+        if( now - pool[i].i_date > POOL_IDLE_MAX )
+        {
+            PoolDrop( i );
+            continue;
+        }
+        if( fd != -1 || pool[i].i_port != i_port
+         || strcasecmp( pool[i].psz_host, psz_host ) )
+            continue;
+        if( PoolIsStale( pool[i].fd ) )
+        {
+            PoolDrop( i );
+            continue;
+        }
+        fd = pool[i].fd;
+        free( pool[i].psz_host );
+        pool[i].psz_host = NULL;
+    }
+    vlc_mutex_unlock( &pool_lock );
+    return fd;
+}
+
+static void PoolPut( const char *psz_host, int i_port, int fd )
+{
+    char *psz_dup = strdup( psz_host );
+    if( unlikely(psz_dup == NULL) )
+    {
+        net_Close( fd );
+        return;
+    }
+
+    vlc_mutex_lock( &pool_lock );
+    /* use a free slot, or evict the oldest one */
+    int i_slot = 0;
+    for( int i = 0; i < POOL_SIZE; i++ )
+    {
+        if( pool[i].psz_host == NULL )
+        {
+            i_slot = i;
+            break;
+        }
+        if( pool[i].i_date < pool[i_slot].i_date )
+            i_slot = i;
+    }
+    if( pool[i_slot].psz_host != NULL )
+        PoolDrop( i_slot );
+    pool[i_slot].psz_host = psz_dup;
+    pool[i_slot].i_port = i_port;
+    pool[i_slot].fd = fd;
+    pool[i_slot].i_date = mdate();
+    vlc_mutex_unlock( &pool_lock );
+}
+
 /*****************************************************************************
  * Cookies (FIXME: we may want to rewrite that using a nice structure to hold
  * them) (FIXME: only support the "domain=" param)
@@ -1746,10 +1914,10 @@ static void cookie_append( vlc_array_t * cookies, char * cookie )
  * HTTP authentication
  *****************************************************************************/
 
-static void AuthReply( access_t *p_access, const char *psz_prefix,
+static void AuthReply( access_t *p_access, net_buffer_t *p_req,
+                       const char *psz_prefix,
                        vlc_url_t *p_url, http_auth_t *p_auth )
 {
-    access_sys_t *p_sys = p_access->p_sys;
     char *psz_value;
 
     psz_value =
@@ -1760,8 +1928,7 @@ static void AuthReply( access_t *p_access, const char *psz_prefix,
     if ( psz_value == NULL )
         return;
 
-    net_Printf( p_access, p_sys->fd, p_sys->p_vs,
-                "%sAuthorization: %s\r\n", psz_prefix, psz_value );
+    net_BufferPrintf( p_req, "%sAuthorization: %s\r\n", psz_prefix, psz_value );
     free( psz_value );
 }
 
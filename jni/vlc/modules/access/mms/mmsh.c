@@ -486,7 +486,7 @@ static int Reset( access_t *p_access )
     return VLC_SUCCESS;
 }
 
-static int OpenConnection( access_t *p_access )
+static int OpenConnection( access_t *p_access, net_buffer_t *p_req )
 {
     access_sys_t *p_sys = p_access->p_sys;
     vlc_url_t    srv = p_sys->b_proxy ? p_sys->proxy : p_sys->url;
@@ -501,12 +501,12 @@ static int OpenConnection( access_t *p_access )
 
     if( p_sys->b_proxy )
     {
-        net_Printf( p_access, p_sys->fd, NULL,
-                    "GET http://%s:%d%s HTTP/1.0\r\n",
-                    p_sys->url.psz_host, p_sys->url.i_port,
-                    ( (p_sys->url.psz_path == NULL) ||
-                      (*p_sys->url.psz_path == '\0') ) ?
-                         "/" : p_sys->url.psz_path );
+        net_BufferPrintf( p_req,
+                          "GET http://%s:%d%s HTTP/1.0\r\n",
+                          p_sys->url.psz_host, p_sys->url.i_port,
+                          ( (p_sys->url.psz_path == NULL) ||
+                          (*p_sys->url.psz_path == '\0') ) ?
+                          "/" : p_sys->url.psz_path );
 
         /* Proxy Authentication */
         if( p_sys->proxy.psz_username && *p_sys->proxy.psz_username )
@@ -521,20 +521,20 @@ static int OpenConnection( access_t *p_access )
             b64 = vlc_b64_encode( buf );
             free( buf );
 
-            net_Printf( p_access, p_sys->fd, NULL,
-                        "Proxy-Authorization: Basic %s\r\n", b64 );
+            net_BufferPrintf( p_req,
+                              "Proxy-Authorization: Basic %s\r\n", b64 );
             free( b64 );
         }
     }
     else
     {
-        net_Printf( p_access, p_sys->fd, NULL,
-                    "GET %s HTTP/1.0\r\n"
-                    "Host: %s:%d\r\n",
-                    ( (p_sys->url.psz_path == NULL) ||
-                      (*p_sys->url.psz_path == '\0') ) ?
+        net_BufferPrintf( p_req,
+                          "GET %s HTTP/1.0\r\n"
+                          "Host: %s:%d\r\n",
+                          ( (p_sys->url.psz_path == NULL) ||
+                          (*p_sys->url.psz_path == '\0') ) ?
                             "/" : p_sys->url.psz_path,
-                    p_sys->url.psz_host, p_sys->url.i_port );
+                          p_sys->url.psz_host, p_sys->url.i_port );
     }
     return VLC_SUCCESS;
 }
@@ -561,19 +561,25 @@ static int Describe( access_t  *p_access, char **ppsz_location )
 
     GenerateGuid ( &p_sys->guid );
 
-    if( OpenConnection( p_access ) )
+    net_buffer_t req;
+    net_BufferInit( &req );
+    if( OpenConnection( p_access, &req ) )
+    {
+        net_BufferClean( &req );
         return VLC_EGENERIC;
+    }
 
-    net_Printf( p_access, p_sys->fd, NULL,
-                "Accept: */*\r\n"
-                "User-Agent: "MMSH_USER_AGENT"\r\n"
-                "Pragma: no-cache,rate=1.000000,stream-time=0,stream-offset=0:0,request-context=%d,max-duration=0\r\n"
-                "Pragma: xClientGUID={"GUID_FMT"}\r\n"
-                "Connection: Close\r\n",
-                p_sys->i_request_context++,
-                GUID_PRINT( p_sys->guid ) );
+    net_BufferPrintf( &req,
+                      "Accept: */*\r\n"
+                      "User-Agent: "MMSH_USER_AGENT"\r\n"
+                      "Pragma: no-cache,rate=1.000000,stream-time=0,stream-offset=0:0,request-context=%d,max-duration=0\r\n"
+                      "Pragma: xClientGUID={"GUID_FMT"}\r\n"
+                      "Connection: Close\r\n"
+                      "\r\n",
+                      p_sys->i_request_context++,
+                      GUID_PRINT( p_sys->guid ) );
 
-    if( net_Printf( p_access, p_sys->fd, NULL, "\r\n" ) < 0 )
+    if( net_BufferSend( p_access, p_sys->fd, NULL, &req ) < 0 )
     {
         msg_Err( p_access, "failed to send request" );
         goto error;
@@ -784,33 +790,38 @@ static int Start( access_t *p_access, uint64_t i_pos )
         return VLC_EGENERIC;
     }
 
-    if( OpenConnection( p_access ) )
+    net_buffer_t req;
+    net_BufferInit( &req );
+    if( OpenConnection( p_access, &req ) )
+    {
+        net_BufferClean( &req );
         return VLC_EGENERIC;
+    }
 
-    net_Printf( p_access, p_sys->fd, NULL,
-                "Accept: */*\r\n"
-                "User-Agent: "MMSH_USER_AGENT"\r\n" );
+    net_BufferPrintf( &req,
+                      "Accept: */*\r\n"
+                      "User-Agent: "MMSH_USER_AGENT"\r\n" );
     if( p_sys->b_broadcast )
     {
-        net_Printf( p_access, p_sys->fd, NULL,
-                    "Pragma: no-cache,rate=1.000000,request-context=%d\r\n",
-                    p_sys->i_request_context++ );
+        net_BufferPrintf( &req,
+                          "Pragma: no-cache,rate=1.000000,request-context=%d\r\n",
+                          p_sys->i_request_context++ );
     }
     else
     {
-        net_Printf( p_access, p_sys->fd, NULL,
-                    "Pragma: no-cache,rate=1.000000,stream-time=0,stream-offset=%u:%u,request-context=%d,max-duration=0\r\n",
-                    (uint32_t)((i_pos >> 32)&0xffffffff),
-                    (uint32_t)(i_pos&0xffffffff),
-                    p_sys->i_request_context++ );
+        net_BufferPrintf( &req,
+                          "Pragma: no-cache,rate=1.000000,stream-time=0,stream-offset=%u:%u,request-context=%d,max-duration=0\r\n",
+                          (uint32_t)((i_pos >> 32)&0xffffffff),
+                          (uint32_t)(i_pos&0xffffffff),
+                          p_sys->i_request_context++ );
     }
-    net_Printf( p_access, p_sys->fd, NULL,
-                "Pragma: xPlayStrm=1\r\n"
-                "Pragma: xClientGUID={"GUID_FMT"}\r\n"
-                "Pragma: stream-switch-count=%d\r\n"
-                "Pragma: stream-switch-entry=",
-                GUID_PRINT( p_sys->guid ),
-                i_streams);
+    net_BufferPrintf( &req,
+                      "Pragma: xPlayStrm=1\r\n"
+                      "Pragma: xClientGUID={"GUID_FMT"}\r\n"
+                      "Pragma: stream-switch-count=%d\r\n"
+                      "Pragma: stream-switch-entry=",
+                      GUID_PRINT( p_sys->guid ),
+                      i_streams);
 
     for( i = 1; i < 128; i++ )
     {
@@ -821,15 +832,15 @@ static int Start( access_t *p_access, uint64_t i_pos )
             {
                 i_select = 0;
             }
-            net_Printf( p_access, p_sys->fd, NULL,
-                        "ffff:%d:%d ", i, i_select );
+            net_BufferPrintf( &req,
+                              "ffff:%d:%d ", i, i_select );
         }
     }
-    net_Printf( p_access, p_sys->fd, NULL, "\r\n" );
-    net_Printf( p_access, p_sys->fd, NULL,
-                "Connection: Close\r\n" );
+    net_BufferPrintf( &req, "\r\n" );
+    net_BufferPrintf( &req, "Connection: Close\r\n" );
 
-    if( net_Printf( p_access, p_sys->fd, NULL, "\r\n" ) < 0 )
+    net_BufferPrintf( &req, "\r\n" );
+    if( net_BufferSend( p_access, p_sys->fd, NULL, &req ) < 0 )
     {
         msg_Err( p_access, "failed to send request" );
         return VLC_EGENERIC;
@@ -134,13 +134,13 @@ static int RtspReadLine( void *p_userdata, uint8_t *p_buffer, int i_buffer )
 
 static int RtspWrite( void *p_userdata, uint8_t *p_buffer, int i_buffer )
 {
-    VLC_UNUSED(i_buffer);
     access_t *p_access = (access_t *)p_userdata;
     access_sys_t *p_sys = p_access->p_sys;
 
     //fprintf(stderr, "Write: %s", p_buffer);
 
-    net_Printf( p_access, p_sys->fd, 0, "%s", p_buffer );
+    if( net_Write( p_access, p_sys->fd, NULL, p_buffer, i_buffer ) < i_buffer )
+        return -1;
 
     return 0;
 }
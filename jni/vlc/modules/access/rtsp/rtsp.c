@@ -29,6 +29,7 @@
 #endif
 
 #include <vlc_common.h>
+#include <vlc_network.h>
 
 #include "rtsp.h"
 
@@ -103,22 +104,17 @@ static char *rtsp_get( rtsp_client_t *rtsp )
 
 
 /*
- * rtsp_put puts a line on stream
+ * rtsp_flush writes a whole message on stream at once
  */
 
-static int rtsp_put( rtsp_client_t *rtsp, const char *psz_string )
+static int rtsp_flush( rtsp_client_t *rtsp, net_buffer_t *p_msg )
 {
-    unsigned int i_buffer = strlen( psz_string );
-    char *psz_buffer = malloc( i_buffer + 3 );
-    int i_ret;
-
-    strcpy( psz_buffer, psz_string );
-    psz_buffer[i_buffer] = '\r'; psz_buffer[i_buffer+1] = '\n';
-    psz_buffer[i_buffer+2] = 0;
-
-    i_ret = rtsp->pf_write( rtsp->p_userdata, (uint8_t*)psz_buffer, i_buffer + 2 );
+    int i_ret = -1;
 
-    free( psz_buffer );
+    if( !p_msg->b_error )
+        i_ret = rtsp->pf_write( rtsp->p_userdata, (uint8_t*)p_msg->psz_data,
+                                p_msg->i_length );
+    net_BufferClean( p_msg );
     return i_ret;
 }
 
@@ -159,23 +155,20 @@ static int rtsp_send_request( rtsp_client_t *rtsp, const char *psz_type,
                               const char *psz_what )
 {
     char **ppsz_payload = rtsp->p_private->scheduled;
-    char *psz_buffer;
+    net_buffer_t msg;
     int i_ret;
 
-    psz_buffer = malloc( strlen(psz_type) + strlen(psz_what) +
-                         sizeof("RTSP/1.0") + 2 );
-
-    sprintf( psz_buffer, "%s %s %s", psz_type, psz_what, "RTSP/1.0" );
-    i_ret = rtsp_put( rtsp, psz_buffer );
-    free( psz_buffer );
+    net_BufferInit( &msg );
+    net_BufferPrintf( &msg, "%s %s %s\r\n", psz_type, psz_what, "RTSP/1.0" );
 
     if( ppsz_payload )
         while( *ppsz_payload )
         {
-            rtsp_put( rtsp, *ppsz_payload );
+            net_BufferPrintf( &msg, "%s\r\n", *ppsz_payload );
             ppsz_payload++;
         }
-    rtsp_put( rtsp, "" );
+    net_BufferPrintf( &msg, "\r\n" );
+    i_ret = rtsp_flush( rtsp, &msg );
     rtsp_unschedule_all( rtsp );
 
     return i_ret;
@@ -284,12 +277,12 @@ static int rtsp_get_answers( rtsp_client_t *rtsp )
 
 int rtsp_send_ok( rtsp_client_t *rtsp )
 {
-    char cseq[16];
+    net_buffer_t msg;
 
-    rtsp_put( rtsp, "RTSP/1.0 200 OK" );
-    sprintf( cseq, "CSeq: %u", rtsp->p_private->cseq );
-    rtsp_put( rtsp, cseq );
-    rtsp_put( rtsp, "" );
+    net_BufferInit( &msg );
+    net_BufferPrintf( &msg, "RTSP/1.0 200 OK\r\nCSeq: %u\r\n\r\n",
+                      rtsp->p_private->cseq );
+    rtsp_flush( rtsp, &msg );
     return 0;
 }
 
@@ -430,12 +423,11 @@ int rtsp_read_data( rtsp_client_t *rtsp, uint8_t *buffer, unsigned int size )
             }
 
             /* lets make the server happy */
-            rtsp_put( rtsp, "RTSP/1.0 451 Parameter Not Understood" );
-            rest = malloc(17);
-            sprintf( rest,"CSeq: %u", seq );
-            rtsp_put( rtsp, rest );
-            rtsp_put( rtsp, "" );
-            free( rest );
+            net_buffer_t msg;
+            net_BufferInit( &msg );
+            net_BufferPrintf( &msg, "RTSP/1.0 451 Parameter Not Understood\r\n"
+                              "CSeq: %u\r\n\r\n", seq );
+            rtsp_flush( rtsp, &msg );
             i = rtsp->pf_read( rtsp->p_userdata, (unsigned char*)buffer, size );
         }
         else
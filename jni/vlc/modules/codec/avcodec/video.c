@@ -95,6 +95,9 @@ struct decoder_sys_t
     /* Hack to force display of still pictures */
     bool b_first_frame;
 
+    /* Pictures are dropped until a keyframe after a start or discontinuity */
+    bool b_wait_keyframe;
+
     /* */
     AVPaletteControl palette;
 
@@ -373,6 +376,7 @@ int InitVideoDec( decoder_t *p_dec, AVCodecContext *p_context,
     p_sys->i_pts = VLC_TS_INVALID;
     p_sys->b_has_b_frames = false;
     p_sys->b_first_frame = true;
+    p_sys->b_wait_keyframe = true;
     p_sys->b_flush = false;
     p_sys->i_late_frames = 0;
 
@@ -478,12 +482,29 @@ picture_t *DecodeVideo( decoder_t *p_dec, block_t **pp_block )
         p_sys->i_late_frames = 0;
 
         if( p_block->i_flags & BLOCK_FLAG_DISCONTINUITY )
+        {
             avcodec_flush_buffers( p_context );
+            p_sys->b_wait_keyframe = true;
+        }
 
         block_Release( p_block );
         return NULL;
     }
 
+    /* Do not decode predicted pictures without their reference. Blocks
+     * without a frame type, or prerolled by a packetizer recovering from
+     * its own sync point, are trusted. */
+    if( p_sys->b_wait_keyframe )
+    {
+        if( ( p_block->i_flags & (BLOCK_FLAG_TYPE_P|BLOCK_FLAG_TYPE_B) ) &&
+            !( p_block->i_flags & (BLOCK_FLAG_TYPE_I|BLOCK_FLAG_PREROLL) ) )
+        {
+            block_Release( p_block );
+            return NULL;
+        }
+        p_sys->b_wait_keyframe = false;
+    }
+
     if( p_block->i_flags & BLOCK_FLAG_PREROLL )
     {
         /* Do not care about late frames when prerolling
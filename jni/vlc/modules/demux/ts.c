@@ -139,6 +139,11 @@ static void Close ( vlc_object_t * );
     "Separate teletex/dvbs pages into independent ES. " \
     "It can be useful to turn off this option when using stream output." )
 
+#define EPG_TEXT N_("Full EPG")
+#define EPG_LONGTEXT N_( \
+    "Decode the event schedule of every service. Otherwise only the " \
+    "current and next events of the selected programs are decoded." )
+
 vlc_module_begin ()
     set_description( N_("MPEG Transport Stream demuxer") )
     set_shortname ( "MPEG-TS" )
@@ -166,6 +171,7 @@ vlc_module_begin ()
     add_integer( "ts-dump-size", 16384, DUMPSIZE_TEXT,
                  DUMPSIZE_LONGTEXT, true )
     add_bool( "ts-split-es", true, SPLIT_ES_TEXT, SPLIT_ES_LONGTEXT, false )
+    add_bool( "ts-epg", false, EPG_TEXT, EPG_LONGTEXT, true )
 
     set_capability( "demux", 10 )
     set_callbacks( Open, Close )
@@ -277,6 +283,37 @@ typedef struct
 
 } ts_prg_psi_t;
 
+/* Sections already given to dvbpsi, indexed by a hash of their table_id,
+ * table_id_extension and section_number */
+#define TS_PSI_CACHE 256
+
+typedef struct
+{
+    uint32_t        i_key;
+    uint32_t        i_crc;      /* CRC_32 field */
+    int             i_version;  /* -1 if the entry is unused */
+} ts_psi_section_t;
+
+/* Follows the sections of a PSI pid to only push to dvbpsi the packets
+ * holding sections it has not seen yet */
+typedef struct
+{
+    int             i_cc;       /* -1 before the first packet */
+    bool            b_sync;     /* section boundaries are known */
+
+    /* Section being received, if i_size != 0 (-1 if its size is unknown) */
+    int             i_size;
+    int             i_done;
+    uint8_t         header[8];
+    int             i_header;
+    bool            b_push;     /* dvbpsi receives it */
+    bool            b_record;   /* it is entered in the cache when complete */
+    uint32_t        i_crc;      /* CRC of the bytes received so far */
+    uint32_t        i_crc_field;
+
+    ts_psi_section_t cache[TS_PSI_CACHE];
+} ts_psi_filter_t;
+
 typedef struct
 {
     /* for special PAT/SDT case */
@@ -288,6 +325,8 @@ typedef struct
     int             i_prg;
     ts_prg_psi_t    **prg;
 
+    ts_psi_filter_t filter;
+
 } ts_psi_t;
 
 typedef struct
@@ -298,10 +337,16 @@ typedef struct
     int         i_pes_gathered;
     block_t     *p_pes;
     block_t     **pp_last;
+    block_t     *p_pes_last;    /* Block receiving the payload */
+    size_t      i_pes_room;     /* Space left in p_pes_last */
 
     es_mpeg4_descriptor_t *p_mpeg4desc;
     int         b_gather;
 
+    /* Video is only gathered from a random access point on */
+    bool        b_wait_rap;
+    int         i_wait_pes;     /* PES dropped while waiting for it */
+
 } ts_es_t;
 
 typedef struct
@@ -327,6 +372,13 @@ typedef struct
 
 } ts_pid_t;
 
+/* A program sent to another es_out than the demux one */
+typedef struct
+{
+    int         i_number;
+    es_out_t    *out;
+} ts_prg_out_t;
+
 struct demux_sys_t
 {
     vlc_mutex_t     csa_lock;
@@ -337,9 +389,18 @@ struct demux_sys_t
     /* how many TS packet we read at once */
     int         i_ts_read;
 
+    /* Run of TS packets read from the stream, processed in place */
+    block_t     *p_batch;
+    int         i_batch_packets;
+
     /* All pid */
     ts_pid_t    pid[8192];
 
+    /* What Demux() does with the packets of each pid, for the current
+     * programs selection. Rebuilt when the pids or the selection change. */
+    uint8_t     pid_action[8192];
+    bool        b_pid_action_dirty;
+
     /* All PMT */
     bool        b_user_pmt;
     int         i_pmt;
@@ -362,6 +423,9 @@ struct demux_sys_t
 
     /* */
     bool        b_dvb_meta;
+    bool        b_epg;          /* EIT schedules are decoded */
+    bool        b_psi_rejected; /* dvbpsi ignored a new table */
+    uint32_t    crc32_table[256];
     int64_t     i_tdt_delta;
     int64_t     i_dvb_start;
     int64_t     i_dvb_length;
@@ -371,6 +435,10 @@ struct demux_sys_t
     int         i_current_program;
     vlc_list_t  programs_list;
 
+    /* Programs output apart (DEMUX_SET_GROUP_OUTPUT) */
+    int         i_prg_out;
+    ts_prg_out_t **prg_out;
+
     /* TS dump */
     char        *psz_file;  /* file to dump data in */
     FILE        *p_file;    /* filehandle */
@@ -395,14 +463,27 @@ static void PSINewTableCallBack( demux_t *, dvbpsi_handle,
                                  uint8_t  i_table_id, uint16_t i_extension );
 static int ChangeKeyCallback( vlc_object_t *, char const *, vlc_value_t, vlc_value_t, void * );
 
-static inline int PIDGet( block_t *p )
+static inline int PIDGet( const uint8_t *p )
 {
-    return ( (p->p_buffer[1]&0x1f)<<8 )|p->p_buffer[2];
+    return ( (p[1]&0x1f)<<8 )|p[2];
 }
 
-static bool GatherPES( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk );
+enum
+{
+    TS_PID_DROP = 0,    /* unknown, or not part of a selected program */
+    TS_PID_PSI,
+    TS_PID_PES,
+    TS_PID_PCR,         /* only the PCR is used */
+};
+static void UpdatePIDActions( demux_t *p_demux );
+
+static bool GatherPES( demux_t *p_demux, ts_pid_t *pid, uint8_t *p );
+static void PSIFilterInit( ts_psi_filter_t * );
+static void PSIHandle( demux_t *p_demux, ts_pid_t *pid, uint8_t *p );
+static void ESWaitRAP( ts_es_t *es );
+static bool PESIsRAP( const ts_es_t *es, const uint8_t *p, size_t i_size );
 
-static void PCRHandle( demux_t *p_demux, ts_pid_t *, block_t * );
+static void PCRHandle( demux_t *p_demux, ts_pid_t *, const uint8_t * );
 
 static iod_descriptor_t *IODNew( int , uint8_t * );
 static void              IODFree( iod_descriptor_t * );
@@ -412,6 +493,10 @@ static int UserPmt( demux_t *p_demux, const char * );
 
 static int  SetPIDFilter( demux_t *, int i_pid, bool b_selected );
 static void SetPrgFilter( demux_t *, int i_prg, bool b_selected );
+static bool ProgramIsSelected( demux_t *, uint16_t i_pgrm );
+static bool ProgramIsDemuxed( demux_t *, uint16_t i_pgrm );
+static es_out_t *ProgramOutput( demux_t *, int i_pgrm );
+static int SetPrgOutput( demux_t *, int i_pgrm, es_out_t * );
 
 #define TS_PACKET_SIZE_188 188
 #define TS_PACKET_SIZE_192 192
@@ -419,6 +504,20 @@ static void SetPrgFilter( demux_t *, int i_prg, bool b_selected );
 #define TS_PACKET_SIZE_MAX 204
 #define TS_TOPFIELD_HEADER 1320
 
+/* Packets are read by runs: one UDP datagram worth for live streams, and
+ * about 64 KiB when the stream can seek. Live streams use a few datagrams
+ * when they are descrambled, as CSA is much cheaper on many packets. */
+#define TS_BATCH_LIVE      7
+#define TS_BATCH_CSA       64
+#define TS_BATCH_SIZE      (64*1024)
+
+/* Minimum allocation for the payload of a PES of unknown size */
+#define TS_PES_CHUNK_MIN   4096
+
+/* Number of video PES dropped while waiting for a random access point
+ * before giving up (the stream may not signal any) */
+#define TS_RAP_WAIT_MAX    250
+
 /*****************************************************************************
  * Open
  *****************************************************************************/
@@ -627,10 +726,13 @@ static int Open( vlc_object_t *p_this )
 
     /* Init p_sys field */
     p_sys->b_dvb_meta = true;
+    p_sys->b_epg = var_InheritBool( p_demux, "ts-epg" );
+    p_sys->b_psi_rejected = false;
     p_sys->b_access_control = true;
     p_sys->i_current_program = 0;
     p_sys->programs_list.i_count = 0;
     p_sys->programs_list.p_values = NULL;
+    TAB_INIT( p_sys->i_prg_out, p_sys->prg_out );
     p_sys->i_tdt_delta = 0;
     p_sys->i_dvb_start = 0;
     p_sys->i_dvb_length = 0;
@@ -647,13 +749,30 @@ static int Open( vlc_object_t *p_this )
     }
     /* PID 8191 is padding */
     p_sys->pid[8191].b_seen = true;
+    p_sys->b_pid_action_dirty = true;
     p_sys->i_packet_size = i_packet_size;
     p_sys->b_udp_out = false;
     p_sys->fd = -1;
     p_sys->i_ts_read = 50;
+    bool b_can_seek;
+    stream_Control( p_demux->s, STREAM_CAN_SEEK, &b_can_seek );
+    p_sys->i_batch_packets = b_can_seek ? TS_BATCH_SIZE / i_packet_size
+                                        : TS_BATCH_LIVE;
+    p_sys->p_batch = NULL;
     p_sys->csa = NULL;
     p_sys->b_start_record = false;
 
+    /* Initialise CRC32 table */
+    for( uint32_t i = 0; i < 256; i++ )
+    {
+        uint32_t j, k = 0;
+
+        for( j = (i << 24) | 0x800000; j != 0x80000000; j <<= 1 )
+            k = (k << 1) ^ (((k ^ j) & 0x80000000) ? 0x04c11db7 : 0);
+
+        p_sys->crc32_table[i] = k;
+    }
+
     /* Init PAT handler */
     pat = &p_sys->pid[0];
     PIDInit( pat, true, NULL );
@@ -781,6 +900,9 @@ static int Open( vlc_object_t *p_this )
             else
                 p_sys->i_csa_pkt_size = i_pkt;
             msg_Dbg( p_demux, "decrypting %d bytes of packet", p_sys->i_csa_pkt_size );
+
+            if( !b_can_seek )
+                p_sys->i_batch_packets = TS_BATCH_CSA;
         }
         free( psz_csa2 );
     }
@@ -866,6 +988,10 @@ static void Close( vlc_object_t *p_this )
 
     free( p_sys->programs_list.p_values );
 
+    for( int i = 0; i < p_sys->i_prg_out; i++ )
+        free( p_sys->prg_out[i] );
+    TAB_CLEAN( p_sys->i_prg_out, p_sys->prg_out );
+
     /* If in dump mode, then close the file */
     if( p_sys->b_file_out )
     {
@@ -883,6 +1009,8 @@ static void Close( vlc_object_t *p_this )
         net_Close( p_sys->fd );
     }
 
+    if( p_sys->p_batch )
+        block_Release( p_sys->p_batch );
     free( p_sys->buffer );
     free( p_sys->psz_file );
 
@@ -921,6 +1049,8 @@ static int DemuxFile( demux_t *p_demux )
     const int i_bufsize = p_sys->i_packet_size * p_sys->i_ts_read;
     uint8_t   *p_buffer = p_sys->buffer; /* Put first on sync byte */
     const int i_data = stream_Read( p_demux->s, p_sys->buffer, i_bufsize );
+    uint8_t   *pp_csa[64];
+    int        i_csa = 0;
 
     if( i_data <= 0 && i_data < p_sys->i_packet_size )
     {
@@ -994,14 +1124,26 @@ static int DemuxFile( demux_t *p_demux )
         /* Test if user wants to decrypt it first */
         if( p_sys->csa )
         {
-            vlc_mutex_lock( &p_sys->csa_lock );
-            csa_Decrypt( p_demux->p_sys->csa, &p_buffer[i_pos], p_demux->p_sys->i_csa_pkt_size );
-            vlc_mutex_unlock( &p_sys->csa_lock );
+            pp_csa[i_csa++] = &p_buffer[i_pos];
+            if( i_csa == sizeof(pp_csa) / sizeof(*pp_csa) )
+            {
+                vlc_mutex_lock( &p_sys->csa_lock );
+                csa_DecryptBatch( p_sys->csa, pp_csa, i_csa, p_sys->i_csa_pkt_size );
+                vlc_mutex_unlock( &p_sys->csa_lock );
+                i_csa = 0;
+            }
         }
 
         i_pos += p_sys->i_packet_size;
     }
 
+    if( i_csa > 0 )
+    {
+        vlc_mutex_lock( &p_sys->csa_lock );
+        csa_DecryptBatch( p_sys->csa, pp_csa, i_csa, p_sys->i_csa_pkt_size );
+        vlc_mutex_unlock( &p_sys->csa_lock );
+    }
+
     /* Then write */
     const int i_write = fwrite( p_sys->buffer, 1, i_data, p_sys->p_file );
     if( i_write < 0 )
@@ -1015,71 +1157,153 @@ static int DemuxFile( demux_t *p_demux )
 }
 
 /*****************************************************************************
- * Demux:
+ * ReadTSPacket:
  *****************************************************************************/
-static int Demux( demux_t *p_demux )
+static int ResyncStream( demux_t *p_demux )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
-    bool b_wait_es = p_sys->i_pmt_es <= 0;
 
-    /* We read at most 100 TS packet or until a frame is completed */
-    for( int i_pkt = 0; i_pkt < p_sys->i_ts_read; i_pkt++ )
+    while( vlc_object_alive (p_demux) )
     {
-        bool         b_frame = false;
-        block_t     *p_pkt;
+        const uint8_t *p_peek;
+        int i_peek, i_skip = 0;
 
-        /* Get a new TS packet */
-        if( !( p_pkt = stream_Block( p_demux->s, p_sys->i_packet_size ) ) )
+        i_peek = stream_Peek( p_demux->s, &p_peek,
+                              p_sys->i_packet_size * 10 );
+        if( i_peek < p_sys->i_packet_size + 1 )
+            return VLC_EGENERIC;
+
+        while( i_skip < i_peek - p_sys->i_packet_size )
         {
-            msg_Dbg( p_demux, "eof ?" );
-            return 0;
+            if( p_peek[i_skip] == 0x47 &&
+                p_peek[i_skip + p_sys->i_packet_size] == 0x47 )
+            {
+                break;
+            }
+            i_skip++;
         }
 
-        /* Check sync byte and re-sync if needed */
-        if( p_pkt->p_buffer[0] != 0x47 )
-        {
-            msg_Warn( p_demux, "lost synchro" );
-            block_Release( p_pkt );
+        msg_Dbg( p_demux, "skipping %d bytes of garbage", i_skip );
+        stream_Read( p_demux->s, NULL, i_skip );
 
-            while( vlc_object_alive (p_demux) )
-            {
-                const uint8_t *p_peek;
-                int i_peek, i_skip = 0;
+        if( i_skip < i_peek - p_sys->i_packet_size )
+            return VLC_SUCCESS;
+    }
+    return VLC_EGENERIC;
+}
 
-                i_peek = stream_Peek( p_demux->s, &p_peek,
-                                      p_sys->i_packet_size * 10 );
-                if( i_peek < p_sys->i_packet_size + 1 )
-                {
-                    msg_Dbg( p_demux, "eof ?" );
-                    return 0;
-                }
+/* Descrambles the packets of a new run at once */
+static void DescrambleRun( demux_t *p_demux, block_t *p_run )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const size_t i_size = p_sys->i_packet_size;
+    uint8_t *pp_pkt[TS_BATCH_SIZE / TS_PACKET_SIZE_188];
+    int i_pkt = 0;
+
+    /* Only the packets GatherPES() would descramble, it still handles the
+     * ones that are not (yet) known when the run is read */
+    for( size_t i = 0; i + i_size <= p_run->i_buffer &&
+                       i_pkt < TS_BATCH_SIZE / TS_PACKET_SIZE_188; i += i_size )
+    {
+        uint8_t *p = &p_run->p_buffer[i];
+        if( p[0] != 0x47 )
+            break;
 
-                while( i_skip < i_peek - p_sys->i_packet_size )
-                {
-                    if( p_peek[i_skip] == 0x47 &&
-                        p_peek[i_skip + p_sys->i_packet_size] == 0x47 )
-                    {
-                        break;
-                    }
-                    i_skip++;
-                }
+        if( ( p[3]&0x80 ) && p_sys->pid_action[PIDGet( p )] == TS_PID_PES )
+            pp_pkt[i_pkt++] = p;
+    }
 
-                msg_Dbg( p_demux, "skipping %d bytes of garbage", i_skip );
-                stream_Read( p_demux->s, NULL, i_skip );
+    vlc_mutex_lock( &p_sys->csa_lock );
+    csa_DecryptBatch( p_sys->csa, pp_pkt, i_pkt, p_sys->i_csa_pkt_size );
+    vlc_mutex_unlock( &p_sys->csa_lock );
+}
 
-                if( i_skip < i_peek - p_sys->i_packet_size )
-                {
-                    break;
-                }
-            }
+/* Returns the next TS packet, from the current run of packets.
+ * The packet is valid until the next call. */
+static uint8_t *ReadTSPacket( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const size_t i_size = p_sys->i_packet_size;
+
+    for( ;; )
+    {
+        block_t *p_batch = p_sys->p_batch;
 
-            if( !( p_pkt = stream_Block( p_demux->s, p_sys->i_packet_size ) ) )
+        /* Get a new run of packets */
+        if( p_batch == NULL || p_batch->i_buffer < i_size )
+        {
+            if( p_batch )
+                block_Release( p_batch );
+            p_sys->p_batch = p_batch =
+                stream_Block( p_demux->s, i_size * p_sys->i_batch_packets );
+            if( p_batch == NULL || p_batch->i_buffer < i_size )
             {
                 msg_Dbg( p_demux, "eof ?" );
-                return 0;
+                return NULL;
+            }
+            if( p_sys->csa && !p_sys->b_udp_out )
+            {
+                if( p_sys->b_pid_action_dirty )
+                    UpdatePIDActions( p_demux );
+                DescrambleRun( p_demux, p_batch );
             }
         }
 
+        /* Check sync byte */
+        if( p_batch->p_buffer[0] == 0x47 )
+        {
+            uint8_t *p_pkt = p_batch->p_buffer;
+
+            p_batch->p_buffer += i_size;
+            p_batch->i_buffer -= i_size;
+            return p_pkt;
+        }
+
+        /* Re-sync, within the run if possible */
+        msg_Warn( p_demux, "lost synchro" );
+
+        size_t i_skip = 1;
+        while( i_skip + i_size < p_batch->i_buffer &&
+               ( p_batch->p_buffer[i_skip] != 0x47 ||
+                 p_batch->p_buffer[i_skip + i_size] != 0x47 ) )
+            i_skip++;
+
+        if( i_skip + i_size < p_batch->i_buffer )
+        {
+            msg_Dbg( p_demux, "skipping %zu bytes of garbage", i_skip );
+            p_batch->p_buffer += i_skip;
+            p_batch->i_buffer -= i_skip;
+            continue;
+        }
+
+        block_Release( p_batch );
+        p_sys->p_batch = NULL;
+        if( ResyncStream( p_demux ) )
+        {
+            msg_Dbg( p_demux, "eof ?" );
+            return NULL;
+        }
+    }
+}
+
+/*****************************************************************************
+ * Demux:
+ *****************************************************************************/
+static int Demux( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    bool b_wait_es = p_sys->i_pmt_es <= 0;
+
+    /* We read at most 100 TS packet or until a frame is completed */
+    for( int i_pkt = 0; i_pkt < p_sys->i_ts_read; i_pkt++ )
+    {
+        bool         b_frame = false;
+        uint8_t     *p_pkt;
+
+        /* Get a new TS packet */
+        if( !( p_pkt = ReadTSPacket( p_demux ) ) )
+            return 0;
+
         if( p_sys->b_start_record )
         {
             /* Enable recording once synchronized */
@@ -1090,51 +1314,39 @@ static int Demux( demux_t *p_demux )
         if( p_sys->b_udp_out )
         {
             memcpy( &p_sys->buffer[i_pkt * p_sys->i_packet_size],
-                    p_pkt->p_buffer, p_sys->i_packet_size );
+                    p_pkt, p_sys->i_packet_size );
         }
 
         /* Parse the TS packet */
-        ts_pid_t *p_pid = &p_sys->pid[PIDGet( p_pkt )];
+        if( p_sys->b_pid_action_dirty )
+            UpdatePIDActions( p_demux );
+
+        const int i_pid = PIDGet( p_pkt );
+        ts_pid_t *p_pid = &p_sys->pid[i_pid];
 
-        if( p_pid->b_valid )
+        if( !p_pid->b_seen && !p_pid->b_valid )
         {
-            if( p_pid->psi )
-            {
-                if( p_pid->i_pid == 0 || ( p_sys->b_dvb_meta && ( p_pid->i_pid == 0x11 || p_pid->i_pid == 0x12 || p_pid->i_pid == 0x14 ) ) )
-                {
-                    dvbpsi_PushPacket( p_pid->psi->handle, p_pkt->p_buffer );
-                }
-                else
-                {
-                    for( int i_prg = 0; i_prg < p_pid->psi->i_prg; i_prg++ )
-                    {
-                        dvbpsi_PushPacket( p_pid->psi->prg[i_prg]->handle,
-                                           p_pkt->p_buffer );
-                    }
-                }
-                block_Release( p_pkt );
-            }
-            else if( !p_sys->b_udp_out )
-            {
-                b_frame = GatherPES( p_demux, p_pid, p_pkt );
-            }
-            else
-            {
-                PCRHandle( p_demux, p_pid, p_pkt );
-                block_Release( p_pkt );
-            }
+            msg_Dbg( p_demux, "pid[%d] unknown", i_pid );
         }
-        else
+        p_pid->b_seen = true;
+
+        switch( p_sys->pid_action[i_pid] )
         {
-            if( !p_pid->b_seen )
-            {
-                msg_Dbg( p_demux, "pid[%d] unknown", p_pid->i_pid );
-            }
-            /* We have to handle PCR if present */
+        case TS_PID_PSI:
+            PSIHandle( p_demux, p_pid, p_pkt );
+            break;
+
+        case TS_PID_PES:
+            b_frame = GatherPES( p_demux, p_pid, p_pkt );
+            break;
+
+        case TS_PID_PCR:
             PCRHandle( p_demux, p_pid, p_pkt );
-            block_Release( p_pkt );
+            break;
+
+        default:
+            break;
         }
-        p_pid->b_seen = true;
 
         if( b_frame || ( b_wait_es && p_sys->i_pmt_es > 0 ) )
             break;
@@ -1201,6 +1413,9 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
         if( i64 > 0 )
         {
             double f_current = stream_Tell( p_demux->s );
+            /* Packets of the current run are not demuxed yet */
+            if( p_sys->p_batch )
+                f_current -= p_sys->p_batch->i_buffer;
             *pf = f_current / (double)i64;
         }
         else
@@ -1219,6 +1434,16 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
         if( stream_Seek( p_demux->s, (int64_t)(i64 * f) ) )
             return VLC_EGENERIC;
 
+        if( p_sys->p_batch )
+        {
+            block_Release( p_sys->p_batch );
+            p_sys->p_batch = NULL;
+        }
+        for( int i = 0; i < 8192; i++ )
+        {
+            if( p_sys->pid_action[i] == TS_PID_PES )
+                ESWaitRAP( p_sys->pid[i].es );
+        }
         return VLC_SUCCESS;
 #if 0
 
@@ -1262,6 +1487,7 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
         i_int = (int)va_arg( args, int );
         p_list = (vlc_list_t *)va_arg( args, vlc_list_t * );
         msg_Dbg( p_demux, "DEMUX_SET_GROUP %d %p", i_int, p_list );
+        p_sys->b_pid_action_dirty = true;
 
         if( i_int == 0 && p_sys->i_current_program > 0 )
             i_int = p_sys->i_current_program;
@@ -1307,6 +1533,17 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
         return VLC_SUCCESS;
     }
 
+    case DEMUX_SET_GROUP_OUTPUT:
+    {
+        i_int = (int)va_arg( args, int );
+        es_out_t *out = (es_out_t *)va_arg( args, es_out_t * );
+        msg_Dbg( p_demux, "DEMUX_SET_GROUP_OUTPUT %d %p", i_int, (void *)out );
+
+        if( i_int <= 0 || p_sys->b_udp_out )
+            return VLC_EGENERIC;
+        return SetPrgOutput( p_demux, i_int, out );
+    }
+
     case DEMUX_CAN_RECORD:
         pb_bool = (bool*)va_arg( args, bool * );
         *pb_bool = true;
@@ -1433,7 +1670,7 @@ static int UserPmt( demux_t *p_demux, const char *psz_fmt )
             {
                 msg_Dbg( p_demux, "  * es pid=%d fcc=%4.4s", i_pid,
                          (char*)&pid->es->fmt.i_codec );
-                pid->es->id = es_out_Add( p_demux->out,
+                pid->es->id = es_out_Add( ProgramOutput( p_demux, i_number ),
                                           &pid->es->fmt );
                 p_sys->i_pmt_es++;
             }
@@ -1444,6 +1681,7 @@ static int UserPmt( demux_t *p_demux, const char *psz_fmt )
     }
 
     p_sys->b_user_pmt = true;
+    p_sys->b_pid_action_dirty = true;
     TAB_APPEND( p_sys->i_pmt, p_sys->pmt, pmt );
     free( psz_dup );
     return VLC_SUCCESS;
@@ -1470,6 +1708,10 @@ static void SetPrgFilter( demux_t *p_demux, int i_prg_id, bool b_selected )
     ts_prg_psi_t *p_prg = NULL;
     int i_pmt_pid = -1;
 
+    /* A program output apart stays demuxed whatever the selection */
+    if( !b_selected && ProgramOutput( p_demux, i_prg_id ) != p_demux->out )
+        return;
+
     /* Search pmt to be unselected */
     for( int i = 0; i < p_sys->i_pmt; i++ )
     {
@@ -1515,6 +1757,109 @@ static void SetPrgFilter( demux_t *p_demux, int i_prg_id, bool b_selected )
     }
 }
 
+static int SetPrgOutput( demux_t *p_demux, int i_pgrm, es_out_t *out )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    es_out_t *old_out = ProgramOutput( p_demux, i_pgrm );
+    es_out_t *new_out = out ? out : p_demux->out;
+    ts_prg_out_t *p_prg_out = NULL;
+
+    if( old_out == new_out )
+        return VLC_SUCCESS;
+    if( out )
+    {
+        p_prg_out = malloc( sizeof(*p_prg_out) );
+        if( !p_prg_out )
+            return VLC_ENOMEM;
+        p_prg_out->i_number = i_pgrm;
+        p_prg_out->out = out;
+    }
+
+    for( int i = 0; i < p_sys->i_prg_out; i++ )
+    {
+        if( p_sys->prg_out[i]->i_number == i_pgrm )
+        {
+            free( p_sys->prg_out[i] );
+            TAB_REMOVE( p_sys->i_prg_out, p_sys->prg_out, p_sys->prg_out[i] );
+            break;
+        }
+    }
+    if( p_prg_out )
+        TAB_APPEND( p_sys->i_prg_out, p_sys->prg_out, p_prg_out );
+
+    /* Move the ES already declared, the new decoders start at a random
+     * access point */
+    for( int i = 0; i < 8192; i++ )
+    {
+        ts_pid_t *pid = &p_sys->pid[i];
+
+        if( !pid->b_valid || pid->psi || pid->es->fmt.i_group != i_pgrm )
+            continue;
+
+        if( pid->es->id )
+        {
+            es_out_Del( old_out, pid->es->id );
+            pid->es->id = es_out_Add( new_out, &pid->es->fmt );
+            ESWaitRAP( pid->es );
+        }
+        for( int j = 0; j < pid->i_extra_es; j++ )
+        {
+            if( !pid->extra_es[j]->id )
+                continue;
+            es_out_Del( old_out, pid->extra_es[j]->id );
+            pid->extra_es[j]->id = es_out_Add( new_out, &pid->extra_es[j]->fmt );
+        }
+    }
+
+    if( !ProgramIsSelected( p_demux, i_pgrm ) )
+        SetPrgFilter( p_demux, i_pgrm, out != NULL );
+    p_sys->b_pid_action_dirty = true;
+    return VLC_SUCCESS;
+}
+
+static void UpdatePIDActions( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    for( int i = 0; i < 8192; i++ )
+    {
+        ts_pid_t *pid = &p_sys->pid[i];
+        uint8_t i_action = TS_PID_DROP;
+
+        if( !pid->b_valid )
+            ;
+        else if( pid->psi )
+            i_action = TS_PID_PSI;
+        else if( !p_sys->b_udp_out &&
+                 ( pid->i_owner_number == TS_USER_PMT_NUMBER ||
+                   ProgramIsDemuxed( p_demux, pid->i_owner_number ) ) )
+            i_action = TS_PID_PES;
+
+        /* The stream starts or the program has been zapped to */
+        if( i_action == TS_PID_PES && p_sys->pid_action[i] != TS_PID_PES )
+            ESWaitRAP( pid->es );
+
+        p_sys->pid_action[i] = i_action;
+    }
+
+    /* The PCR of every program keeps its clock running, even when its
+     * elementary streams are dropped */
+    for( int i = 0; i < p_sys->i_pmt; i++ )
+    {
+        const ts_psi_t *psi = p_sys->pmt[i]->psi;
+
+        for( int i_prg = 0; i_prg < psi->i_prg; i_prg++ )
+        {
+            const int i_pid_pcr = psi->prg[i_prg]->i_pid_pcr;
+
+            if( i_pid_pcr > 0 && i_pid_pcr < 8191 &&
+                p_sys->pid_action[i_pid_pcr] == TS_PID_DROP )
+                p_sys->pid_action[i_pid_pcr] = TS_PID_PCR;
+        }
+    }
+    p_sys->b_pid_action_dirty = false;
+}
+
 static void PIDInit( ts_pid_t *pid, bool b_psi, ts_psi_t *p_owner )
 {
     bool b_old_valid = pid->b_valid;
@@ -1541,6 +1886,7 @@ static void PIDInit( ts_pid_t *pid, bool b_psi, ts_psi_t *p_owner )
 
         pid->psi->i_pat_version  = -1;
         pid->psi->i_sdt_version  = -1;
+        PSIFilterInit( &pid->psi->filter );
         if( p_owner )
         {
             ts_prg_psi_t *prg = malloc( sizeof( ts_prg_psi_t ) );
@@ -1570,8 +1916,11 @@ static void PIDInit( ts_pid_t *pid, bool b_psi, ts_psi_t *p_owner )
             pid->es->i_pes_size= 0;
             pid->es->i_pes_gathered= 0;
             pid->es->pp_last = &pid->es->p_pes;
+            pid->es->i_pes_room = 0;
             pid->es->p_mpeg4desc = NULL;
             pid->es->b_gather = false;
+            pid->es->b_wait_rap = false;
+            pid->es->i_wait_pes = 0;
         }
     }
 }
@@ -1579,7 +1928,6 @@ static void PIDInit( ts_pid_t *pid, bool b_psi, ts_psi_t *p_owner )
 static void PIDClean( demux_t *p_demux, ts_pid_t *pid )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
-    es_out_t *out = p_demux->out;
 
     if( pid->psi )
     {
@@ -1598,6 +1946,8 @@ static void PIDClean( demux_t *p_demux, ts_pid_t *pid )
     }
     else
     {
+        es_out_t *out = ProgramOutput( p_demux, pid->es->fmt.i_group );
+
         if( pid->es->id )
         {
             es_out_Del( out, pid->es->id );
@@ -1651,6 +2001,7 @@ static void ParsePES( demux_t *p_demux, ts_pid_t *pid )
     pid->es->i_pes_size= 0;
     pid->es->i_pes_gathered= 0;
     pid->es->pp_last = &pid->es->p_pes;
+    pid->es->i_pes_room = 0;
 
     /* FIXME find real max size */
     /* const int i_max = */ block_ChainExtract( p_pes, header, 34 );
@@ -1834,13 +2185,14 @@ static void ParsePES( demux_t *p_demux, ts_pid_t *pid )
             p_block->p_buffer[p_block->i_buffer -1] = '\0';
         }
 
+        es_out_t *out = ProgramOutput( p_demux, pid->es->fmt.i_group );
         for( i = 0; i < pid->i_extra_es; i++ )
         {
-            es_out_Send( p_demux->out, pid->extra_es[i]->id,
+            es_out_Send( out, pid->extra_es[i]->id,
                          block_Duplicate( p_block ) );
         }
 
-        es_out_Send( p_demux->out, pid->es->id, p_block );
+        es_out_Send( out, pid->es->id, p_block );
     }
     else
     {
@@ -1848,10 +2200,321 @@ static void ParsePES( demux_t *p_demux, ts_pid_t *pid )
     }
 }
 
-static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
+/*****************************************************************************
+ * PSI sections pre-check
+ *****************************************************************************
+ * Tables are repeated a few times per second while they seldom change, so
+ * the sections of a PSI pid are followed here. A section whose table_id,
+ * extension, number and version match one already received is not given
+ * again to dvbpsi, nor are the sections of the tables that are not used.
+ * A packet is only pushed if a section it holds goes to dvbpsi.
+ *****************************************************************************/
+static void PSIFilterFlush( ts_psi_filter_t *f )
+{
+    for( int i = 0; i < TS_PSI_CACHE; i++ )
+        f->cache[i].i_version = -1;
+}
+
+static void PSIFilterInit( ts_psi_filter_t *f )
+{
+    f->i_cc = -1;
+    f->b_sync = false;
+    f->i_size = 0;
+    PSIFilterFlush( f );
+}
+
+static uint32_t PSISectionKey( const uint8_t *p_header )
+{
+    return ( p_header[0] << 24 ) | ( p_header[3] << 16 ) |
+           ( p_header[4] << 8 ) | p_header[6];
+}
+
+static ts_psi_section_t *PSISectionEntry( ts_psi_filter_t *f, uint32_t i_key )
+{
+    const uint32_t i_hash = i_key ^ ( i_key >> 8 ) ^ ( i_key >> 24 );
+    return &f->cache[i_hash % TS_PSI_CACHE];
+}
+
+/* Tells if a section of this table is used by the demuxer */
+static bool PSISectionWanted( demux_t *p_demux, int i_pid,
+                              const uint8_t *p_header )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const uint8_t i_table_id = p_header[0];
+
+    if( i_pid == 0 )
+        return i_table_id == 0x00;
+    if( !p_sys->b_dvb_meta || ( i_pid != 0x11 && i_pid != 0x12 && i_pid != 0x14 ) )
+        return i_table_id == 0x02;
+
+    switch( i_pid )
+    {
+    case 0x11:
+        return i_table_id == 0x42;
+    case 0x12:
+        /* The present/following events of the selected programs give the
+         * time and length of live streams */
+        if( i_table_id == 0x4e )
+            return p_sys->b_epg ||
+                   ProgramIsDemuxed( p_demux, GetWBE( &p_header[3] ) );
+        return p_sys->b_epg && i_table_id >= 0x50 && i_table_id <= 0x5f;
+    default:
+        return true;
+    }
+}
+
+/* Starts a section at p, where i_size bytes of the packet are left */
+static void PSIFilterStart( demux_t *p_demux, ts_pid_t *pid,
+                            const uint8_t *p, int i_size )
+{
+    ts_psi_filter_t *f = &pid->psi->filter;
+
+    f->i_size = -1;
+    f->i_done = 0;
+    f->i_header = 0;
+    f->i_crc = 0xffffffff;
+    f->i_crc_field = 0;
+
+    /* A header split over two packets is not checked */
+    if( i_size < 8 )
+    {
+        f->b_push = true;
+        f->b_record = false;
+        return;
+    }
+
+    f->b_push = true;
+    f->b_record = ( p[1]&0x80 ) && ( p[5]&0x01 );   /* syntax, current */
+
+    if( !PSISectionWanted( p_demux, pid->i_pid, p ) )
+    {
+        f->b_push = false;
+        f->b_record = false;
+    }
+    else if( f->b_record )
+    {
+        const uint32_t i_key = PSISectionKey( p );
+        const ts_psi_section_t *s = PSISectionEntry( f, i_key );
+
+        if( s->i_version == ( ( p[5] >> 1 )&0x1f ) && s->i_key == i_key )
+        {
+            f->b_push = false;
+            f->b_record = false;
+        }
+    }
+}
+
+/* Ends the current section: it is entered in the cache if it was pushed
+ * with a valid CRC, else its CRC_32 field is checked against the cache */
+static void PSIFilterEnd( ts_psi_filter_t *f )
+{
+    f->i_size = 0;
+    if( f->i_header < 8 || !( f->header[1]&0x80 ) )
+        return;
+
+    const uint32_t i_key = PSISectionKey( f->header );
+    const int i_version = ( f->header[5] >> 1 )&0x1f;
+    ts_psi_section_t *s = PSISectionEntry( f, i_key );
+
+    if( f->b_record )
+    {
+        if( f->i_crc == 0 )
+        {
+            s->i_key = i_key;
+            s->i_crc = f->i_crc_field;
+            s->i_version = i_version;
+        }
+    }
+    else if( !f->b_push && s->i_key == i_key && s->i_version == i_version &&
+             s->i_crc != f->i_crc_field )
+    {
+        /* Same version but another content: push it next time */
+        s->i_version = -1;
+    }
+}
+
+/* Follows the bytes [i_pos, i_end[ of the packet. Sections may only begin
+ * there if b_start is set. Returns true if dvbpsi needs some of them. */
+static bool PSIFilterBytes( demux_t *p_demux, ts_pid_t *pid, const uint8_t *p,
+                            int i_pos, int i_end, bool b_start )
+{
+    ts_psi_filter_t *f = &pid->psi->filter;
+    const uint32_t *crc32_table = p_demux->p_sys->crc32_table;
+    const bool b_pointed = b_start;
+    bool b_push = false;
+
+    while( i_pos < i_end )
+    {
+        if( f->i_size == 0 )
+        {
+            if( !b_start || p[i_pos] == 0xff )  /* stuffing */
+                break;
+            /* A section not pointed to by the pointer_field is only found
+             * by dvbpsi after the previous one: push them all next time */
+            if( !b_pointed && !f->b_push )
+                PSIFilterFlush( f );
+            PSIFilterStart( p_demux, pid, &p[i_pos], i_end - i_pos );
+        }
+
+        int i_copy = i_end - i_pos;
+        if( f->i_size < 0 )
+            i_copy = __MIN( i_copy, 3 - f->i_header );
+        else
+            i_copy = __MIN( i_copy, f->i_size - f->i_done );
+
+        const uint8_t *p_data = &p[i_pos];
+        for( int i = 0; i < i_copy && f->i_header < 8; i++ )
+            f->header[f->i_header++] = p_data[i];
+
+        if( f->b_record )
+        {
+            for( int i = 0; i < i_copy; i++ )
+                f->i_crc = ( f->i_crc << 8 ) ^
+                           crc32_table[( f->i_crc >> 24 ) ^ p_data[i]];
+        }
+        if( f->i_size > 0 )
+        {
+            /* Keep the CRC_32 field */
+            for( int i = __MAX( 0, f->i_size - 4 - f->i_done ); i < i_copy; i++ )
+                f->i_crc_field = ( f->i_crc_field << 8 ) | p_data[i];
+        }
+        b_push |= f->b_push;
+
+        i_pos += i_copy;
+        f->i_done += i_copy;
+
+        if( f->i_size < 0 && f->i_header >= 3 )
+        {
+            f->i_size = 3 + ( ( ( f->header[1]&0x0f ) << 8 ) | f->header[2] );
+            if( f->i_size > 4096 )
+            {
+                f->b_sync = false;
+                f->i_size = 0;
+                return true;
+            }
+        }
+        if( f->i_size > 0 && f->i_done >= f->i_size )
+        {
+            PSIFilterEnd( f );
+            b_start = true;
+        }
+    }
+    return b_push;
+}
+
+/* Returns true if the packet must be pushed to dvbpsi */
+static bool PSIFilter( demux_t *p_demux, ts_pid_t *pid, const uint8_t *p )
+{
+    ts_psi_filter_t *f = &pid->psi->filter;
+    const int i_cc = p[3]&0x0f;
+
+    /* dvbpsi drops duplicates itself */
+    if( i_cc == f->i_cc )
+        return true;
+
+    if( f->i_cc < 0 || i_cc != ( ( f->i_cc + 1 )&0x0f ) )
+    {
+        /* dvbpsi forgets the sections it was gathering */
+        PSIFilterFlush( f );
+        f->b_sync = false;
+        f->i_size = 0;
+    }
+    f->i_cc = i_cc;
+
+    /* Transport errors, scrambled or payload-less packets */
+    if( ( p[1]&0x80 ) || ( p[3]&0xd0 ) != 0x10 )
+    {
+        f->b_sync = false;
+        f->i_size = 0;
+        return true;
+    }
+
+    int i_pos = 4;
+    if( p[3]&0x20 )
+        i_pos += 1 + p[4];
+
+    bool b_push = !f->b_sync;
+    if( p[1]&0x40 )
+    {
+        if( i_pos >= TS_PACKET_SIZE_188 ||
+            i_pos + 1 + p[i_pos] > TS_PACKET_SIZE_188 )
+        {
+            f->b_sync = false;
+            f->i_size = 0;
+            return true;
+        }
+        const int i_pointer = p[i_pos++];
+
+        if( f->b_sync )
+            b_push |= PSIFilterBytes( p_demux, pid, p, i_pos, i_pos + i_pointer,
+                                      false );
+        if( f->i_size != 0 )
+        {
+            /* The pointer_field does not end the current section */
+            f->i_size = 0;
+            b_push = true;
+        }
+        f->b_sync = true;
+        b_push |= PSIFilterBytes( p_demux, pid, p, i_pos + i_pointer,
+                                  TS_PACKET_SIZE_188, true );
+    }
+    else if( f->b_sync )
+    {
+        b_push |= PSIFilterBytes( p_demux, pid, p, i_pos,
+                                  TS_PACKET_SIZE_188, false );
+    }
+    return b_push;
+}
+
+static void PSIHandle( demux_t *p_demux, ts_pid_t *pid, uint8_t *p )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    ts_psi_t *psi = pid->psi;
+    dvbpsi_handle *p_handle;
+    int i_handle;
+
+    if( pid->i_pid == 0 || ( p_sys->b_dvb_meta && ( pid->i_pid == 0x11 || pid->i_pid == 0x12 || pid->i_pid == 0x14 ) ) )
+    {
+        p_handle = &psi->handle;
+        i_handle = 1;
+    }
+    else
+    {
+        p_handle = NULL;
+        i_handle = psi->i_prg;
+    }
+
+    bool b_push = PSIFilter( p_demux, pid, p );
+    for( int i = 0; i < i_handle && !b_push; i++ )
+    {
+        dvbpsi_handle h = p_handle ? p_handle[i] : psi->prg[i]->handle;
+        b_push = h->p_current_section != NULL;
+    }
+
+    /* dvbpsi gathers the section left open by a pushed packet */
+    if( b_push && psi->filter.i_size != 0 )
+        psi->filter.b_push = true;
+
+    for( int i = 0; i < i_handle; i++ )
+    {
+        dvbpsi_handle h = p_handle ? p_handle[i] : psi->prg[i]->handle;
+
+        if( b_push )
+            dvbpsi_PushPacket( h, p );
+        else
+            h->i_continuity_counter = p[3]&0x0f; /* as if it was pushed */
+    }
+
+    if( p_sys->b_psi_rejected )
+    {
+        p_sys->b_psi_rejected = false;
+        PSIFilterFlush( &psi->filter );
+    }
+}
+
+static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, const uint8_t *p )
 {
     demux_sys_t   *p_sys = p_demux->p_sys;
-    const uint8_t *p = p_bk->p_buffer;
 
     if( p_sys->i_pmt_es <= 0 )
         return;
@@ -1874,8 +2537,9 @@ static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
             {
                 if( pid->i_pid == p_sys->pmt[i]->psi->prg[i_prg]->i_pid_pcr )
                 {
-                    es_out_Control( p_demux->out, ES_OUT_SET_GROUP_PCR,
-                                    (int)p_sys->pmt[i]->psi->prg[i_prg]->i_number,
+                    const int i_number = p_sys->pmt[i]->psi->prg[i_prg]->i_number;
+                    es_out_Control( ProgramOutput( p_demux, i_number ),
+                                    ES_OUT_SET_GROUP_PCR, i_number,
                                     (int64_t)(VLC_TS_0 + i_pcr * 100 / 9) );
                 }
             }
@@ -1883,15 +2547,103 @@ static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
     }
 }
 
-static bool GatherPES( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
+/* Appends TS payload to the PES being gathered. The PES is gathered in
+ * blocks of its announced size if any, else of growing size, so that the
+ * payload of consecutive packets is copied only once. */
+static void PESAppend( ts_es_t *es, const uint8_t *p_data, size_t i_data )
+{
+    while( i_data > 0 )
+    {
+        if( es->i_pes_room == 0 )
+        {
+            size_t i_alloc;
+
+            if( es->i_pes_size > es->i_pes_gathered )
+                i_alloc = es->i_pes_size - es->i_pes_gathered;
+            else
+                i_alloc = __MAX( es->i_pes_gathered, TS_PES_CHUNK_MIN );
+            i_alloc = __MAX( i_alloc, i_data );
+
+            block_t *p_bk = block_Alloc( i_alloc );
+            if( p_bk == NULL )
+                return;
+            p_bk->i_buffer = 0;
+
+            block_ChainLastAppend( &es->pp_last, p_bk );
+            es->p_pes_last = p_bk;
+            es->i_pes_room = i_alloc;
+        }
+
+        block_t *p_bk = es->p_pes_last;
+        const size_t i_copy = __MIN( i_data, es->i_pes_room );
+
+        memcpy( &p_bk->p_buffer[p_bk->i_buffer], p_data, i_copy );
+        p_bk->i_buffer += i_copy;
+        es->i_pes_room -= i_copy;
+        es->i_pes_gathered += i_copy;
+        p_data += i_copy;
+        i_data -= i_copy;
+    }
+}
+
+/* Makes a video ES wait for its next random access point */
+static void ESWaitRAP( ts_es_t *es )
+{
+    if( es == NULL || ( es->fmt.i_codec != VLC_CODEC_MPGV &&
+                        es->fmt.i_codec != VLC_CODEC_H264 ) )
+        return;
+    es->b_wait_rap = true;
+    es->i_wait_pes = 0;
+}
+
+/* Tells if the PES starting in this payload can be decoded on its own, ie
+ * if its first packet holds a MPEG video sequence header or a H264 SPS or
+ * IDR slice before any other picture data. */
+static bool PESIsRAP( const ts_es_t *es, const uint8_t *p, size_t i_size )
+{
+    if( i_size < 9 || p[0] != 0 || p[1] != 0 || p[2] != 1 ||
+        ( p[6]&0xC0 ) != 0x80 )
+        return false;
+
+    for( size_t i = 9 + p[8]; i + 4 <= i_size; i++ )
+    {
+        if( p[i] != 0 || p[i+1] != 0 || p[i+2] != 1 )
+            continue;
+
+        const uint8_t i_code = p[i+3];
+        if( es->fmt.i_codec == VLC_CODEC_MPGV )
+        {
+            if( i_code == 0xB3 )    /* sequence header */
+                return true;
+            if( i_code == 0x00 )    /* picture */
+                return false;
+        }
+        else
+        {
+            switch( i_code&0x1f )
+            {
+            case 5:     /* IDR slice */
+            case 7:     /* SPS */
+                return true;
+            case 1:     /* non IDR slice */
+                return false;
+            }
+        }
+        i += 2;
+    }
+    return false;
+}
+
+static bool GatherPES( demux_t *p_demux, ts_pid_t *pid, uint8_t *p )
 {
-    const uint8_t *p = p_bk->p_buffer;
     const bool b_unit_start = p[1]&0x40;
     const bool b_scrambled  = p[3]&0x80;
     const bool b_adaptation = p[3]&0x20;
     const bool b_payload    = p[3]&0x10;
     const int  i_cc         = p[3]&0x0f; /* continuity counter */
     bool       b_discontinuity = false;  /* discontinuity */
+    bool       b_rai = false;            /* random access indicator */
+    bool       b_rap = false;            /* PES starts a random access point */
 
     /* transport_scrambling_control is ignored */
     int         i_skip = 0;
@@ -1905,7 +2657,6 @@ static bool GatherPES( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
 
     /* For now, ignore additional error correction
      * TODO: handle Reed-Solomon 204,188 error correction */
-    p_bk->i_buffer = TS_PACKET_SIZE_188;
 
     if( p[1]&0x80 )
     {
@@ -1918,7 +2669,7 @@ static bool GatherPES( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
     if( p_demux->p_sys->csa )
     {
         vlc_mutex_lock( &p_demux->p_sys->csa_lock );
-        csa_Decrypt( p_demux->p_sys->csa, p_bk->p_buffer, p_demux->p_sys->i_csa_pkt_size );
+        csa_Decrypt( p_demux->p_sys->csa, p, p_demux->p_sys->i_csa_pkt_size );
         vlc_mutex_unlock( &p_demux->p_sys->csa_lock );
     }
 
@@ -1942,10 +2693,7 @@ static bool GatherPES( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
                             pid->i_pid );
                 /* pid->es->p_pes->i_flags |= BLOCK_FLAG_DISCONTINUITY; */
             }
-#if 0
-            if( p[5]&0x40 )
-                msg_Dbg( p_demux, "random access indicator (pid=%d) ", pid->i_pid );
-#endif
+            b_rai = (p[5]&0x40) ? true : false;
         }
     }
 
@@ -1984,13 +2732,10 @@ static bool GatherPES( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
         }
     }
 
-    PCRHandle( p_demux, pid, p_bk );
+    PCRHandle( p_demux, pid, p );
 
     if( i_skip >= 188 || pid->es->id == NULL || p_demux->p_sys->b_udp_out )
-    {
-        block_Release( p_bk );
         return i_ret;
-    }
 
     /* */
     if( !pid->b_scrambled != !b_scrambled )
@@ -2000,18 +2745,19 @@ static bool GatherPES( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
 
         pid->b_scrambled = b_scrambled;
 
+        es_out_t *out = ProgramOutput( p_demux, pid->es->fmt.i_group );
         for( int i = 0; i < pid->i_extra_es; i++ )
         {
-            es_out_Control( p_demux->out, ES_OUT_SET_ES_SCRAMBLED_STATE,
+            es_out_Control( out, ES_OUT_SET_ES_SCRAMBLED_STATE,
                             pid->extra_es[i]->id, b_scrambled );
         }
-        es_out_Control( p_demux->out, ES_OUT_SET_ES_SCRAMBLED_STATE,
+        es_out_Control( out, ES_OUT_SET_ES_SCRAMBLED_STATE,
                         pid->es->id, b_scrambled );
     }
 
     /* We have to gather it */
-    p_bk->p_buffer += i_skip;
-    p_bk->i_buffer -= i_skip;
+    const uint8_t *p_payload = &p[i_skip];
+    const size_t i_payload = TS_PACKET_SIZE_188 - i_skip;
 
     if( b_unit_start )
     {
@@ -2021,16 +2767,35 @@ static bool GatherPES( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
             i_ret = true;
         }
 
-        block_ChainLastAppend( &pid->es->pp_last, p_bk );
-        if( p_bk->i_buffer > 6 )
+        if( pid->es->b_wait_rap )
+        {
+            b_rap = b_rai || PESIsRAP( pid->es, p_payload, i_payload );
+
+            /* Continuation packets are dropped as no PES is gathered */
+            if( !b_rap && ++pid->es->i_wait_pes < TS_RAP_WAIT_MAX )
+                return i_ret;
+
+            if( b_rap )
+                msg_Dbg( p_demux, "starting at random access point "
+                         "(pid=%d, %d pes dropped)",
+                         pid->i_pid, pid->es->i_wait_pes );
+            else
+                msg_Warn( p_demux, "no random access point found (pid=%d)",
+                          pid->i_pid );
+            pid->es->b_wait_rap = false;
+        }
+
+        if( i_payload > 6 )
         {
-            pid->es->i_pes_size = GetWBE( &p_bk->p_buffer[4] );
+            pid->es->i_pes_size = GetWBE( &p_payload[4] );
             if( pid->es->i_pes_size > 0 )
             {
                 pid->es->i_pes_size += 6;
             }
         }
-        pid->es->i_pes_gathered += p_bk->i_buffer;
+        PESAppend( pid->es, p_payload, i_payload );
+        if( b_rap && pid->es->p_pes )
+            pid->es->p_pes->i_flags |= BLOCK_FLAG_TYPE_I;
         if( pid->es->i_pes_size > 0 &&
             pid->es->i_pes_gathered >= pid->es->i_pes_size )
         {
@@ -2043,12 +2808,10 @@ static bool GatherPES( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
         if( pid->es->p_pes == NULL )
         {
             /* msg_Dbg( p_demux, "broken packet" ); */
-            block_Release( p_bk );
         }
         else
         {
-            block_ChainLastAppend( &pid->es->pp_last, p_bk );
-            pid->es->i_pes_gathered += p_bk->i_buffer;
+            PESAppend( pid->es, p_payload, i_payload );
             if( pid->es->i_pes_size > 0 &&
                 pid->es->i_pes_gathered >= pid->es->i_pes_size )
             {
@@ -2565,6 +3328,26 @@ static bool ProgramIsSelected( demux_t *p_demux, uint16_t i_pgrm )
     return false;
 }
 
+/* Tells if the ES of a program are demuxed, for the demux es_out or
+ * another one */
+static bool ProgramIsDemuxed( demux_t *p_demux, uint16_t i_pgrm )
+{
+    return ProgramIsSelected( p_demux, i_pgrm ) ||
+           ProgramOutput( p_demux, i_pgrm ) != p_demux->out;
+}
+
+static es_out_t *ProgramOutput( demux_t *p_demux, int i_pgrm )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+
+    for( int i = 0; i < p_sys->i_prg_out; i++ )
+    {
+        if( p_sys->prg_out[i]->i_number == i_pgrm )
+            return p_sys->prg_out[i]->out;
+    }
+    return p_demux->out;
+}
+
 static void ValidateDVBMeta( demux_t *p_demux, int i_pid )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
@@ -3004,7 +3787,11 @@ static void PSINewTableCallBack( demux_t *p_demux, dvbpsi_handle h,
                            (dvbpsi_tot_callback)TDTCallBack, p_demux);
     }
 #endif
-
+    else
+    {
+        /* Its sections must be pushed again once it may be attached */
+        p_demux->p_sys->b_psi_rejected = true;
+    }
 }
 
 /*****************************************************************************
@@ -3286,6 +4073,7 @@ static void PMTSetupEsTeletext( demux_t *p_demux, ts_pid_t *pid,
                 p_es->i_pes_size = 0;
                 p_es->i_pes_gathered = 0;
                 p_es->pp_last = &p_es->p_pes;
+                p_es->i_pes_room = 0;
                 p_es->p_mpeg4desc = NULL;
                 p_es->b_gather = false;
 
@@ -3373,6 +4161,7 @@ static void PMTSetupEsDvbSubtitle( demux_t *p_demux, ts_pid_t *pid,
                 p_es->i_pes_size = 0;
                 p_es->i_pes_gathered = 0;
                 p_es->pp_last = &p_es->p_pes;
+                p_es->i_pes_room = 0;
                 p_es->p_mpeg4desc = NULL;
                 p_es->b_gather = false;
 
@@ -3831,7 +4620,7 @@ static void PMTCallBack( demux_t *p_demux, dvbpsi_pmt_t *p_pmt )
     prg->i_version = p_pmt->i_version;
 
     ValidateDVBMeta( p_demux, prg->i_pid_pcr );
-    if( ProgramIsSelected( p_demux, prg->i_number ) )
+    if( ProgramIsDemuxed( p_demux, prg->i_number ) )
     {
         /* Set demux filter */
         SetPIDFilter( p_demux, prg->i_pid_pcr, true );
@@ -3995,11 +4784,12 @@ static void PMTCallBack( demux_t *p_demux, dvbpsi_pmt_t *p_pmt )
                     old_pid = 0;
                 }
 
-                pid->es->id = es_out_Add( p_demux->out, &pid->es->fmt );
+                es_out_t *out = ProgramOutput( p_demux, prg->i_number );
+                pid->es->id = es_out_Add( out, &pid->es->fmt );
                 for( int i = 0; i < pid->i_extra_es; i++ )
                 {
                     pid->extra_es[i]->id =
-                        es_out_Add( p_demux->out, &pid->extra_es[i]->fmt );
+                        es_out_Add( out, &pid->extra_es[i]->fmt );
                 }
                 p_sys->i_pmt_es += 1 + pid->i_extra_es;
             }
@@ -4021,7 +4811,7 @@ static void PMTCallBack( demux_t *p_demux, dvbpsi_pmt_t *p_pmt )
                      i_sysid );
         }
 
-        if( ProgramIsSelected( p_demux, prg->i_number ) &&
+        if( ProgramIsDemuxed( p_demux, prg->i_number ) &&
             ( pid->es->id != NULL || p_sys->b_udp_out ) )
         {
             /* Set demux filter */
@@ -4030,14 +4820,14 @@ static void PMTCallBack( demux_t *p_demux, dvbpsi_pmt_t *p_pmt )
     }
 
     /* Set CAM descrambling */
-    if( !ProgramIsSelected( p_demux, prg->i_number )
+    if( !ProgramIsDemuxed( p_demux, prg->i_number )
      || stream_Control( p_demux->s, STREAM_CONTROL_ACCESS,
                         ACCESS_SET_PRIVATE_ID_CA, p_pmt ) != VLC_SUCCESS )
         dvbpsi_DeletePMT( p_pmt );
 
     for( int i = 0; i < i_clean; i++ )
     {
-        if( ProgramIsSelected( p_demux, prg->i_number ) )
+        if( ProgramIsDemuxed( p_demux, prg->i_number ) )
         {
             SetPIDFilter( p_demux, pp_clean[i]->i_pid, false );
         }
@@ -4046,6 +4836,8 @@ static void PMTCallBack( demux_t *p_demux, dvbpsi_pmt_t *p_pmt )
     }
     if( i_clean )
         free( pp_clean );
+
+    p_sys->b_pid_action_dirty = true;
 }
 
 static void PATCallBack( demux_t *p_demux, dvbpsi_pat_t *p_pat )
@@ -4139,6 +4931,9 @@ static void PATCallBack( demux_t *p_demux, dvbpsi_pat_t *p_pat )
             {
                 const int i_number = pmt_rm[i]->psi->prg[i_prg]->i_number;
                 es_out_Control( p_demux->out, ES_OUT_DEL_GROUP, i_number );
+                if( ProgramOutput( p_demux, i_number ) != p_demux->out )
+                    es_out_Control( ProgramOutput( p_demux, i_number ),
+                                    ES_OUT_DEL_GROUP, i_number );
             }
 
             PIDClean( p_demux, &p_sys->pid[pmt_rm[i]->i_pid] );
@@ -4191,18 +4986,18 @@ static void PATCallBack( demux_t *p_demux, dvbpsi_pat_t *p_pat )
                     p_program->i_pid;
 
                 /* Now select PID at access level */
-                if( ProgramIsSelected( p_demux, p_program->i_number ) )
-                {
-                    if( p_sys->i_current_program == 0 )
-                        p_sys->i_current_program = p_program->i_number;
+                if( ProgramIsSelected( p_demux, p_program->i_number ) &&
+                    p_sys->i_current_program == 0 )
+                    p_sys->i_current_program = p_program->i_number;
 
-                    if( SetPIDFilter( p_demux, p_program->i_pid, true ) )
-                        p_sys->b_access_control = false;
-                }
+                if( ProgramIsDemuxed( p_demux, p_program->i_number ) &&
+                    SetPIDFilter( p_demux, p_program->i_pid, true ) )
+                    p_sys->b_access_control = false;
             }
         }
     }
     pat->psi->i_pat_version = p_pat->i_version;
+    p_sys->b_pid_action_dirty = true;
 
     dvbpsi_DeletePAT( p_pat );
 }
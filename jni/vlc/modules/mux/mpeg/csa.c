@@ -610,3 +610,606 @@ static void csa_BlockCypher( uint8_t kk[57], uint8_t bd[8], uint8_t ib[8] )
     }
 }
 
+
+/*****************************************************************************
+ * Batch descrambler
+ *****************************************************************************
+ * The stream cypher is bitsliced: every bit of the cypher state is held in
+ * a machine word whose bit k belongs to the k-th packet of the batch, so a
+ * single pass of boolean operations clocks CSA_BATCH packets at once. The
+ * block cypher uses table lookups and is only byte-sliced (one byte per
+ * packet, per register).
+ *
+ * A lane k of a word is bit (k&7) of byte (k>>3) of its memory image, which
+ * is the same for every word type. Words are only loaded and stored with
+ * memcpy(), so the layout does not depend on the endianness.
+ *****************************************************************************/
+#if defined(__SSE2__)
+#   include <emmintrin.h>
+typedef __m128i csa_word_t;
+#   define CSA_BATCH    128
+#   define W_AND(a,b)   _mm_and_si128( a, b )
+#   define W_ANDN(a,b)  _mm_andnot_si128( b, a )
+#   define W_OR(a,b)    _mm_or_si128( a, b )
+#   define W_XOR(a,b)   _mm_xor_si128( a, b )
+#   define W_NOT(a)     _mm_xor_si128( a, _mm_set1_epi32( -1 ) )
+#   define W_ZERO       _mm_setzero_si128()
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#   include <arm_neon.h>
+typedef uint32x4_t csa_word_t;
+#   define CSA_BATCH    128
+#   define W_AND(a,b)   vandq_u32( a, b )
+#   define W_ANDN(a,b)  vbicq_u32( a, b )
+#   define W_OR(a,b)    vorrq_u32( a, b )
+#   define W_XOR(a,b)   veorq_u32( a, b )
+#   define W_NOT(a)     vmvnq_u32( a )
+#   define W_ZERO       vdupq_n_u32( 0 )
+#else
+#   if defined(__LP64__) || defined(_WIN64)
+typedef uint64_t csa_word_t;
+#       define CSA_BATCH    64
+#   else
+typedef uint32_t csa_word_t;
+#       define CSA_BATCH    32
+#   endif
+#   define W_AND(a,b)   ((a) & (b))
+#   define W_ANDN(a,b)  ((a) & ~(b))
+#   define W_OR(a,b)    ((a) | (b))
+#   define W_XOR(a,b)   ((a) ^ (b))
+#   define W_NOT(a)     (~(a))
+#   define W_ZERO       ((csa_word_t)0)
+#endif
+/* s ? b : a */
+#define W_MUX(s,a,b)    W_XOR( a, W_AND( s, W_XOR( a, b ) ) )
+
+/* Below this many packets of the same parity, the reference code is faster */
+#define CSA_BATCH_MIN   8
+
+typedef struct
+{
+    /* A[k] and B[k] (k=1..10) are a[k-1] and b[k-1]; the shift registers
+     * are clocked by moving a and b down their storage. */
+    csa_word_t (*a)[4];
+    csa_word_t (*b)[4];
+    csa_word_t A[32+10][4];
+    csa_word_t B[32+10][4];
+
+    csa_word_t X[4], Y[4], Z[4];
+    csa_word_t D[4], E[4], F[4];
+    csa_word_t p, q, r;
+} csa_batch_t;
+
+/* The s-boxes of the stream cypher as boolean functions of their inputs
+ * (x4 is the most significant bit of the sboxN[] index), derived from the
+ * tables above by Shannon expansion with shared cofactors. */
+static inline void csa_sbox1( csa_word_t o[2], csa_word_t x4, csa_word_t x3,
+                              csa_word_t x2, csa_word_t x1, csa_word_t x0 )
+{
+    const csa_word_t t0 = W_AND( x0, x4 );
+    const csa_word_t t1 = W_XOR( t0, x1 );
+    const csa_word_t t2 = W_NOT( x4 );
+    const csa_word_t t3 = W_XOR( t2, x0 );
+    const csa_word_t t4 = W_OR( x1, t3 );
+    const csa_word_t t5 = W_XOR( t1, W_AND( x3, t4 ) );
+    const csa_word_t t6 = W_AND( x0, t2 );
+    const csa_word_t t7 = W_NOT( t6 );
+    const csa_word_t t8 = W_NOT( t3 );
+    const csa_word_t t9 = W_OR( x0, t2 );
+    const csa_word_t t10 = W_NOT( t9 );
+    const csa_word_t t11 = W_XOR( x0, W_AND( x3, t10 ) );
+    const csa_word_t t12 = W_XOR( t5, W_AND( x2, t11 ) );
+    const csa_word_t t13 = W_XOR( t3, W_AND( x1, t7 ) );
+    const csa_word_t t14 = W_XOR( t8, W_AND( x1, t9 ) );
+    const csa_word_t t15 = W_XOR( t13, W_AND( x3, t14 ) );
+    const csa_word_t t16 = W_XOR( t8, W_AND( x1, t2 ) );
+    const csa_word_t t17 = W_OR( x3, t16 );
+    const csa_word_t t18 = W_XOR( t15, W_AND( x2, t17 ) );
+    o[0] = t12;
+    o[1] = t18;
+}
+
+static inline void csa_sbox2( csa_word_t o[2], csa_word_t x4, csa_word_t x3,
+                              csa_word_t x2, csa_word_t x1, csa_word_t x0 )
+{
+    const csa_word_t t0 = W_NOT( x3 );
+    const csa_word_t t1 = W_OR( W_NOT( x4 ), t0 );
+    const csa_word_t t2 = W_NOT( x4 );
+    const csa_word_t t3 = W_XOR( t1, W_AND( x2, t2 ) );
+    const csa_word_t t4 = W_XOR( t3, x1 );
+    const csa_word_t t5 = W_OR( x4, x3 );
+    const csa_word_t t6 = W_NOT( t1 );
+    const csa_word_t t7 = W_OR( x4, t0 );
+    const csa_word_t t8 = W_AND( x2, t7 );
+    const csa_word_t t9 = W_XOR( t8, W_AND( x1, t5 ) );
+    const csa_word_t t10 = W_XOR( t4, W_AND( x0, t9 ) );
+    const csa_word_t t11 = W_XOR( t0, W_AND( x2, t6 ) );
+    const csa_word_t t12 = W_XOR( t11, W_AND( x1, t3 ) );
+    const csa_word_t t13 = W_XOR( t1, x2 );
+    const csa_word_t t14 = W_OR( x1, t13 );
+    const csa_word_t t15 = W_XOR( t12, W_AND( x0, t14 ) );
+    o[0] = t10;
+    o[1] = t15;
+}
+
+static inline void csa_sbox3( csa_word_t o[2], csa_word_t x4, csa_word_t x3,
+                              csa_word_t x2, csa_word_t x1, csa_word_t x0 )
+{
+    const csa_word_t t0 = W_NOT( x4 );
+    const csa_word_t t1 = W_XOR( x4, x3 );
+    const csa_word_t t2 = W_NOT( t1 );
+    const csa_word_t t3 = W_XOR( t1, x1 );
+    const csa_word_t t4 = W_XOR( x1, x2 );
+    const csa_word_t t5 = W_XOR( t3, W_AND( x0, t4 ) );
+    const csa_word_t t6 = W_ANDN( t2, x1 );
+    const csa_word_t t7 = W_OR( x3, x4 );
+    const csa_word_t t8 = W_OR( x1, t7 );
+    const csa_word_t t9 = W_XOR( t6, W_AND( x2, t8 ) );
+    const csa_word_t t10 = W_OR( W_NOT( x3 ), x4 );
+    const csa_word_t t11 = W_XOR( t10, W_AND( x1, t1 ) );
+    const csa_word_t t12 = W_ANDN( t0, x1 );
+    const csa_word_t t13 = W_XOR( t11, W_AND( x2, t12 ) );
+    const csa_word_t t14 = W_XOR( t9, W_AND( x0, t13 ) );
+    o[0] = t5;
+    o[1] = t14;
+}
+
+static inline void csa_sbox4( csa_word_t o[2], csa_word_t x4, csa_word_t x3,
+                              csa_word_t x2, csa_word_t x1, csa_word_t x0 )
+{
+    const csa_word_t t0 = W_NOT( x1 );
+    const csa_word_t t1 = W_NOT( x3 );
+    const csa_word_t t2 = W_XOR( x3, x1 );
+    const csa_word_t t3 = W_XOR( t0, W_AND( x2, t1 ) );
+    const csa_word_t t4 = W_OR( x1, t1 );
+    const csa_word_t t5 = W_AND( x1, x3 );
+    const csa_word_t t6 = W_OR( x1, x3 );
+    const csa_word_t t7 = W_XOR( t3, W_AND( x0, t6 ) );
+    const csa_word_t t8 = W_NOT( t4 );
+    const csa_word_t t9 = W_NOT( t5 );
+    const csa_word_t t10 = W_XOR( t1, W_AND( x2, t9 ) );
+    const csa_word_t t11 = W_OR( x2, t0 );
+    const csa_word_t t12 = W_XOR( t10, W_AND( x0, t11 ) );
+    const csa_word_t t13 = W_XOR( t2, W_AND( x2, t8 ) );
+    const csa_word_t t14 = W_XOR( t4, W_AND( x2, x1 ) );
+    const csa_word_t t15 = W_XOR( t13, W_AND( x0, t14 ) );
+    const csa_word_t t16 = W_XOR( t7, W_AND( x4, t15 ) );
+    const csa_word_t t17 = W_NOT( t15 );
+    const csa_word_t t18 = W_XOR( t12, W_AND( x4, t17 ) );
+    o[0] = t16;
+    o[1] = t18;
+}
+
+static inline void csa_sbox5( csa_word_t o[2], csa_word_t x4, csa_word_t x3,
+                              csa_word_t x2, csa_word_t x1, csa_word_t x0 )
+{
+    const csa_word_t t0 = W_AND( x3, x1 );
+    const csa_word_t t1 = W_XOR( t0, x2 );
+    const csa_word_t t2 = W_OR( x3, x1 );
+    const csa_word_t t3 = W_NOT( x1 );
+    const csa_word_t t4 = W_XOR( x1, x3 );
+    const csa_word_t t5 = W_OR( x2, t4 );
+    const csa_word_t t6 = W_XOR( t1, W_AND( x0, t5 ) );
+    const csa_word_t t7 = W_OR( x3, t3 );
+    const csa_word_t t8 = W_NOT( t2 );
+    const csa_word_t t9 = W_AND( x3, t3 );
+    const csa_word_t t10 = W_XOR( t9, W_AND( x2, t3 ) );
+    const csa_word_t t11 = W_OR( x0, t10 );
+    const csa_word_t t12 = W_XOR( t6, W_AND( x4, t11 ) );
+    const csa_word_t t13 = W_NOT( t4 );
+    const csa_word_t t14 = W_NOT( t7 );
+    const csa_word_t t15 = W_XOR( t13, W_AND( x2, t14 ) );
+    const csa_word_t t16 = W_NOT( x3 );
+    const csa_word_t t17 = W_XOR( t8, W_AND( x2, t13 ) );
+    const csa_word_t t18 = W_XOR( t15, W_AND( x0, t17 ) );
+    const csa_word_t t19 = W_OR( x2, t14 );
+    const csa_word_t t20 = W_XOR( t16, W_AND( x2, t4 ) );
+    const csa_word_t t21 = W_XOR( t19, W_AND( x0, t20 ) );
+    const csa_word_t t22 = W_XOR( t18, W_AND( x4, t21 ) );
+    o[0] = t12;
+    o[1] = t22;
+}
+
+static inline void csa_sbox6( csa_word_t o[2], csa_word_t x4, csa_word_t x3,
+                              csa_word_t x2, csa_word_t x1, csa_word_t x0 )
+{
+    const csa_word_t t0 = W_NOT( x3 );
+    const csa_word_t t1 = W_XOR( t0, x0 );
+    const csa_word_t t2 = W_XOR( x0, W_AND( x2, t0 ) );
+    const csa_word_t t3 = W_AND( x0, t0 );
+    const csa_word_t t4 = W_OR( W_NOT( x0 ), t0 );
+    const csa_word_t t5 = W_OR( x0, x3 );
+    const csa_word_t t6 = W_XOR( x3, W_AND( x4, t3 ) );
+    const csa_word_t t7 = W_ANDN( t1, x4 );
+    const csa_word_t t8 = W_XOR( t6, W_AND( x2, t7 ) );
+    const csa_word_t t9 = W_XOR( t2, W_AND( x1, t8 ) );
+    const csa_word_t t10 = W_AND( x4, t4 );
+    const csa_word_t t11 = W_XOR( t10, W_AND( x2, t5 ) );
+    const csa_word_t t12 = W_XOR( t4, W_AND( x4, x0 ) );
+    const csa_word_t t13 = W_XOR( t11, W_AND( x1, t12 ) );
+    o[0] = t9;
+    o[1] = t13;
+}
+
+static inline void csa_sbox7( csa_word_t o[2], csa_word_t x4, csa_word_t x3,
+                              csa_word_t x2, csa_word_t x1, csa_word_t x0 )
+{
+    const csa_word_t t0 = W_NOT( x2 );
+    const csa_word_t t1 = W_XOR( x2, x0 );
+    const csa_word_t t2 = W_XOR( t1, x4 );
+    const csa_word_t t3 = W_OR( x0, x2 );
+    const csa_word_t t4 = W_XOR( t2, W_AND( x1, t3 ) );
+    const csa_word_t t5 = W_NOT( x0 );
+    const csa_word_t t6 = W_AND( x4, t5 );
+    const csa_word_t t7 = W_XOR( t0, W_AND( x1, t6 ) );
+    const csa_word_t t8 = W_XOR( t4, W_AND( x3, t7 ) );
+    const csa_word_t t9 = W_ANDN( t1, x4 );
+    const csa_word_t t10 = W_XOR( t5, W_AND( x4, t3 ) );
+    const csa_word_t t11 = W_XOR( t9, W_AND( x1, t10 ) );
+    const csa_word_t t12 = W_XOR( t5, W_AND( x4, t1 ) );
+    const csa_word_t t13 = W_OR( W_NOT( x1 ), t12 );
+    const csa_word_t t14 = W_XOR( t11, W_AND( x3, t13 ) );
+    o[0] = t8;
+    o[1] = t14;
+}
+
+/* Transpose a 8x8 bit matrix held as 8 rows of 8 bits */
+static inline uint64_t csa_Transpose8x8( uint64_t x )
+{
+    uint64_t t;
+
+    t = ( x ^ ( x >> 7 ) ) & UINT64_C(0x00AA00AA00AA00AA);
+    x ^= t ^ ( t << 7 );
+    t = ( x ^ ( x >> 14 ) ) & UINT64_C(0x0000CCCC0000CCCC);
+    x ^= t ^ ( t << 14 );
+    t = ( x ^ ( x >> 28 ) ) & UINT64_C(0x00000000F0F0F0F0);
+    x ^= t ^ ( t << 28 );
+    return x;
+}
+
+/* One byte per lane to 8 words, one per bit */
+static void csa_BatchSlice( csa_word_t w[8], const uint8_t p_byte[CSA_BATCH] )
+{
+    uint8_t bits[8][CSA_BATCH/8];
+
+    for( int i = 0; i < CSA_BATCH/8; i++ )
+    {
+        uint64_t x = 0;
+        for( int l = 0; l < 8; l++ )
+            x |= (uint64_t)p_byte[8*i+l] << (8*l);
+        x = csa_Transpose8x8( x );
+        for( int b = 0; b < 8; b++ )
+            bits[b][i] = x >> (8*b);
+    }
+    for( int b = 0; b < 8; b++ )
+        memcpy( &w[b], bits[b], sizeof(w[b]) );
+}
+
+/* 8 words, one per bit, to one byte per lane */
+static void csa_BatchUnslice( uint8_t p_byte[CSA_BATCH], const csa_word_t w[8] )
+{
+    uint8_t bits[8][CSA_BATCH/8];
+
+    for( int b = 0; b < 8; b++ )
+        memcpy( bits[b], &w[b], sizeof(w[b]) );
+    for( int i = 0; i < CSA_BATCH/8; i++ )
+    {
+        uint64_t x = 0;
+        for( int b = 0; b < 8; b++ )
+            x |= (uint64_t)bits[b][i] << (8*b);
+        x = csa_Transpose8x8( x );
+        for( int l = 0; l < 8; l++ )
+            p_byte[8*i+l] = x >> (8*l);
+    }
+}
+
+/* Bitsliced equivalent of one iteration of the csa_StreamCypher() inner
+ * loop. in_a and in_b are the input nibbles during initialisation, NULL
+ * afterwards. The two output bits (low first) are returned in out. */
+static inline void csa_BatchClock( csa_batch_t *s, const csa_word_t *in_a,
+                                   const csa_word_t *in_b, csa_word_t out[2] )
+{
+    csa_word_t (*a)[4] = s->a;
+    csa_word_t (*b)[4] = s->b;
+    csa_word_t s1[2], s2[2], s3[2], s4[2], s5[2], s6[2], s7[2];
+    csa_word_t extra[4], next_a[4], next_b[4], next_f[4];
+    csa_word_t carry = s->r;
+
+#define A(k,i) a[(k)-1][i]
+#define B(k,i) b[(k)-1][i]
+    csa_sbox1( s1, A(4,0), A(1,2), A(6,1), A(7,3), A(9,0) );
+    csa_sbox2( s2, A(2,1), A(3,2), A(6,3), A(7,0), A(9,1) );
+    csa_sbox3( s3, A(1,3), A(2,0), A(5,1), A(5,3), A(6,2) );
+    csa_sbox4( s4, A(3,3), A(1,1), A(2,3), A(4,2), A(8,0) );
+    csa_sbox5( s5, A(5,2), A(4,3), A(6,0), A(8,1), A(9,2) );
+    csa_sbox6( s6, A(3,1), A(4,1), A(5,0), A(7,2), A(9,3) );
+    csa_sbox7( s7, A(2,2), A(3,0), A(7,1), A(8,2), A(8,3) );
+
+    extra[3] = W_XOR( W_XOR( B(3,0), B(6,1) ), W_XOR( B(7,2), B(9,3) ) );
+    extra[2] = W_XOR( W_XOR( B(6,0), B(8,1) ), W_XOR( B(3,3), B(4,2) ) );
+    extra[1] = W_XOR( W_XOR( B(5,3), B(8,2) ), W_XOR( B(4,0), B(5,1) ) );
+    extra[0] = W_XOR( W_XOR( B(9,2), B(6,3) ), W_XOR( B(3,1), B(8,0) ) );
+
+    for( int i = 0; i < 4; i++ )
+    {
+        next_a[i] = W_XOR( A(10,i), s->X[i] );
+        next_b[i] = W_XOR( W_XOR( B(7,i), B(10,i) ), s->Y[i] );
+        if( in_a != NULL )
+        {
+            next_a[i] = W_XOR( next_a[i], W_XOR( s->D[i], in_a[i] ) );
+            next_b[i] = W_XOR( next_b[i], in_b[i] );
+        }
+    }
+#undef B
+#undef A
+
+    for( int i = 0; i < 4; i++ )
+    {
+        /* T4: F = q ? Z + E + r : E */
+        const csa_word_t z_e = W_XOR( s->Z[i], s->E[i] );
+        next_f[i] = W_MUX( s->q, s->E[i], W_XOR( z_e, carry ) );
+        carry = W_OR( W_AND( s->Z[i], s->E[i] ), W_AND( carry, z_e ) );
+
+        /* T3 */
+        s->D[i] = W_XOR( z_e, extra[i] );
+
+        s->E[i] = s->F[i];
+        s->F[i] = next_f[i];
+    }
+    s->r = W_MUX( s->q, s->r, carry );
+
+    /* Rotate B1 left if p is set, and clock the shift registers */
+    s->a = --a;
+    s->b = --b;
+    for( int i = 0; i < 4; i++ )
+    {
+        a[0][i] = next_a[i];
+        b[0][i] = W_MUX( s->p, next_b[i], next_b[(i+3)&3] );
+    }
+
+    s->X[0] = s1[1]; s->X[1] = s2[1]; s->X[2] = s3[0]; s->X[3] = s4[0];
+    s->Y[0] = s3[1]; s->Y[1] = s4[1]; s->Y[2] = s5[0]; s->Y[3] = s6[0];
+    s->Z[0] = s5[1]; s->Z[1] = s6[1]; s->Z[2] = s1[0]; s->Z[3] = s2[0];
+    s->p = s7[1];
+    s->q = s7[0];
+
+    out[0] = W_XOR( s->D[1], s->D[0] );
+    out[1] = W_XOR( s->D[3], s->D[2] );
+}
+
+/* Move the shift registers back to the top of their storage */
+static inline void csa_BatchRewind( csa_batch_t *s )
+{
+    memmove( &s->A[32], s->a, 10 * sizeof(s->A[0]) );
+    memmove( &s->B[32], s->b, 10 * sizeof(s->B[0]) );
+    s->a = &s->A[32];
+    s->b = &s->B[32];
+}
+
+/* Key setup and initialisation with the first 8 bytes of each payload */
+static void csa_BatchStreamInit( csa_batch_t *s, const uint8_t ck[8],
+                                 uint8_t sb[8][CSA_BATCH] )
+{
+    const csa_word_t zero = W_ZERO;
+    const csa_word_t ones = W_NOT( zero );
+
+    s->a = &s->A[32];
+    s->b = &s->B[32];
+    for( int i = 0; i < 4; i++ )
+    {
+        for( int j = 0; j < 4; j++ )
+        {
+            s->a[2*i+0][j] = ( ck[i]   >> (4+j) ) & 1 ? ones : zero;
+            s->a[2*i+1][j] = ( ck[i]   >> j     ) & 1 ? ones : zero;
+            s->b[2*i+0][j] = ( ck[4+i] >> (4+j) ) & 1 ? ones : zero;
+            s->b[2*i+1][j] = ( ck[4+i] >> j     ) & 1 ? ones : zero;
+        }
+    }
+    for( int j = 0; j < 4; j++ )
+    {
+        s->a[8][j] = s->a[9][j] = zero;
+        s->b[8][j] = s->b[9][j] = zero;
+        s->X[j] = s->Y[j] = s->Z[j] = zero;
+        s->D[j] = s->E[j] = s->F[j] = zero;
+    }
+    s->p = s->q = s->r = zero;
+
+    for( int i = 0; i < 8; i++ )
+    {
+        csa_word_t in[8], out[2];
+
+        csa_BatchSlice( in, sb[i] );
+        /* in1 is the high nibble, in2 the low one */
+        for( int j = 0; j < 4; j++ )
+            csa_BatchClock( s, (j&1) ? &in[0] : &in[4],
+                               (j&1) ? &in[4] : &in[0], out );
+    }
+    csa_BatchRewind( s );
+}
+
+/* Generate 8 bytes of key stream for each lane */
+static void csa_BatchStreamCypher( csa_batch_t *s, uint8_t cb[8][CSA_BATCH] )
+{
+    for( int i = 0; i < 8; i++ )
+    {
+        csa_word_t out[8];
+
+        /* Each clock gives the next two bits, most significant first */
+        for( int j = 0; j < 4; j++ )
+            csa_BatchClock( s, NULL, NULL, &out[6-2*j] );
+        csa_BatchUnslice( cb[i], out );
+    }
+    csa_BatchRewind( s );
+}
+
+/* Byte-sliced csa_BlockDecypher() of the first i_lanes lanes of R, in
+ * place. The registers end up permuted, bd[] points to the result. */
+static void csa_BatchBlockDecypher( const uint8_t kk[57], int i_lanes,
+                                    uint8_t R[8][CSA_BATCH], uint8_t *bd[8] )
+{
+    uint8_t sbox_out[CSA_BATCH], perm_out[CSA_BATCH];
+    uint8_t *r[8];
+
+    for( int i = 0; i < 8; i++ )
+        r[i] = R[i];
+
+    for( int i = 56; i > 0; i-- )
+    {
+        uint8_t *r1 = r[0], *r2 = r[1], *r3 = r[2], *r4 = r[3];
+        uint8_t *r5 = r[4], *r6 = r[5], *r7 = r[6], *r8 = r[7];
+
+        for( int l = 0; l < i_lanes; l++ )
+        {
+            sbox_out[l] = block_sbox[ kk[i] ^ r7[l] ];
+            perm_out[l] = block_perm[ sbox_out[l] ];
+        }
+        for( int l = 0; l < i_lanes; l++ )
+        {
+            const uint8_t t = r8[l] ^ sbox_out[l];
+
+            r8[l] = r6[l] ^ perm_out[l];    /* new R7 */
+            r6[l] = r4[l] ^ t;              /* new R5 */
+            r4[l] = r3[l] ^ t;
+            r3[l] = r2[l] ^ t;
+            r2[l] = t;                      /* new R1 */
+        }
+        r[0] = r2; r[1] = r1; r[2] = r3; r[3] = r4;
+        r[4] = r6; r[5] = r5; r[6] = r8; r[7] = r7;
+    }
+
+    for( int i = 0; i < 8; i++ )
+        bd[i] = r[i];
+}
+
+/* Descramble up to CSA_BATCH packets scrambled with the same key, each
+ * carrying at least one full 8 bytes block */
+static void csa_DecryptGroup( const uint8_t ck[8], const uint8_t kk[57],
+                              uint8_t **pp_pkt, int i_pkt, int i_pkt_size )
+{
+    csa_batch_t s;
+    uint8_t ib[8][CSA_BATCH];
+    uint8_t stream[8][CSA_BATCH];
+    uint8_t *bd[8];
+    int     i_hdr[CSA_BATCH], i_blocks[CSA_BATCH];
+    int     i_max_blocks = 0, i_max_stream = 0;
+
+    memset( ib, 0, sizeof(ib) );
+    for( int k = 0; k < i_pkt; k++ )
+    {
+        uint8_t *pkt = pp_pkt[k];
+
+        pkt[3] &= 0x3f;
+        i_hdr[k] = 4;
+        if( pkt[3]&0x20 )
+            i_hdr[k] += pkt[4] + 1;
+        i_blocks[k] = (i_pkt_size - i_hdr[k]) / 8;
+
+        /* Key stream is needed for every block but the last one, and for
+         * the residue */
+        const int i_stream = i_blocks[k] - 1
+                           + ( (i_pkt_size - i_hdr[k]) % 8 > 0 );
+        if( i_blocks[k] > i_max_blocks )
+            i_max_blocks = i_blocks[k];
+        if( i_stream > i_max_stream )
+            i_max_stream = i_stream;
+
+        for( int j = 0; j < 8; j++ )
+            ib[j][k] = pkt[i_hdr[k]+j];
+    }
+
+    csa_BatchStreamInit( &s, ck, ib );
+
+    for( int i = 1; i <= i_max_blocks; i++ )
+    {
+        csa_BatchBlockDecypher( kk, i_pkt, ib, bd );
+        if( i <= i_max_stream )
+            csa_BatchStreamCypher( &s, stream );
+
+        for( int k = 0; k < i_pkt; k++ )
+        {
+            uint8_t *pkt = pp_pkt[k];
+            uint8_t *p_block = &pkt[i_hdr[k] + 8*(i-1)];
+            uint8_t block[8];
+
+            if( i > i_blocks[k] )
+                continue;
+
+            for( int j = 0; j < 8; j++ )
+                block[j] = bd[j][k];
+
+            if( i != i_blocks[k] )
+            {
+                for( int j = 0; j < 8; j++ )
+                {
+                    ib[j][k] = p_block[8+j] ^ stream[j][k];
+                    p_block[j] = ib[j][k] ^ block[j];
+                }
+            }
+            else
+            {
+                /* last block, then the residue */
+                const int i_residue = (i_pkt_size - i_hdr[k]) % 8;
+
+                for( int j = 0; j < 8; j++ )
+                    p_block[j] = block[j];
+                for( int j = 0; j < i_residue; j++ )
+                    pkt[i_pkt_size - i_residue + j] ^= stream[j][k];
+            }
+        }
+    }
+}
+
+/*****************************************************************************
+ * csa_DecryptBatch: descramble a set of packets
+ *****************************************************************************
+ * Equivalent to calling csa_Decrypt() on each packet.
+ *****************************************************************************/
+void csa_DecryptBatch( csa_t *c, uint8_t **pp_pkt, int i_pkt, int i_pkt_size )
+{
+    uint8_t *pp_odd[CSA_BATCH], *pp_even[CSA_BATCH];
+    int     i_odd = 0, i_even = 0;
+
+    for( int i = 0; i < i_pkt; i++ )
+    {
+        uint8_t *pkt = pp_pkt[i];
+
+        if( (pkt[3]&0x80) == 0 )
+            continue;
+
+        const int i_hdr = ( pkt[3]&0x20 ) ? 5 + pkt[4] : 4;
+        if( 188 - i_hdr < 8 || i_pkt_size - i_hdr < 8 )
+        {
+            /* Corner cases are left to the reference code */
+            csa_Decrypt( c, pkt, i_pkt_size );
+        }
+        else if( pkt[3]&0x40 )
+        {
+            pp_odd[i_odd++] = pkt;
+            if( i_odd == CSA_BATCH )
+            {
+                csa_DecryptGroup( c->o_ck, c->o_kk, pp_odd, i_odd, i_pkt_size );
+                i_odd = 0;
+            }
+        }
+        else
+        {
+            pp_even[i_even++] = pkt;
+            if( i_even == CSA_BATCH )
+            {
+                csa_DecryptGroup( c->e_ck, c->e_kk, pp_even, i_even, i_pkt_size );
+                i_even = 0;
+            }
+        }
+    }
+
+    if( i_odd >= CSA_BATCH_MIN )
+        csa_DecryptGroup( c->o_ck, c->o_kk, pp_odd, i_odd, i_pkt_size );
+    else
+        for( int i = 0; i < i_odd; i++ )
+            csa_Decrypt( c, pp_odd[i], i_pkt_size );
+
+    if( i_even >= CSA_BATCH_MIN )
+        csa_DecryptGroup( c->e_ck, c->e_kk, pp_even, i_even, i_pkt_size );
+    else
+        for( int i = 0; i < i_even; i++ )
+            csa_Decrypt( c, pp_even[i], i_pkt_size );
+}
@@ -30,6 +30,15 @@
 
 #include <limits.h>
 #include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#ifdef HAVE_UNISTD_H
+#   include <unistd.h>
+#endif
+#ifndef WIN32
+#   include <utime.h>
+#endif
 
 #include <vlc_common.h>
 #include <vlc_plugin.h>
@@ -41,6 +50,8 @@
 #include <vlc_stream.h>
 #include <vlc_url.h>
 #include <vlc_memory.h>
+#include <vlc_fs.h>
+#include <vlc_configuration.h>
 
 /*****************************************************************************
  * Module descriptor
@@ -48,27 +59,79 @@
 static int  Open (vlc_object_t *);
 static void Close(vlc_object_t *);
 
+#define HLS_FETCHERS_MAX 4
+
+#define FETCHERS_TEXT N_("Concurrent segment downloads")
+#define FETCHERS_LONGTEXT N_( \
+    "Number of segments downloaded at the same time. More downloads help " \
+    "to fill high latency links." )
+#define BUFFER_TEXT N_("Download buffer size (kB)")
+#define BUFFER_LONGTEXT N_( \
+    "Amount of data downloaded ahead of the playback position." )
+#define DISK_CACHE_TEXT N_("Cache segments on disk")
+#define DISK_CACHE_LONGTEXT N_( \
+    "Keep downloaded segments in the user cache directory, so that seeking " \
+    "back and re-opening a stream are served from the disk." )
+#define DISK_CACHE_SIZE_TEXT N_("Disk cache size (MB)")
+#define DISK_CACHE_SIZE_LONGTEXT N_( \
+    "Size of the segment disk cache. The least recently used segments are " \
+    "removed when it is full." )
+#define LIVE_START_TEXT N_("Live start offset (segments)")
+#define LIVE_START_LONGTEXT N_( \
+    "Number of segments from the end of a live playlist at which playback " \
+    "starts. Lower values reduce latency, higher values protect against " \
+    "stalls." )
+
 vlc_module_begin()
     set_category(CAT_INPUT)
     set_subcategory(SUBCAT_INPUT_STREAM_FILTER)
     set_description(N_("Http Live Streaming stream filter"))
     set_capability("stream_filter", 20)
+    add_integer_with_range("hls-fetchers", 2, 1, HLS_FETCHERS_MAX,
+                           FETCHERS_TEXT, FETCHERS_LONGTEXT, true)
+    add_integer("hls-buffer-size", 8192, BUFFER_TEXT, BUFFER_LONGTEXT, true)
+    add_integer_with_range("hls-live-start", 3, 1, 10,
+                           LIVE_START_TEXT, LIVE_START_LONGTEXT, true)
+    add_bool("hls-disk-cache", false, DISK_CACHE_TEXT, DISK_CACHE_LONGTEXT, true)
+    add_integer("hls-disk-cache-size", 256, DISK_CACHE_SIZE_TEXT,
+                DISK_CACHE_SIZE_LONGTEXT, true)
     set_callbacks(Open, Close)
 vlc_module_end()
 
 /*****************************************************************************
  *
  *****************************************************************************/
+#define HLS_BLOCK_SIZE  (16 * 1024)     /* download granularity (bytes) */
+#define HLS_WAIT_TICK   (CLOCK_FREQ/10) /* polling period while waiting for data */
+#define HLS_RELOAD_MIN  (CLOCK_FREQ/2)  /* shortest playlist reload interval */
+
+/* Bandwidth adaptation */
+#define ADAPT_EWMA_WEIGHT   0.3     /* weight of the newest throughput sample */
+#define ADAPT_UP_MARGIN     0.8     /* share of the estimate usable to switch up */
+#define ADAPT_BUFFER_LOW    1       /* segments ahead: switch down at once */
+#define ADAPT_BUFFER_HIGH   3       /* segments ahead needed to switch up */
+#define ADAPT_HOLD          (10 * CLOCK_FREQ) /* minimum time between up switches */
+
 typedef struct segment_s
 {
     int         sequence;   /* unique sequence number */
     int         duration;   /* segment duration (seconds) */
-    uint64_t    size;       /* segment size in bytes */
+    uint64_t    size;       /* bytes downloaded so far */
     uint64_t    bandwidth;  /* bandwidth usage of segments (bits per second)*/
 
     vlc_url_t   url;
     vlc_mutex_t lock;
-    block_t     *data;      /* data */
+    vlc_cond_t  wait;       /* signalled when data is appended */
+    block_t     *data;      /* chain of downloaded blocks */
+    block_t     **pp_last;  /* end of the data chain */
+    bool        b_downloading; /* download in progress */
+    bool        b_complete; /* all data has been downloaded */
+    bool        b_failed;   /* last download attempt failed */
+
+    /* playback position */
+    block_t     *read;      /* block being played */
+    size_t      read_offset;/* bytes played from that block */
+    uint64_t    played;     /* bytes played from this segment */
 } segment_t;
 
 typedef struct hls_stream_s
@@ -90,18 +153,41 @@ struct stream_sys_t
 {
     vlc_url_t     m3u8;         /* M3U8 url */
     vlc_thread_t  reload;       /* HLS m3u8 reload thread */
-    vlc_thread_t  thread;       /* HLS segment download thread */
+    vlc_thread_t  thread[HLS_FETCHERS_MAX]; /* HLS segment download threads */
+    int           threads;
 
     /* */
     vlc_array_t  *hls_stream;   /* bandwidth adaptation */
-    uint64_t      bandwidth;    /* measured bandwidth (bits per second) */
+    uint64_t      bandwidth;    /* smoothed bandwidth (bits per second) */
+
+    /* Bandwidth adaptation */
+    struct hls_adaptation_s
+    {
+        vlc_mutex_t lock;       /* serializes the download threads */
+        vlc_object_t *p_input;  /* input receiving the statistics */
+        int         samples;    /* throughput samples in the estimate */
+        int         switches;   /* number of variant switches */
+        mtime_t     last_switch;/* time of the last variant switch */
+    } adaptation;
+
+    /* Disk cache */
+    struct hls_cache_s
+    {
+        char        *psz_dir;   /* cache directory, NULL if disabled */
+        uint64_t    budget;     /* maximum size (bytes) */
+    } cache;
+
+    /* Peek data spanning several blocks */
+    uint8_t      *peek;
+    size_t        peek_size;
 
     /* Download */
     struct hls_download_s
     {
         int         stream;     /* current hls_stream  */
-        int         segment;    /* current segment for downloading */
+        int         segment;    /* next segment to download */
         int         seek;       /* segment requested by seek (default -1) */
+        uint64_t    budget;     /* bytes downloaded ahead of playback */
         vlc_mutex_t lock_wait;  /* protect segment download counter */
         vlc_cond_t  wait;       /* some condition to wait on */
     } download;
@@ -117,16 +203,20 @@ struct stream_sys_t
     /* Playlist */
     struct hls_playlist_s
     {
-        mtime_t     last;       /* playlist last loaded */
+        mtime_t     last;       /* playlist last got new segments */
         mtime_t     wakeup;     /* next reload time */
+        mtime_t     interval;   /* measured time between new segments */
         int         tries;      /* times it was not changed */
+        bool        b_block;    /* server supports blocking reloads */
+        bool        b_no_block; /* a blocking reload failed, never retry */
     } playlist;
 
     /* state */
     bool        b_cache;    /* can cache files */
     bool        b_meta;     /* meta playlist */
     bool        b_live;     /* live stream? or vod? */
-    bool        b_error;    /* parsing error */
+    bool        b_error;    /* parsing error (protected by download.lock_wait) */
+    bool        b_close;    /* Close() was called (same) */
 };
 
 /****************************************************************************
@@ -138,9 +228,11 @@ static int  Control(stream_t *, int i_query, va_list);
 
 static ssize_t read_M3U8_from_stream(stream_t *s, uint8_t **buffer);
 static ssize_t read_M3U8_from_url(stream_t *s, vlc_url_t *url, uint8_t **buffer);
+static ssize_t read_M3U8_from_uri(stream_t *s, const char *psz_url, uint8_t **buffer);
 static char *ReadLine(uint8_t *buffer, uint8_t **pos, size_t len);
 
 static int hls_Download(stream_t *s, segment_t *segment);
+static int cache_Load(stream_t *s, segment_t *segment);
 
 static void* hls_Thread(void *);
 static void* hls_Reload(void *);
@@ -306,22 +398,68 @@ static segment_t *segment_New(hls_stream_t* hls, const int duration, const char
     segment->bandwidth = 0;
     vlc_UrlParse(&segment->url, uri, 0);
     segment->data = NULL;
+    segment->pp_last = &segment->data;
+    segment->b_downloading = false;
+    segment->b_complete = false;
+    segment->b_failed = false;
+    segment->read = NULL;
+    segment->read_offset = 0;
+    segment->played = 0;
     vlc_array_append(hls->segments, segment);
     vlc_mutex_init(&segment->lock);
+    vlc_cond_init(&segment->wait);
     return segment;
 }
 
 static void segment_Free(segment_t *segment)
 {
     vlc_mutex_destroy(&segment->lock);
+    vlc_cond_destroy(&segment->wait);
 
     vlc_UrlClean(&segment->url);
     if (segment->data)
-        block_Release(segment->data);
+        block_ChainRelease(segment->data);
     free(segment);
     segment = NULL;
 }
 
+/* Move the playback position back to the start of the segment
+ * (segment lock must be held) */
+static void segment_Rewind(segment_t *segment)
+{
+    segment->read = segment->data;
+    segment->read_offset = 0;
+    segment->played = 0;
+}
+
+/* Drop the downloaded data (segment lock must be held) */
+static void segment_Flush(segment_t *segment)
+{
+    if (segment->data)
+        block_ChainRelease(segment->data);
+    segment->data = NULL;
+    segment->pp_last = &segment->data;
+    segment->size = 0;
+    segment->b_complete = false;
+    segment->b_failed = false;
+    segment_Rewind(segment);
+}
+
+/* Block holding the playback position, NULL when all downloaded data
+ * has been played (segment lock must be held) */
+static block_t *segment_ReadBlock(segment_t *segment)
+{
+    if (segment->played >= segment->size)
+        return NULL;
+
+    while (segment->read_offset >= segment->read->i_buffer)
+    {
+        segment->read = segment->read->p_next;
+        segment->read_offset = 0;
+    }
+    return segment->read;
+}
+
 static segment_t *segment_GetSegment(hls_stream_t *hls, const int wanted)
 {
     assert(hls);
@@ -356,16 +494,23 @@ static int ChooseSegment(stream_t *s, const int current)
     hls_stream_t *hls = hls_Get(p_sys->hls_stream, current);
     if (hls == NULL) return 0;
 
-    /* Choose a segment to start which is no closer then
-     * 3 times the target duration from the end of the playlist.
-     */
     int wanted = 0;
-    int duration = 0;
-    int sequence = 0;
     int count = vlc_array_count(hls->segments);
-    int i = p_sys->b_live ? count - 1 : 0;
+    if (p_sys->b_live)
+    {
+        /* Start close to the live edge to keep the latency and the time to
+         * the first picture low */
+        int edge = var_InheritInteger(s, "hls-live-start");
+        wanted = count - __MAX(edge, 1);
+        if (wanted < 0)
+        {
+            msg_Warn(s, "only %d segments available for live playback, "
+                     "playback may stall", count);
+            wanted = 0;
+        }
+    }
 
-    while((i >= 0) && (i < count) && vlc_object_alive(s))
+    for (int i = 0; i < count; i++)
     {
         segment_t *segment = segment_GetSegment(hls, i);
         assert(segment);
@@ -375,23 +520,11 @@ static int ChooseSegment(stream_t *s, const int current)
             msg_Err(s, "EXTINF:%d duration is larger then EXT-X-TARGETDURATION:%d",
                     segment->duration, hls->duration);
         }
-
-        duration += segment->duration;
-        if (duration >= 3 * hls->duration)
-        {
-            /* Start point found */
-            wanted = p_sys->b_live ? i : 0;
-            sequence = segment->sequence;
-            break;
-        }
-
-        if (p_sys->b_live)
-            i-- ;
-        else
-          i++;
     }
 
-    msg_Info(s, "Choose segment %d/%d (sequence=%d)", wanted, count, sequence);
+    segment_t *segment = segment_GetSegment(hls, wanted);
+    msg_Info(s, "Choose segment %d/%d (sequence=%d)", wanted, count,
+             segment ? segment->sequence : 0);
     return wanted;
 }
 
@@ -744,6 +877,22 @@ static int parse_Version(stream_t *s, hls_stream_t *hls, char *p_read)
     return VLC_SUCCESS;
 }
 
+static int parse_ServerControl(stream_t *s, hls_stream_t *hls, char *p_read)
+{
+    assert(hls);
+
+    /* #EXT-X-SERVER-CONTROL:[CAN-BLOCK-RELOAD=YES][,...] */
+    char *block = parse_Attributes(p_read, "CAN-BLOCK-RELOAD");
+    if (block != NULL && strncasecmp(block, "YES", 3) == 0)
+    {
+        if (!s->p_sys->playlist.b_block && !s->p_sys->playlist.b_no_block)
+            msg_Info(s, "server supports blocking playlist reload");
+        s->p_sys->playlist.b_block = !s->p_sys->playlist.b_no_block;
+    }
+    free(block);
+    return VLC_SUCCESS;
+}
+
 static int parse_EndList(stream_t *s, hls_stream_t *hls)
 {
     assert(hls);
@@ -937,6 +1086,8 @@ static int parse_M3U8(stream_t *s, vlc_array_t *streams, uint8_t *buffer, const
                 err = parse_Discontinuity(s, hls, line);
             else if (strncmp(line, "#EXT-X-VERSION", 14) == 0)
                 err = parse_Version(s, hls, line);
+            else if (strncmp(line, "#EXT-X-SERVER-CONTROL", 21) == 0)
+                err = parse_ServerControl(s, hls, line);
             else if (strncmp(line, "#EXT-X-ENDLIST", 14) == 0)
                 err = parse_EndList(s, hls);
             else if ((strncmp(line, "#", 1) != 0) && (*line != '\0') )
@@ -959,21 +1110,69 @@ static int parse_M3U8(stream_t *s, vlc_array_t *streams, uint8_t *buffer, const
     return err;
 }
 
-static int get_HTTPLiveMetaPlaylist(stream_t *s, vlc_array_t **streams)
+static int get_HTTPLiveMetaPlaylist(stream_t *s, vlc_array_t **streams, int msn)
 {
     stream_sys_t *p_sys = s->p_sys;
     assert(*streams);
 
     /* Download new playlist file from server */
     uint8_t *buffer = NULL;
-    ssize_t len = read_M3U8_from_url(s, &p_sys->m3u8, &buffer);
+    ssize_t len = -1;
+    const bool b_block = p_sys->playlist.b_block && !p_sys->b_meta;
+    if (b_block)
+    {
+        /* Blocking reload: the server answers once segment msn is listed */
+        char *psz_url = ConstructUrl(&p_sys->m3u8);
+        char *psz_block = NULL;
+        if (psz_url == NULL ||
+            asprintf(&psz_block, "%s%c_HLS_msn=%d", psz_url,
+                     strchr(p_sys->m3u8.psz_path, '?') ? '&' : '?', msn) < 0)
+        {
+            free(psz_url);
+            return VLC_ENOMEM;
+        }
+        free(psz_url);
+        len = read_M3U8_from_uri(s, psz_block, &buffer);
+        free(psz_block);
+        if (len < 0)
+        {
+            msg_Warn(s, "blocking playlist reload failed, using plain reloads");
+            p_sys->playlist.b_no_block = true;
+        }
+    }
+    if (len < 0)
+        len = read_M3U8_from_url(s, &p_sys->m3u8, &buffer);
     if (len < 0)
         return VLC_EGENERIC;
 
+    /* the server may stop advertising blocking reloads */
+    p_sys->playlist.b_block = false;
+
     /* Parse HLS m3u8 content. */
     int err = parse_M3U8(s, *streams, buffer, len);
     free(buffer);
 
+    /* A server ignoring the request answers before segment msn is listed */
+    if ((err == VLC_SUCCESS) && b_block && !p_sys->playlist.b_no_block)
+    {
+        int last = -1;
+        for (int n = 0; n < vlc_array_count(*streams); n++)
+        {
+            hls_stream_t *hls = hls_Get(*streams, n);
+            segment_t *segment = segment_GetSegment(hls,
+                                        vlc_array_count(hls->segments) - 1);
+            if ((segment != NULL) && (segment->sequence > last))
+                last = segment->sequence;
+        }
+        if (last < msn)
+        {
+            msg_Warn(s, "server ignored the blocking playlist reload, "
+                     "using plain reloads");
+            p_sys->playlist.b_no_block = true;
+            p_sys->playlist.b_block = false;
+        }
+    }
+
     return err;
 }
 
@@ -1035,7 +1234,7 @@ fail_and_unlock:
     return VLC_EGENERIC;
 }
 
-static int hls_ReloadPlaylist(stream_t *s)
+static int hls_ReloadPlaylist(stream_t *s, int msn)
 {
     stream_sys_t *p_sys = s->p_sys;
 
@@ -1045,7 +1244,7 @@ static int hls_ReloadPlaylist(stream_t *s)
 
     msg_Info(s, "Reloading HLS live meta playlist");
 
-    if (get_HTTPLiveMetaPlaylist(s, &hls_streams) != VLC_SUCCESS)
+    if (get_HTTPLiveMetaPlaylist(s, &hls_streams, msn) != VLC_SUCCESS)
     {
         /* Free hls streams */
         for (int i = 0; i < vlc_array_count(hls_streams); i++)
@@ -1090,9 +1289,9 @@ static int hls_ReloadPlaylist(stream_t *s)
 static int BandwidthAdaptation(stream_t *s, int progid, uint64_t *bandwidth)
 {
     stream_sys_t *p_sys = s->p_sys;
-    int candidate = -1;
+    int candidate = -1, lowest = -1;
     uint64_t bw = *bandwidth;
-    uint64_t bw_candidate = 0;
+    uint64_t bw_candidate = 0, bw_lowest = UINT64_MAX;
 
     int count = vlc_array_count(p_sys->hls_stream);
     for (int n = 0; n < count; n++)
@@ -1111,12 +1310,134 @@ static int BandwidthAdaptation(stream_t *s, int progid, uint64_t *bandwidth)
                 bw_candidate = hls->bandwidth;
                 candidate = n; /* possible candidate */
             }
+            if (hls->bandwidth < bw_lowest)
+            {
+                bw_lowest = hls->bandwidth;
+                lowest = n;
+            }
         }
     }
+
+    /* nothing fits, fall back to the lowest bandwidth stream */
+    if (candidate < 0 && lowest >= 0)
+    {
+        bw_candidate = bw_lowest;
+        candidate = lowest;
+    }
     *bandwidth = bw_candidate;
     return candidate;
 }
 
+static const char *const adaptation_vars[] = {
+    "adaptive-bandwidth", "adaptive-variant",
+    "adaptive-buffer", "adaptive-switches",
+};
+
+static void AdaptationInit(stream_t *s)
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    vlc_mutex_init(&p_sys->adaptation.lock);
+
+    for (vlc_object_t *p = VLC_OBJECT(s); p != NULL; p = p->p_parent)
+    {
+        if (strcmp(p->psz_object_type, "input"))
+            continue;
+        for (unsigned i = 0; i < ARRAY_SIZE(adaptation_vars); i++)
+            var_Create(p, adaptation_vars[i], VLC_VAR_INTEGER);
+        p_sys->adaptation.p_input = p;
+        break;
+    }
+}
+
+static void AdaptationClean(stream_t *s)
+{
+    vlc_object_t *p_input = s->p_sys->adaptation.p_input;
+
+    vlc_mutex_destroy(&s->p_sys->adaptation.lock);
+    if (p_input == NULL)
+        return;
+    for (unsigned i = 0; i < ARRAY_SIZE(adaptation_vars); i++)
+        var_Destroy(p_input, adaptation_vars[i]);
+}
+
+/* Publish the adaptation state to the input statistics
+ * (see stats_ComputeInputStats()) */
+static void AdaptationStats(stream_t *s, uint64_t variant, int buffered)
+{
+    stream_sys_t *p_sys = s->p_sys;
+    vlc_object_t *p_input = p_sys->adaptation.p_input;
+
+    if (p_input == NULL)
+        return;
+
+    var_SetInteger(p_input, "adaptive-bandwidth", p_sys->bandwidth);
+    var_SetInteger(p_input, "adaptive-variant", variant);
+    var_SetInteger(p_input, "adaptive-buffer", buffered);
+    var_SetInteger(p_input, "adaptive-switches", p_sys->adaptation.switches);
+}
+
+/* Feed a throughput sample to the bandwidth estimate. An exponentially
+ * weighted moving average smooths out single slow or fast segments. */
+static void AdaptationSample(stream_t *s, uint64_t bw)
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    if (p_sys->adaptation.samples++ == 0)
+        p_sys->bandwidth = bw;
+    else
+        p_sys->bandwidth = ADAPT_EWMA_WEIGHT * bw +
+                           (1.0 - ADAPT_EWMA_WEIGHT) * p_sys->bandwidth;
+}
+
+/* Select the stream to download next, from the bandwidth estimate and the
+ * number of segments downloaded ahead of playback. Switching up needs
+ * headroom in both, switching down happens when the current stream is no
+ * longer sustainable or the buffer runs low. The gap between both
+ * thresholds keeps the selection from flapping. */
+static int AdaptationSelect(stream_t *s, hls_stream_t *hls, int cur_stream)
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    vlc_mutex_lock(&p_sys->download.lock_wait);
+    int buffered = p_sys->download.segment - p_sys->playback.segment;
+    vlc_mutex_unlock(&p_sys->download.lock_wait);
+    if (buffered < 0)
+        buffered = 0;
+
+    uint64_t bw = p_sys->bandwidth * ADAPT_UP_MARGIN;
+    if (buffered <= ADAPT_BUFFER_LOW)
+        bw = p_sys->bandwidth / 2;
+
+    int newstream = BandwidthAdaptation(s, hls->id, &bw);
+    if ((newstream < 0) || (newstream == cur_stream))
+        goto out;
+
+    mtime_t now = mdate();
+    if (bw > hls->bandwidth)
+    {
+        if ((buffered < ADAPT_BUFFER_HIGH) ||
+            (now - p_sys->adaptation.last_switch < ADAPT_HOLD))
+            goto out;
+    }
+    else if ((buffered > ADAPT_BUFFER_LOW) &&
+             (hls->bandwidth <= p_sys->bandwidth))
+        goto out;
+
+    msg_Info(s, "switching to %s bandwidth stream %d (%"PRIu64" bits/s, "
+             "estimated %"PRIu64" bits/s, %d segments ahead)",
+             (bw > hls->bandwidth) ? "higher" : "lower", newstream, bw,
+             p_sys->bandwidth, buffered);
+    p_sys->adaptation.switches++;
+    p_sys->adaptation.last_switch = now;
+    AdaptationStats(s, bw, buffered);
+    return newstream;
+
+out:
+    AdaptationStats(s, hls->bandwidth, buffered);
+    return cur_stream;
+}
+
 static int Download(stream_t *s, hls_stream_t *hls, segment_t *segment, int *cur_stream)
 {
     stream_sys_t *p_sys = s->p_sys;
@@ -1125,12 +1446,29 @@ static int Download(stream_t *s, hls_stream_t *hls, segment_t *segment, int *cur
     assert(segment);
 
     vlc_mutex_lock(&segment->lock);
-    if (segment->data != NULL)
+    if ((segment->data != NULL) || segment->b_downloading)
     {
         /* Segment already downloaded */
         vlc_mutex_unlock(&segment->lock);
         return VLC_SUCCESS;
     }
+    segment_Flush(segment);
+    segment->b_downloading = true;
+    vlc_mutex_unlock(&segment->lock);
+
+    if ((p_sys->cache.psz_dir != NULL) &&
+        (cache_Load(s, segment) == VLC_SUCCESS))
+    {
+        vlc_mutex_lock(&segment->lock);
+        segment->b_downloading = false;
+        vlc_mutex_unlock(&segment->lock);
+
+        /* segment is available for playback */
+        vlc_mutex_lock(&p_sys->download.lock_wait);
+        vlc_cond_broadcast(&p_sys->download.wait);
+        vlc_mutex_unlock(&p_sys->download.lock_wait);
+        return VLC_SUCCESS;
+    }
 
     /* sanity check - can we download this segment on time? */
     if ((p_sys->bandwidth > 0) && (hls->bandwidth > 0))
@@ -1145,15 +1483,19 @@ static int Download(stream_t *s, hls_stream_t *hls, segment_t *segment, int *cur
     }
 
     mtime_t start = mdate();
-    if (hls_Download(s, segment) != VLC_SUCCESS)
-    {
-        vlc_mutex_unlock(&segment->lock);
-        return VLC_EGENERIC;
-    }
+    int i_ret = hls_Download(s, segment);
     mtime_t duration = mdate() - start;
 
+    /* playback may already have released the data, keep the size */
+    vlc_mutex_lock(&segment->lock);
+    segment->b_downloading = false;
+    segment->b_failed = (i_ret != VLC_SUCCESS);
+    uint64_t size = segment->size;
     vlc_mutex_unlock(&segment->lock);
 
+    if (i_ret != VLC_SUCCESS)
+        return VLC_EGENERIC;
+
     msg_Info(s, "downloaded segment %d from stream %d",
                 segment->sequence, *cur_stream);
 
@@ -1162,23 +1504,63 @@ static int Download(stream_t *s, hls_stream_t *hls, segment_t *segment, int *cur
     if (ms <= 0.0)
         return VLC_SUCCESS;
 
-    uint64_t bw = ((double)(segment->size * 8) / ms) * 1000; /* bits / s */
-    p_sys->bandwidth = bw;
-    if (p_sys->b_meta && (hls->bandwidth != bw))
+    uint64_t bw = ((double)(size * 8) / ms) * 1000; /* bits / s */
+    vlc_mutex_lock(&p_sys->adaptation.lock);
+    AdaptationSample(s, bw);
+    if (p_sys->b_meta)
+        *cur_stream = AdaptationSelect(s, hls, *cur_stream);
+    else
+        AdaptationStats(s, hls->bandwidth, 0);
+    vlc_mutex_unlock(&p_sys->adaptation.lock);
+    return VLC_SUCCESS;
+}
+
+static bool HasError(stream_t *s)
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    vlc_mutex_lock(&p_sys->download.lock_wait);
+    bool b_error = p_sys->b_error;
+    vlc_mutex_unlock(&p_sys->download.lock_wait);
+    return b_error;
+}
+
+/* Bytes downloaded ahead of the playback position, in all streams */
+static uint64_t BufferedBytes(stream_t *s)
+{
+    stream_sys_t *p_sys = s->p_sys;
+    uint64_t buffered = 0;
+
+    vlc_mutex_lock(&p_sys->download.lock_wait);
+    int first = p_sys->playback.segment;
+    int last = p_sys->download.segment;
+    vlc_mutex_unlock(&p_sys->download.lock_wait);
+    for (int n = 0; n < vlc_array_count(p_sys->hls_stream); n++)
     {
-        int newstream = BandwidthAdaptation(s, hls->id, &bw);
+        hls_stream_t *hls = hls_Get(p_sys->hls_stream, n);
+        if (hls == NULL)
+            break;
 
-        /* FIXME: we need an average here */
-        if ((newstream >= 0) && (newstream != *cur_stream))
+        vlc_mutex_lock(&hls->lock);
+        for (int i = first; i < last; i++)
         {
-            msg_Info(s, "detected %s bandwidth (%"PRIu64") stream",
-                     (bw >= hls->bandwidth) ? "faster" : "lower", bw);
-            *cur_stream = newstream;
+            segment_t *segment = segment_GetSegment(hls, i);
+            if (segment == NULL)
+                continue;
+
+            vlc_mutex_lock(&segment->lock);
+            buffered += segment->size - segment->played;
+            vlc_mutex_unlock(&segment->lock);
         }
+        vlc_mutex_unlock(&hls->lock);
     }
-    return VLC_SUCCESS;
+    return buffered;
 }
 
+/* Several instances of this thread download consecutive segments in
+ * parallel, as long as the data downloaded ahead of playback stays within
+ * the budget. Connections to the server are kept alive and reused by the
+ * http access. */
 static void* hls_Thread(void *p_this)
 {
     stream_t *s = (stream_t *)p_this;
@@ -1188,68 +1570,56 @@ static void* hls_Thread(void *p_this)
 
     while (vlc_object_alive(s))
     {
-        hls_stream_t *hls = hls_Get(p_sys->hls_stream, p_sys->download.stream);
-        assert(hls);
+        uint64_t buffered = BufferedBytes(s);
 
-        /* Sliding window (~60 seconds worth of movie) */
-        vlc_mutex_lock(&hls->lock);
-        int count = vlc_array_count(hls->segments);
-        vlc_mutex_unlock(&hls->lock);
-
-        /* Is there a new segment to process? */
-        if ((!p_sys->b_live && (p_sys->playback.segment < (count - 6))) ||
-            (p_sys->download.segment >= count))
+        /* Claim the next segment to download */
+        vlc_mutex_lock(&p_sys->download.lock_wait);
+        if (p_sys->download.seek >= 0)
         {
-            /* wait */
-            vlc_mutex_lock(&p_sys->download.lock_wait);
-            while (((p_sys->download.segment - p_sys->playback.segment > 6) ||
-                    (p_sys->download.segment >= count)) &&
-                   (p_sys->download.seek == -1))
-            {
-                vlc_cond_wait(&p_sys->download.wait, &p_sys->download.lock_wait);
-                if (p_sys->b_live /*&& (mdate() >= p_sys->playlist.wakeup)*/)
-                    break;
-                if (!vlc_object_alive(s))
-                    break;
-            }
-            /* */
-            if (p_sys->download.seek >= 0)
-            {
-                p_sys->download.segment = p_sys->download.seek;
-                p_sys->download.seek = -1;
-            }
-            vlc_mutex_unlock(&p_sys->download.lock_wait);
+            p_sys->download.segment = p_sys->download.seek;
+            p_sys->download.seek = -1;
         }
 
-        if (!vlc_object_alive(s)) break;
+        const int claimed = p_sys->download.stream;
+        int stream = claimed;
+        hls_stream_t *hls = hls_Get(p_sys->hls_stream, stream);
+        assert(hls);
 
         vlc_mutex_lock(&hls->lock);
         segment_t *segment = segment_GetSegment(hls, p_sys->download.segment);
         vlc_mutex_unlock(&hls->lock);
 
-        if ((segment != NULL) &&
-            (Download(s, hls, segment, &p_sys->download.stream) != VLC_SUCCESS))
+        if ((segment == NULL) || (buffered >= p_sys->download.budget))
+        {
+            /* wait for playback or for a playlist reload */
+            vlc_cond_timedwait(&p_sys->download.wait, &p_sys->download.lock_wait,
+                               mdate() + HLS_WAIT_TICK);
+            vlc_mutex_unlock(&p_sys->download.lock_wait);
+            continue;
+        }
+        p_sys->download.segment++;
+        vlc_mutex_unlock(&p_sys->download.lock_wait);
+
+        if (Download(s, hls, segment, &stream) != VLC_SUCCESS)
         {
             if (!vlc_object_alive(s)) break;
 
             if (!p_sys->b_live)
             {
+                vlc_mutex_lock(&p_sys->download.lock_wait);
                 p_sys->b_error = true;
+                vlc_cond_broadcast(&p_sys->download.wait);
+                vlc_mutex_unlock(&p_sys->download.lock_wait);
                 break;
             }
         }
 
-        /* download succeeded */
-        /* determine next segment to download */
+        /* Follow bandwidth adaptation for the next segments, unless another
+         * fetcher switched the stream since this segment was claimed */
         vlc_mutex_lock(&p_sys->download.lock_wait);
-        if (p_sys->download.seek >= 0)
-        {
-            p_sys->download.segment = p_sys->download.seek;
-            p_sys->download.seek = -1;
-        }
-        else if (p_sys->download.segment < count)
-            p_sys->download.segment++;
-        vlc_cond_signal(&p_sys->download.wait);
+        if ((stream != claimed) && (p_sys->download.stream == claimed))
+            p_sys->download.stream = stream;
+        vlc_cond_broadcast(&p_sys->download.wait);
         vlc_mutex_unlock(&p_sys->download.lock_wait);
     }
 
@@ -1257,6 +1627,53 @@ static void* hls_Thread(void *p_this)
     return NULL;
 }
 
+static int hls_LastSequence(hls_stream_t *hls)
+{
+    vlc_mutex_lock(&hls->lock);
+    segment_t *segment = segment_GetSegment(hls, vlc_array_count(hls->segments) - 1);
+    int sequence = (segment != NULL) ? segment->sequence : -1;
+    vlc_mutex_unlock(&hls->lock);
+    return sequence;
+}
+
+/* Determine the next playlist reload from the measured arrival time of new
+ * segments, rather than from the advertised target duration */
+static void ScheduleReload(stream_t *s, hls_stream_t *hls, mtime_t now, int added)
+{
+    stream_sys_t *p_sys = s->p_sys;
+    mtime_t target = (mtime_t)hls->duration * CLOCK_FREQ;
+
+    if (added > 0)
+    {
+        mtime_t sample = (now - p_sys->playlist.last) / added;
+        p_sys->playlist.interval = (3 * p_sys->playlist.interval + sample) / 4;
+        if ((target > 0) && (p_sys->playlist.interval > target))
+            p_sys->playlist.interval = target;
+        if (p_sys->playlist.interval < HLS_RELOAD_MIN)
+            p_sys->playlist.interval = HLS_RELOAD_MIN;
+        p_sys->playlist.last = now;
+        p_sys->playlist.tries = 0;
+    }
+    else
+        p_sys->playlist.tries++;
+
+    /* blocking reloads are only requested for media playlists */
+    bool b_block = p_sys->playlist.b_block && !p_sys->b_meta;
+    if (b_block && (added > 0 || p_sys->playlist.tries < 3))
+    {
+        /* the server holds the next request until a segment is added */
+        p_sys->playlist.wakeup = now;
+    }
+    else if (added > 0)
+        p_sys->playlist.wakeup = now + p_sys->playlist.interval;
+    else
+    {
+        /* Not changed yet, retry after half the interval and back off */
+        p_sys->playlist.wakeup = now + p_sys->playlist.interval / 2 *
+                                       __MIN(p_sys->playlist.tries, 4);
+    }
+}
+
 static void* hls_Reload(void *p_this)
 {
     stream_t *s = (stream_t *)p_this;
@@ -1268,99 +1685,258 @@ static void* hls_Reload(void *p_this)
 
     while (vlc_object_alive(s))
     {
-        double wait = 1;
-        mtime_t now = mdate();
-        if (now >= p_sys->playlist.wakeup)
+        if (mdate() >= p_sys->playlist.wakeup)
         {
-            /* reload the m3u8 */
-            if (hls_ReloadPlaylist(s) != VLC_SUCCESS)
-            {
-                /* No change in playlist, then backoff */
-                p_sys->playlist.tries++;
-                if (p_sys->playlist.tries == 1) wait = 0.5;
-                else if (p_sys->playlist.tries == 2) wait = 1;
-                else if (p_sys->playlist.tries >= 3) wait = 3;
-            }
-            else p_sys->playlist.tries = 0;
-
             hls_stream_t *hls = hls_Get(p_sys->hls_stream, p_sys->download.stream);
             assert(hls);
 
+            /* reload the m3u8 */
+            int sequence = hls_LastSequence(hls);
+            int added = 0;
+            if (hls_ReloadPlaylist(s, sequence + 1) == VLC_SUCCESS)
+                added = hls_LastSequence(hls) - sequence;
+
             /* determine next time to update playlist */
-            p_sys->playlist.last = now;
-            p_sys->playlist.wakeup = now + ((mtime_t)(hls->duration * wait)
-                                                   * (mtime_t)1000000);
+            ScheduleReload(s, hls, mdate(), added);
+
+            /* new segments to download */
+            if (added > 0)
+            {
+                vlc_mutex_lock(&p_sys->download.lock_wait);
+                vlc_cond_broadcast(&p_sys->download.wait);
+                vlc_mutex_unlock(&p_sys->download.lock_wait);
+            }
         }
 
-        mwait(p_sys->playlist.wakeup);
+        /* Sleep until the next reload, Close() wakes us up */
+        vlc_mutex_lock(&p_sys->download.lock_wait);
+        while (!p_sys->b_close && (mdate() < p_sys->playlist.wakeup))
+            vlc_cond_timedwait(&p_sys->download.wait,
+                               &p_sys->download.lock_wait,
+                               p_sys->playlist.wakeup);
+        bool b_close = p_sys->b_close;
+        vlc_mutex_unlock(&p_sys->download.lock_wait);
+        if (b_close)
+            break;
     }
 
     vlc_restorecancel(canc);
     return NULL;
 }
 
-static int Prefetch(stream_t *s, int *current)
+/****************************************************************************
+ * Disk cache
+ ****************************************************************************/
+/* serializes cache directory updates across streams */
+static vlc_mutex_t cache_lock = VLC_STATIC_MUTEX;
+
+typedef struct
+{
+    char    *psz_name;
+    off_t   size;
+    time_t  mtime;
+} cache_entry_t;
+
+static int cache_entry_cmp(const void *a, const void *b)
+{
+    const cache_entry_t *ea = a, *eb = b;
+    return (ea->mtime > eb->mtime) - (ea->mtime < eb->mtime);
+}
+
+/* Cache file of a segment, named from its URI and media sequence */
+static char *cache_Path(stream_t *s, segment_t *segment, const char *psz_ext)
 {
     stream_sys_t *p_sys = s->p_sys;
-    int stream;
 
-    /* Try to pick best matching stream */;
-again:
-    stream = *current;
+    char *psz_url = ConstructUrl(&segment->url);
+    if (psz_url == NULL)
+        return NULL;
 
-    hls_stream_t *hls = hls_Get(p_sys->hls_stream, *current);
-    if (hls == NULL)
-        return VLC_EGENERIC;
+    /* FNV-1a */
+    uint64_t hash = UINT64_C(14695981039346656037);
+    for (const char *p = psz_url; *p != '\0'; p++)
+        hash = (hash ^ (uint8_t)*p) * UINT64_C(1099511628211);
+    free(psz_url);
 
-    segment_t *segment = segment_GetSegment(hls, p_sys->download.segment);
-    if (segment == NULL )
-        return VLC_EGENERIC;
+    char *psz_path;
+    if (asprintf(&psz_path, "%s"DIR_SEP"%016"PRIx64"-%d.%s", p_sys->cache.psz_dir,
+                 hash, segment->sequence, psz_ext) < 0)
+        return NULL;
+    return psz_path;
+}
 
-    if (Download(s, hls, segment, current) != VLC_SUCCESS)
-        return VLC_EGENERIC;
+/* Remove the least recently used files until the cache fits its budget
+ * (cache_lock must be held) */
+static void cache_Trim(stream_t *s)
+{
+    stream_sys_t *p_sys = s->p_sys;
 
-    /* Found better bandwidth match, try again */
-    if (*current != stream)
-        goto again;
+    DIR *dir = vlc_opendir(p_sys->cache.psz_dir);
+    if (dir == NULL)
+        return;
 
-    /* Download first 2 segments of this HLS stream */
-    stream = *current;
-    for (int i = 0; i < 2; i++)
+    cache_entry_t *entries = NULL;
+    size_t count = 0, allocated = 0;
+    uint64_t total = 0;
+    char *psz_name;
+    while ((psz_name = vlc_readdir(dir)) != NULL)
     {
-        segment_t *segment = segment_GetSegment(hls, p_sys->download.segment);
-        if (segment == NULL )
-            return VLC_EGENERIC;
-
-        if (segment->data)
+        char *psz_path;
+        struct stat st;
+        if (psz_name[0] == '.' ||
+            asprintf(&psz_path, "%s"DIR_SEP"%s", p_sys->cache.psz_dir, psz_name) < 0)
         {
-            p_sys->download.segment++;
+            free(psz_name);
             continue;
         }
+        if (vlc_stat(psz_path, &st) || !S_ISREG(st.st_mode))
+        {
+            free(psz_path);
+            free(psz_name);
+            continue;
+        }
+        free(psz_name);
 
-        if (Download(s, hls, segment, current) != VLC_SUCCESS)
-            return VLC_EGENERIC;
-
-        p_sys->download.segment++;
-
-        /* adapt bandwidth? */
-        if (*current != stream)
+        if (count == allocated)
         {
-            hls_stream_t *hls = hls_Get(p_sys->hls_stream, *current);
-            if (hls == NULL)
-                return VLC_EGENERIC;
+            allocated = allocated ? 2 * allocated : 64;
+            entries = realloc_or_free(entries, allocated * sizeof(*entries));
+            if (entries == NULL)
+            {
+                free(psz_path);
+                closedir(dir);
+                return;
+            }
+        }
+        entries[count].psz_name = psz_path;
+        entries[count].size = st.st_size;
+        entries[count].mtime = st.st_mtime;
+        total += st.st_size;
+        count++;
+    }
+    closedir(dir);
 
-             stream = *current;
+    if (total > p_sys->cache.budget)
+    {
+        qsort(entries, count, sizeof(*entries), cache_entry_cmp);
+        for (size_t i = 0; (i < count) && (total > p_sys->cache.budget); i++)
+        {
+            if (vlc_unlink(entries[i].psz_name) == 0)
+                total -= entries[i].size;
         }
     }
 
+    for (size_t i = 0; i < count; i++)
+        free(entries[i].psz_name);
+    free(entries);
+}
+
+/* Load a segment from the disk cache, as a memory mapping */
+static int cache_Load(stream_t *s, segment_t *segment)
+{
+    char *psz_path = cache_Path(s, segment, "ts");
+    if (psz_path == NULL)
+        return VLC_ENOMEM;
+
+    int fd = vlc_open(psz_path, O_RDONLY);
+    if (fd == -1)
+    {
+        free(psz_path);
+        return VLC_EGENERIC;
+    }
+
+    block_t *block = block_File(fd);
+    close(fd);
+    if ((block == NULL) || (block->i_buffer == 0))
+    {
+        if (block)
+            block_Release(block);
+        free(psz_path);
+        return VLC_EGENERIC;
+    }
+
+#ifndef WIN32
+    /* most recently used */
+    utime(psz_path, NULL);
+#endif
+    free(psz_path);
+
+    vlc_mutex_lock(&segment->lock);
+    segment->data = block;
+    segment->pp_last = &block->p_next;
+    segment->read = block;
+    segment->size = block->i_buffer;
+    segment->b_complete = true;
+    vlc_cond_signal(&segment->wait);
+    vlc_mutex_unlock(&segment->lock);
+
+    msg_Dbg(s, "segment %d loaded from the disk cache", segment->sequence);
     return VLC_SUCCESS;
 }
 
+/* Store a downloaded segment in the disk cache, and replace its data in
+ * memory with a mapping of the cache file. The data is still incomplete
+ * to the reader, so it cannot be released meanwhile. */
+static void cache_Store(stream_t *s, segment_t *segment)
+{
+    char *psz_part = cache_Path(s, segment, "part");
+    char *psz_path = cache_Path(s, segment, "ts");
+    if ((psz_part == NULL) || (psz_path == NULL))
+        goto out;
+
+    int fd = vlc_open(psz_part, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd == -1)
+        goto out;
+
+    for (block_t *block = segment->data; block != NULL; block = block->p_next)
+    {
+        if (write(fd, block->p_buffer, block->i_buffer) != (ssize_t)block->i_buffer)
+        {
+            msg_Warn(s, "cannot write to the disk cache: %m");
+            close(fd);
+            vlc_unlink(psz_part);
+            goto out;
+        }
+    }
+
+    block_t *file = block_File(fd);
+    close(fd);
+
+    vlc_mutex_lock(&cache_lock);
+    if (vlc_rename(psz_part, psz_path) == 0)
+        cache_Trim(s);
+    else
+        vlc_unlink(psz_part);
+    vlc_mutex_unlock(&cache_lock);
+
+    if (file == NULL)
+        goto out;
+    if (file->i_buffer != segment->size)
+    {
+        block_Release(file);
+        goto out;
+    }
+
+    /* keep the read position */
+    vlc_mutex_lock(&segment->lock);
+    block_ChainRelease(segment->data);
+    segment->data = file;
+    segment->pp_last = &file->p_next;
+    segment->read = file;
+    segment->read_offset = segment->played;
+    vlc_mutex_unlock(&segment->lock);
+
+out:
+    free(psz_part);
+    free(psz_path);
+}
+
 /****************************************************************************
  *
  ****************************************************************************/
 static int hls_Download(stream_t *s, segment_t *segment)
 {
+    stream_sys_t *p_sys = s->p_sys;
     assert(segment);
 
     /* Construct URL */
@@ -1373,42 +1949,57 @@ static int hls_Download(stream_t *s, segment_t *segment)
     if (p_ts == NULL)
         return VLC_EGENERIC;
 
-    segment->size = stream_Size(p_ts);
-    assert(segment->size > 0);
-
-    segment->data = block_Alloc(segment->size);
-    if (segment->data == NULL)
+    /* Data is handed to the reader block by block, so playback can start
+     * before the whole segment has been downloaded. */
+    bool b_first = true;
+    while (vlc_object_alive(s))
     {
-        stream_Delete(p_ts);
-        return VLC_ENOMEM;
-    }
+        block_t *block = stream_Block(p_ts, HLS_BLOCK_SIZE);
+        if (block == NULL)
+            break;
 
-    assert(segment->data->i_buffer == segment->size);
+        vlc_mutex_lock(&segment->lock);
+        *segment->pp_last = block;
+        segment->pp_last = &block->p_next;
+        if (segment->read == NULL)
+            segment->read = block;
+        segment->size += block->i_buffer;
+        vlc_cond_signal(&segment->wait);
+        vlc_mutex_unlock(&segment->lock);
 
-    ssize_t length = 0, curlen = 0;
-    uint64_t size;
-    do
-    {
-        size = stream_Size(p_ts);
-        if (size > segment->size)
+        if (b_first)
         {
-            msg_Dbg(s, "size changed %"PRIu64, segment->size);
-            segment->data = block_Realloc(segment->data, 0, size);
-            if (segment->data == NULL)
-            {
-                stream_Delete(p_ts);
-                return VLC_ENOMEM;
-            }
-            segment->size = size;
-            assert(segment->data->i_buffer == segment->size);
+            /* segment is available for playback */
+            vlc_mutex_lock(&p_sys->download.lock_wait);
+            vlc_cond_broadcast(&p_sys->download.wait);
+            vlc_mutex_unlock(&p_sys->download.lock_wait);
+            b_first = false;
         }
-        length = stream_Read(p_ts, segment->data->p_buffer + curlen, segment->size - curlen);
-        if (length <= 0)
-            break;
-        curlen += length;
-    } while (vlc_object_alive(s));
+    }
 
+    /* only complete segments go to the disk cache */
+    uint64_t size = stream_Size(p_ts);
     stream_Delete(p_ts);
+
+    if ((p_sys->cache.psz_dir != NULL) && vlc_object_alive(s) &&
+        (segment->size > 0) && ((size == 0) || (size == segment->size)))
+        cache_Store(s, segment);
+
+    vlc_mutex_lock(&segment->lock);
+    segment->b_complete = true;
+    vlc_cond_signal(&segment->wait);
+    /* an empty or truncated body is a failed download, so that playback
+     * skips or retries it instead of waiting for its data */
+    bool b_short = (segment->size == 0) ||
+                   ((size > 0) && (segment->size < size));
+    vlc_mutex_unlock(&segment->lock);
+
+    if (b_short)
+    {
+        msg_Err(s, "segment %d is incomplete (%"PRIu64"/%"PRIu64" bytes)",
+                segment->sequence, segment->size, size);
+        return VLC_EGENERIC;
+    }
     return VLC_SUCCESS;
 }
 
@@ -1457,15 +2048,21 @@ static ssize_t read_M3U8_from_stream(stream_t *s, uint8_t **buffer)
 
 static ssize_t read_M3U8_from_url(stream_t *s, vlc_url_t *url, uint8_t **buffer)
 {
-    assert(*buffer == NULL);
-
     /* Construct URL */
     char *psz_url = ConstructUrl(url);
     if (psz_url == NULL)
            return VLC_ENOMEM;
 
-    stream_t *p_m3u8 = stream_UrlNew(s, psz_url);
+    ssize_t size = read_M3U8_from_uri(s, psz_url, buffer);
     free(psz_url);
+    return size;
+}
+
+static ssize_t read_M3U8_from_uri(stream_t *s, const char *psz_url, uint8_t **buffer)
+{
+    assert(*buffer == NULL);
+
+    stream_t *p_m3u8 = stream_UrlNew(s, psz_url);
     if (p_m3u8 == NULL)
         return VLC_EGENERIC;
 
@@ -1533,10 +2130,11 @@ static int Open(vlc_object_t *p_this)
     vlc_UrlParse(&p_sys->m3u8, psz_uri, 0);
     free(psz_uri);
 
-    p_sys->bandwidth = -1;
+    p_sys->bandwidth = 0;
     p_sys->b_live = true;
     p_sys->b_meta = false;
     p_sys->b_error = false;
+    p_sys->b_close = false;
 
     p_sys->hls_stream = vlc_array_new();
     if (p_sys->hls_stream == NULL)
@@ -1567,23 +2165,34 @@ static int Open(vlc_object_t *p_this)
     int current = p_sys->playback.stream = 0;
     p_sys->playback.segment = p_sys->download.segment = ChooseSegment(s, current);
 
-    if (p_sys->b_live && (p_sys->playback.segment < 0))
-    {
-        msg_Warn(s, "less data then 3 times 'target duration' available for live playback, playback may stall");
-    }
-
-    if (Prefetch(s, &current) != VLC_SUCCESS)
-    {
-        msg_Err(s, "fetching first segment failed.");
-        goto fail;
-    }
-
-
+    /* Playback starts with the first downloaded block, the download thread
+     * fetches the first segment in the background. */
     p_sys->download.stream = current;
     p_sys->playback.stream = current;
     p_sys->download.seek = -1;
+    p_sys->download.budget = (uint64_t)var_InheritInteger(s, "hls-buffer-size") * 1024;
+
+    if (var_InheritBool(s, "hls-disk-cache"))
+    {
+        char *psz_dir = config_GetUserDir(VLC_CACHE_DIR);
+        if (psz_dir != NULL)
+        {
+            vlc_mkdir(psz_dir, 0700);
+            if (asprintf(&p_sys->cache.psz_dir, "%s"DIR_SEP"hls", psz_dir) < 0)
+                p_sys->cache.psz_dir = NULL;
+            else if (vlc_mkdir(p_sys->cache.psz_dir, 0700) && errno != EEXIST)
+            {
+                msg_Warn(s, "cannot create disk cache %s: %m", p_sys->cache.psz_dir);
+                free(p_sys->cache.psz_dir);
+                p_sys->cache.psz_dir = NULL;
+            }
+            free(psz_dir);
+        }
+        p_sys->cache.budget = (uint64_t)var_InheritInteger(s, "hls-disk-cache-size") << 20;
+    }
 
     vlc_mutex_init(&p_sys->download.lock_wait);
+    AdaptationInit(s);
     vlc_cond_init(&p_sys->download.wait);
 
     /* Initialize HLS live stream */
@@ -1591,8 +2200,12 @@ static int Open(vlc_object_t *p_this)
     {
         hls_stream_t *hls = hls_Get(p_sys->hls_stream, current);
         p_sys->playlist.last = mdate();
-        p_sys->playlist.wakeup = p_sys->playlist.last +
-                ((mtime_t)hls->duration * UINT64_C(1000000));
+        p_sys->playlist.interval = (mtime_t)hls->duration * CLOCK_FREQ;
+        if (p_sys->playlist.interval < HLS_RELOAD_MIN)
+            p_sys->playlist.interval = HLS_RELOAD_MIN;
+        p_sys->playlist.wakeup = p_sys->playlist.last + p_sys->playlist.interval;
+        if (p_sys->playlist.b_block && !p_sys->b_meta)
+            p_sys->playlist.wakeup = p_sys->playlist.last;
 
         if (vlc_clone(&p_sys->reload, hls_Reload, s, VLC_THREAD_PRIORITY_LOW))
         {
@@ -1600,16 +2213,34 @@ static int Open(vlc_object_t *p_this)
         }
     }
 
-    if (vlc_clone(&p_sys->thread, hls_Thread, s, VLC_THREAD_PRIORITY_INPUT))
+    int fetchers = var_InheritInteger(s, "hls-fetchers");
+    if (fetchers < 1)
+        fetchers = 1;
+    else if (fetchers > HLS_FETCHERS_MAX)
+        fetchers = HLS_FETCHERS_MAX;
+    for (p_sys->threads = 0; p_sys->threads < fetchers; p_sys->threads++)
+    {
+        if (vlc_clone(&p_sys->thread[p_sys->threads], hls_Thread, s,
+                      VLC_THREAD_PRIORITY_INPUT))
+            break;
+    }
+    if (p_sys->threads == 0)
     {
         if (p_sys->b_live)
+        {
+            vlc_mutex_lock(&p_sys->download.lock_wait);
+            p_sys->b_close = true;
+            vlc_cond_broadcast(&p_sys->download.wait);
+            vlc_mutex_unlock(&p_sys->download.lock_wait);
             vlc_join(p_sys->reload, NULL);
+        }
         goto fail_thread;
     }
 
     return VLC_SUCCESS;
 
 fail_thread:
+    AdaptationClean(s);
     vlc_mutex_destroy(&p_sys->download.lock_wait);
     vlc_cond_destroy(&p_sys->download.wait);
 
@@ -1625,6 +2256,8 @@ fail:
 
     /* */
     vlc_UrlClean(&p_sys->m3u8);
+    free(p_sys->cache.psz_dir);
+    free(p_sys->peek);
     free(p_sys);
     return VLC_EGENERIC;
 }
@@ -1641,13 +2274,16 @@ static void Close(vlc_object_t *p_this)
 
     /* */
     vlc_mutex_lock(&p_sys->download.lock_wait);
-    vlc_cond_signal(&p_sys->download.wait);
+    p_sys->b_close = true;
+    vlc_cond_broadcast(&p_sys->download.wait);
     vlc_mutex_unlock(&p_sys->download.lock_wait);
 
     /* */
     if (p_sys->b_live)
         vlc_join(p_sys->reload, NULL);
-    vlc_join(p_sys->thread, NULL);
+    for (int i = 0; i < p_sys->threads; i++)
+        vlc_join(p_sys->thread[i], NULL);
+    AdaptationClean(s);
     vlc_mutex_destroy(&p_sys->download.lock_wait);
     vlc_cond_destroy(&p_sys->download.wait);
 
@@ -1662,13 +2298,15 @@ static void Close(vlc_object_t *p_this)
 
     /* */
     vlc_UrlClean(&p_sys->m3u8);
+    free(p_sys->cache.psz_dir);
+    free(p_sys->peek);
     free(p_sys);
 }
 
 /****************************************************************************
  * Stream filters functions
  ****************************************************************************/
-static segment_t *GetSegment(stream_t *s)
+static segment_t *FindSegment(stream_t *s)
 {
     stream_sys_t *p_sys = s->p_sys;
     segment_t *segment = NULL;
@@ -1702,6 +2340,10 @@ static segment_t *GetSegment(stream_t *s)
         if (hls == NULL)
             return NULL;
 
+        vlc_mutex_lock(&p_sys->download.lock_wait);
+        int i_segment = p_sys->download.segment;
+        vlc_mutex_unlock(&p_sys->download.lock_wait);
+
         vlc_mutex_lock(&hls->lock);
         segment = segment_GetSegment(hls, p_sys->playback.segment);
         if (segment == NULL)
@@ -1710,10 +2352,6 @@ static segment_t *GetSegment(stream_t *s)
             break;
         }
 
-        vlc_mutex_lock(&p_sys->download.lock_wait);
-        int i_segment = p_sys->download.segment;
-        vlc_mutex_unlock(&p_sys->download.lock_wait);
-
         /* This segment is ready? */
         if ((segment->data != NULL) &&
             (p_sys->playback.segment < i_segment))
@@ -1738,7 +2376,7 @@ static segment_t *GetSegment(stream_t *s)
 
 check:
     /* sanity check */
-    if (segment->data->i_buffer == 0)
+    if (segment->b_complete && (segment->played >= segment->size))
     {
         vlc_mutex_lock(&hls->lock);
         int count = vlc_array_count(hls->segments);
@@ -1754,6 +2392,75 @@ check:
     return segment;
 }
 
+static segment_t *GetSegment(stream_t *s)
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    while (vlc_object_alive(s) && !HasError(s))
+    {
+        segment_t *segment = FindSegment(s);
+        if (segment != NULL)
+            return segment;
+
+        /* Skip a live segment that could not be downloaded */
+        hls_stream_t *hls = hls_Get(p_sys->hls_stream, p_sys->download.stream);
+        if (hls == NULL)
+            break;
+        vlc_mutex_lock(&hls->lock);
+        segment = segment_GetSegment(hls, p_sys->playback.segment);
+        bool b_failed = (segment != NULL) && segment->b_failed;
+        vlc_mutex_unlock(&hls->lock);
+        if ((segment == NULL) && !p_sys->b_live)
+            break; /* end of stream */
+        if (b_failed)
+        {
+            if (!p_sys->b_live)
+                break;
+            msg_Warn(s, "skipping segment %d, download failed",
+                     p_sys->playback.segment);
+            vlc_mutex_lock(&p_sys->download.lock_wait);
+            p_sys->playback.segment++;
+            vlc_mutex_unlock(&p_sys->download.lock_wait);
+            continue;
+        }
+
+        /* Wait for the download threads to fetch this segment */
+        vlc_mutex_lock(&p_sys->download.lock_wait);
+        vlc_cond_timedwait(&p_sys->download.wait, &p_sys->download.lock_wait,
+                           mdate() + HLS_WAIT_TICK);
+        vlc_mutex_unlock(&p_sys->download.lock_wait);
+    }
+    return NULL;
+}
+
+/* Wait until i_size bytes past the playback position are downloaded or
+ * the download ended (segment lock must be held) */
+static void segment_WaitData(stream_t *s, segment_t *segment, uint64_t i_size)
+{
+    while (!segment->b_complete &&
+           (segment->size - segment->played < i_size) &&
+           vlc_object_alive(s))
+        vlc_cond_timedwait(&segment->wait, &segment->lock,
+                           mdate() + HLS_WAIT_TICK);
+}
+
+/* Move playback to the next segment once this one has been played
+ * (segment lock must be held) */
+static void segment_Played(stream_t *s, segment_t *segment)
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    /* played data is dropped, unless it has to be kept in memory */
+    if (!p_sys->b_cache || p_sys->b_live || (p_sys->cache.psz_dir != NULL))
+        segment_Flush(segment);
+    else
+        segment_Rewind(segment);
+
+    vlc_mutex_lock(&p_sys->download.lock_wait);
+    p_sys->playback.segment++;
+    vlc_mutex_unlock(&p_sys->download.lock_wait);
+}
+
 static ssize_t hls_Read(stream_t *s, uint8_t *p_read, unsigned int i_read)
 {
     stream_sys_t *p_sys = s->p_sys;
@@ -1769,50 +2476,36 @@ static ssize_t hls_Read(stream_t *s, uint8_t *p_read, unsigned int i_read)
             break;
 
         vlc_mutex_lock(&segment->lock);
-        if (segment->data->i_buffer == 0)
+        segment_WaitData(s, segment, 1);
+
+        block_t *block = segment_ReadBlock(segment);
+        if (block == NULL)
         {
-            if (!p_sys->b_cache || p_sys->b_live)
-            {
-                block_Release(segment->data);
-                segment->data = NULL;
-            }
-            else
-            {   /* reset playback pointer to start of buffer */
-                uint64_t size = segment->size - segment->data->i_buffer;
-                if (size > 0)
-                {
-                    segment->data->i_buffer += size;
-                    segment->data->p_buffer -= size;
-                }
+            if (!segment->b_complete)
+            {   /* interrupted while waiting for data */
+                vlc_mutex_unlock(&segment->lock);
+                break;
             }
-            p_sys->playback.segment++;
+            segment_Played(s, segment);
             vlc_mutex_unlock(&segment->lock);
 
             /* signal download thread */
             vlc_mutex_lock(&p_sys->download.lock_wait);
-            vlc_cond_signal(&p_sys->download.wait);
+            vlc_cond_broadcast(&p_sys->download.wait);
             vlc_mutex_unlock(&p_sys->download.lock_wait);
             continue;
         }
 
-        if (segment->size == segment->data->i_buffer)
+        if (segment->played == 0)
             msg_Info(s, "playing segment %d from stream %d",
                      segment->sequence, p_sys->playback.stream);
 
-        ssize_t len = -1;
-        if (i_read <= segment->data->i_buffer)
-            len = i_read;
-        else if (i_read > segment->data->i_buffer)
-            len = segment->data->i_buffer;
-
-        if (len > 0)
-        {
-            memcpy(p_read + copied, segment->data->p_buffer, len);
-            segment->data->i_buffer -= len;
-            segment->data->p_buffer += len;
-            copied += len;
-            i_read -= len;
-        }
+        size_t len = __MIN(i_read, block->i_buffer - segment->read_offset);
+        memcpy(p_read + copied, block->p_buffer + segment->read_offset, len);
+        segment->read_offset += len;
+        segment->played += len;
+        copied += len;
+        i_read -= len;
         vlc_mutex_unlock(&segment->lock);
 
     } while ((i_read > 0) && vlc_object_alive(s));
@@ -1827,7 +2520,7 @@ static int Read(stream_t *s, void *buffer, unsigned int i_read)
 
     assert(p_sys->hls_stream);
 
-    if (p_sys->b_error)
+    if (HasError(s))
         return 0;
 
     if (buffer == NULL)
@@ -1850,7 +2543,6 @@ static int Read(stream_t *s, void *buffer, unsigned int i_read)
 static int Peek(stream_t *s, const uint8_t **pp_peek, unsigned int i_peek)
 {
     stream_sys_t *p_sys = s->p_sys;
-    size_t curlen = 0;
     segment_t *segment;
 
 again:
@@ -1863,30 +2555,61 @@ again:
     }
 
     vlc_mutex_lock(&segment->lock);
+    segment_WaitData(s, segment, i_peek);
 
-    /* remember segment to peek */
-    int peek_segment = p_sys->playback.segment;
-    do
+    block_t *block = segment_ReadBlock(segment);
+    if (block == NULL)
     {
-        if (i_peek < segment->data->i_buffer)
+        if (!segment->b_complete)
         {
-            *pp_peek = segment->data->p_buffer;
-            curlen += i_peek;
-        }
-        else
-        {
-            p_sys->playback.segment++;
             vlc_mutex_unlock(&segment->lock);
-            goto again;
+            return 0;
         }
-    } while ((curlen < i_peek) && vlc_object_alive(s));
+        segment_Played(s, segment);
+        vlc_mutex_unlock(&segment->lock);
+        goto again;
+    }
+
+    /* peek does not cross segment boundaries */
+    uint64_t available = segment->size - segment->played;
+    if (i_peek > available)
+        i_peek = available;
 
-    /* restore segment to read */
-    p_sys->playback.segment = peek_segment;
+    /* the data of a segment being downloaded may be swapped for its disk
+     * cache mapping, so it is not handed out directly */
+    if ((segment->b_complete || (p_sys->cache.psz_dir == NULL)) &&
+        (block->i_buffer - segment->read_offset >= i_peek))
+        *pp_peek = block->p_buffer + segment->read_offset;
+    else
+    {
+        /* gather data spanning several blocks */
+        if (p_sys->peek_size < i_peek)
+        {
+            uint8_t *peek = realloc(p_sys->peek, i_peek);
+            if (peek == NULL)
+            {
+                vlc_mutex_unlock(&segment->lock);
+                return 0;
+            }
+            p_sys->peek = peek;
+            p_sys->peek_size = i_peek;
+        }
 
+        size_t offset = segment->read_offset;
+        size_t curlen = 0;
+        while (curlen < i_peek)
+        {
+            size_t len = __MIN(i_peek - curlen, block->i_buffer - offset);
+            memcpy(p_sys->peek + curlen, block->p_buffer + offset, len);
+            curlen += len;
+            block = block->p_next;
+            offset = 0;
+        }
+        *pp_peek = p_sys->peek;
+    }
     vlc_mutex_unlock(&segment->lock);
 
-    return curlen;
+    return i_peek;
 }
 
 static bool hls_MaySeek(stream_t *s)
@@ -1941,6 +2664,7 @@ static int segment_Seek(stream_t *s, const uint64_t pos)
     vlc_mutex_lock(&hls->lock);
 
     bool b_found = false;
+    int playback = -1;
     uint64_t length = 0;
     uint64_t size = hls->size;
     int count = vlc_array_count(hls->segments);
@@ -1962,7 +2686,7 @@ static int segment_Seek(stream_t *s, const uint64_t pos)
         {
             if (count - n >= 3)
             {
-                p_sys->playback.segment = n;
+                playback = n;
                 b_found = true;
                 break;
             }
@@ -1975,7 +2699,7 @@ static int segment_Seek(stream_t *s, const uint64_t pos)
     /* */
     if (!b_found && (pos >= size))
     {
-        p_sys->playback.segment = count - 1;
+        playback = count - 1;
         b_found = true;
     }
 
@@ -1983,7 +2707,7 @@ static int segment_Seek(stream_t *s, const uint64_t pos)
     if (b_found)
     {
         /* restore segment to start position */
-        segment_t *segment = segment_GetSegment(hls, p_sys->playback.segment);
+        segment_t *segment = segment_GetSegment(hls, playback);
         if (segment == NULL)
         {
             vlc_mutex_unlock(&hls->lock);
@@ -1991,15 +2715,7 @@ static int segment_Seek(stream_t *s, const uint64_t pos)
         }
 
         vlc_mutex_lock(&segment->lock);
-        if (segment->data)
-        {
-            uint64_t size = segment->size -segment->data->i_buffer;
-            if (size > 0)
-            {
-                segment->data->i_buffer += size;
-                segment->data->p_buffer -= size;
-            }
-        }
+        segment_Rewind(segment);
         vlc_mutex_unlock(&segment->lock);
 
         /* start download at current playback segment */
@@ -2007,8 +2723,9 @@ static int segment_Seek(stream_t *s, const uint64_t pos)
 
         /* Wake up download thread */
         vlc_mutex_lock(&p_sys->download.lock_wait);
-        p_sys->download.seek = p_sys->playback.segment;
-        vlc_cond_signal(&p_sys->download.wait);
+        p_sys->playback.segment = playback;
+        p_sys->download.seek = playback;
+        vlc_cond_broadcast(&p_sys->download.wait);
         vlc_mutex_unlock(&p_sys->download.lock_wait);
 
         /* Wait for download to be finished */
@@ -2019,7 +2736,7 @@ static int segment_Seek(stream_t *s, const uint64_t pos)
                 (p_sys->download.segment < (count - 6)))
         {
             vlc_cond_wait(&p_sys->download.wait, &p_sys->download.lock_wait);
-            if (!vlc_object_alive(s) || s->b_error) break;
+            if (!vlc_object_alive(s) || p_sys->b_error) break;
         }
         vlc_mutex_unlock(&p_sys->download.lock_wait);
 
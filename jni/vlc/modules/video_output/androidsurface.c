@@ -61,8 +61,9 @@ vlc_module_end()
  * JNI prototypes
  *****************************************************************************/
 
-extern void *jni_LockAndGetAndroidSurface(vlc_object_t *);
-extern void  jni_UnlockAndroidSurface(vlc_object_t *);
+extern void *jni_GetAndroidPlayer(vlc_object_t *);
+extern void *jni_LockAndGetAndroidSurface(void *);
+extern void  jni_UnlockAndroidSurface(void *);
 extern void  jni_SetAndroidSurfaceSize(vlc_object_t *, int width, int height);
 
 // _ZN7android7Surface4lockEPNS0_11SurfaceInfoEb
@@ -85,9 +86,8 @@ struct vout_display_sys_t {
     Surface_lock s_lock;
     Surface_unlockAndPost s_unlockAndPost;
 
-    picture_resource_t resource;
-
     vlc_object_t *p_vout;
+    void *p_player;
 };
 
 /* */
@@ -101,8 +101,10 @@ typedef struct _SurfaceInfo {
     uint32_t    reserved[2];
 } SurfaceInfo;
 
-struct picture_sys_t
-{
+/* The picture is the surface buffer itself: it is locked when the picture
+ * is taken from the pool, by the decoder thread, and posted when it is
+ * released after display, by the vout thread. */
+struct picture_sys_t {
     void *surf;
     SurfaceInfo info;
     vout_display_sys_t *sys;
@@ -111,8 +113,6 @@ struct picture_sys_t
 static int  AndroidLockSurface(picture_t *);
 static void AndroidUnlockSurface(picture_t *);
 
-static vlc_mutex_t single_instance = VLC_STATIC_MUTEX;
-
 static inline void *LoadSurface(const char *psz_lib, vout_display_sys_t *sys) {
     void *p_library = dlopen(psz_lib, RTLD_NOW);
     if (p_library) {
@@ -139,25 +139,16 @@ static int Open(vlc_object_t *p_this) {
     vout_display_sys_t *sys;
     void *p_library;
 
-    /* */
-    if (vlc_mutex_trylock(&single_instance) != 0) {
-        msg_Err(vd, "Can't start more than one instance at a time");
-        return VLC_EGENERIC;
-    }
-
     /* Allocate structure */
     sys = (struct vout_display_sys_t*) calloc(1, sizeof(*sys));
-    if (!sys) {
-        vlc_mutex_unlock(&single_instance);
+    if (!sys)
         return VLC_ENOMEM;
-    }
 
     /* */
     sys->p_library = p_library = InitLibrary(sys);
     if (!p_library) {
         free(sys);
         msg_Err(vd, "Could not initialize libui.so/libsurfaceflinger_client.so!");
-        vlc_mutex_unlock(&single_instance);
         return VLC_EGENERIC;
     }
 
@@ -172,36 +163,6 @@ static int Open(vlc_object_t *p_this) {
     fmt.i_bmask  = 0x0000001f;
     video_format_FixRgb(&fmt);
 
-    /* Create the associated picture */
-    picture_resource_t *rsc = &sys->resource;
-    rsc->p_sys = malloc(sizeof(*rsc->p_sys));
-    if (!rsc->p_sys)
-        goto enomem;
-    rsc->p_sys->sys = sys;
-
-    for (int i = 0; i < PICTURE_PLANE_MAX; i++) {
-        rsc->p[i].p_pixels = NULL;
-        rsc->p[i].i_pitch = 0;
-        rsc->p[i].i_lines = 0;
-    }
-    picture_t *picture = picture_NewFromResource(&fmt, rsc);
-    if (!picture)
-        goto enomem;
-
-    /* Wrap it into a picture pool */
-    picture_pool_configuration_t pool_cfg;
-    memset(&pool_cfg, 0, sizeof(pool_cfg));
-    pool_cfg.picture_count = 1;
-    pool_cfg.picture       = &picture;
-    pool_cfg.lock          = AndroidLockSurface;
-    pool_cfg.unlock        = AndroidUnlockSurface;
-
-    sys->pool = picture_pool_NewExtended(&pool_cfg);
-    if (!sys->pool) {
-        picture_Release(picture);
-        goto enomem;
-    }
-
     /* Setup vout_display */
     vd->sys     = sys;
     vd->fmt     = fmt;
@@ -215,63 +176,87 @@ static int Open(vlc_object_t *p_this) {
     vout_display_SendEventFullscreen(vd, false);
 
     return VLC_SUCCESS;
-
-enomem:
-    free(rsc->p_sys);
-    free(sys);
-    dlclose(p_library);
-    vlc_mutex_unlock(&single_instance);
-    return VLC_ENOMEM;
 }
 
 static void Close(vlc_object_t *p_this) {
     vout_display_t *vd = (vout_display_t *)p_this;
     vout_display_sys_t *sys = vd->sys;
 
-    picture_pool_Delete(sys->pool);
+    if (sys->pool)
+        picture_pool_Delete(sys->pool);
     dlclose(sys->p_library);
     free(sys);
-    vlc_mutex_unlock(&single_instance);
 }
 
 static picture_pool_t *Pool(vout_display_t *vd, unsigned count) {
     vout_display_sys_t *sys = vd->sys;
     VLC_UNUSED(count);
+
+    if (sys->pool)
+        return sys->pool;
+
+    /* Surface_lock gives access to one buffer at a time, so there is a
+     * single picture: the next one is decoded once this one is posted */
+    picture_sys_t *picsys = calloc(1, sizeof(*picsys));
+    if (unlikely(!picsys))
+        return NULL;
+    picsys->sys = sys;
+
+    picture_resource_t rsc = { .p_sys = picsys };
+    picture_t *picture = picture_NewFromResource(&vd->fmt, &rsc);
+    if (!picture) {
+        free(picsys);
+        return NULL;
+    }
+
+    picture_pool_configuration_t pool_cfg;
+    memset(&pool_cfg, 0, sizeof(pool_cfg));
+    pool_cfg.picture_count = 1;
+    pool_cfg.picture       = &picture;
+    pool_cfg.lock          = AndroidLockSurface;
+    pool_cfg.unlock        = AndroidUnlockSurface;
+
+    sys->pool = picture_pool_NewExtended(&pool_cfg);
+    if (!sys->pool)
+        picture_Release(picture);
     return sys->pool;
 }
 
-static int  AndroidLockSurface(picture_t *picture) {
+static int AndroidLockSurface(picture_t *picture) {
     picture_sys_t *picsys = picture->p_sys;
     vout_display_sys_t *sys = picsys->sys;
-    SurfaceInfo *info;
-    uint32_t sw, sh;
-    void *surf;
-
-    sw = picture->p[0].i_visible_pitch / picture->p[0].i_pixel_pitch;
-    sh = picture->p[0].i_visible_lines;
+    SurfaceInfo *info = &picsys->info;
 
-    picsys->surf = surf = jni_LockAndGetAndroidSurface(sys->p_vout);
-    info = &(picsys->info);
+    /* the player is not known until the vout is attached to its input */
+    if (unlikely(!sys->p_player)) {
+        sys->p_player = jni_GetAndroidPlayer(sys->p_vout);
+        if (!sys->p_player)
+            return VLC_EGENERIC;
+    }
 
-    if (unlikely(!surf)) {
-        jni_UnlockAndroidSurface(sys->p_vout);
+    picsys->surf = jni_LockAndGetAndroidSurface(sys->p_player);
+    if (unlikely(!picsys->surf)) {
+        jni_UnlockAndroidSurface(sys->p_player);
         return VLC_EGENERIC;
     }
 
-    sys->s_lock(surf, info, 1);
+    sys->s_lock(picsys->surf, info, 1);
 
     // input size doesn't match the surface size,
     // request a resize
+    uint32_t sw = picture->p[0].i_visible_pitch / picture->p[0].i_pixel_pitch;
+    uint32_t sh = picture->p[0].i_visible_lines;
     if (info->w != sw || info->h != sh) {
         jni_SetAndroidSurfaceSize(sys->p_vout, sw, sh);
-        sys->s_unlockAndPost(surf);
-        jni_UnlockAndroidSurface(sys->p_vout);
+        sys->s_unlockAndPost(picsys->surf);
+        picsys->surf = NULL;
+        jni_UnlockAndroidSurface(sys->p_player);
         return VLC_EGENERIC;
     }
 
     picture->p->p_pixels = (uint8_t*)info->bits;
-    picture->p->i_pitch = 2 * info->s;
-    picture->p->i_lines = info->h;
+    picture->p->i_pitch  = 2 * info->s;
+    picture->p->i_lines  = info->h;
 
     return VLC_SUCCESS;
 }
@@ -280,14 +265,18 @@ static void AndroidUnlockSurface(picture_t *picture) {
     picture_sys_t *picsys = picture->p_sys;
     vout_display_sys_t *sys = picsys->sys;
 
-    if (likely(picsys->surf))
+    if (likely(picsys->surf)) {
         sys->s_unlockAndPost(picsys->surf);
-    jni_UnlockAndroidSurface(sys->p_vout);
+        picsys->surf = NULL;
+        jni_UnlockAndroidSurface(sys->p_player);
+    }
 }
 
 static void Display(vout_display_t *vd, picture_t *picture, subpicture_t *subpicture) {
     VLC_UNUSED(vd);
     VLC_UNUSED(subpicture);
+
+    /* the surface is posted when the picture goes back to the pool */
     picture_Release(picture);
 }
 
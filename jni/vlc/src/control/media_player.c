@@ -466,6 +466,8 @@ libvlc_media_player_new( libvlc_instance_t *instance )
     mp->p_libvlc_instance = instance;
     mp->input.p_thread = NULL;
     mp->input.p_resource = NULL;
+    for (unsigned i = 0; i < MEDIA_PLAYER_STANDBY_MAX; i++)
+        mp->input.pp_standby[i] = NULL;
     vlc_mutex_init (&mp->input.lock);
     mp->i_refcount = 1;
     mp->p_event_manager = libvlc_event_manager_new(mp, instance);
@@ -546,6 +548,9 @@ static void libvlc_media_player_destroy( libvlc_media_player_t *p_mi )
     /* No need for lock_input() because no other threads knows us anymore */
     if( p_mi->input.p_thread )
         release_input_thread(p_mi, true);
+    for( unsigned i = 0; i < MEDIA_PLAYER_STANDBY_MAX; i++ )
+        if( p_mi->input.pp_standby[i] )
+            input_standby_Delete( p_mi->input.pp_standby[i] );
     if( p_mi->input.p_resource )
     {
         input_resource_Terminate( p_mi->input.p_resource );
@@ -668,10 +673,21 @@ libvlc_media_player_event_manager( libvlc_media_player_t *p_mi )
     return p_mi->p_event_manager;
 }
 
-/**************************************************************************
- * Tell media player to start playing.
- **************************************************************************/
-int libvlc_media_player_play( libvlc_media_player_t *p_mi )
+static void drop_start_objects( input_standby_t *p_standby,
+                                input_view_t *p_view )
+{
+    if( p_standby )
+        input_standby_Delete( p_standby );
+    if( p_view )
+        input_view_Release( p_view );
+}
+
+/*
+ * Start playing, optionally from a standby input or from a view of the
+ * program of another input (which are consumed).
+ */
+static int start_input( libvlc_media_player_t *p_mi,
+                        input_standby_t *p_standby, input_view_t *p_view )
 {
     lock_input( p_mi );
 
@@ -681,6 +697,7 @@ int libvlc_media_player_play( libvlc_media_player_t *p_mi )
         /* A thread already exists, send it a play message */
         input_Control( p_input_thread, INPUT_SET_STATE, PLAYING_S );
         unlock_input( p_mi );
+        drop_start_objects( p_standby, p_view );
         return 0;
     }
 
@@ -691,6 +708,7 @@ int libvlc_media_player_play( libvlc_media_player_t *p_mi )
     {
         unlock(p_mi);
         unlock_input( p_mi );
+        drop_start_objects( p_standby, p_view );
         libvlc_printerr( "No associated media descriptor" );
         return -1;
     }
@@ -703,9 +721,15 @@ int libvlc_media_player_play( libvlc_media_player_t *p_mi )
     if( !p_input_thread )
     {
         unlock_input(p_mi);
+        drop_start_objects( p_standby, p_view );
         libvlc_printerr( "Not enough memory" );
         return -1;
     }
+    /* The input owns the standby and the view from now on */
+    if( p_standby )
+        var_SetAddress( p_input_thread, "input-standby", p_standby );
+    if( p_view )
+        var_SetAddress( p_input_thread, "input-view", p_view );
 
     var_AddCallback( p_input_thread, "can-seek", input_seekable_changed, p_mi );
     var_AddCallback( p_input_thread, "can-pause", input_pausable_changed, p_mi );
@@ -726,6 +750,164 @@ int libvlc_media_player_play( libvlc_media_player_t *p_mi )
     return 0;
 }
 
+/**************************************************************************
+ * Tell media player to start playing.
+ **************************************************************************/
+int libvlc_media_player_play( libvlc_media_player_t *p_mi )
+{
+    return start_input( p_mi, NULL, NULL );
+}
+
+/**************************************************************************
+ * Switch to another media without tearing the player down.
+ *
+ * Unlike set_media() followed by stop()/play(), the input resource is not
+ * terminated: the video output, the audio output and the decoders released
+ * by the old input stay parked in it and are picked up by the new input
+ * (decoders only if the new streams have the same codec and format).
+ **************************************************************************/
+int libvlc_media_player_switch_media( libvlc_media_player_t *p_mi,
+                                      libvlc_media_t *p_md )
+{
+    input_standby_t *p_standby = NULL;
+
+    assert( p_md );
+    char *psz_mrl = input_item_GetURI( p_md->p_input_item );
+
+    lock_input( p_mi );
+    /* Keep the decoders loaded for the new input if it has the same formats */
+    if( p_mi->input.p_resource )
+        input_resource_SetKeepDecoders( p_mi->input.p_resource, true );
+    release_input_thread( p_mi, true );
+    if( p_mi->input.p_resource )
+        input_resource_SetKeepDecoders( p_mi->input.p_resource, false );
+
+    /* Promote the standby input of that media if there is one */
+    for( unsigned i = 0; psz_mrl && i < MEDIA_PLAYER_STANDBY_MAX; i++ )
+    {
+        input_standby_t *p_sby = p_mi->input.pp_standby[i];
+        if( p_sby && !strcmp( input_standby_GetMRL( p_sby ), psz_mrl ) )
+        {
+            p_standby = p_sby;
+            p_mi->input.pp_standby[i] = NULL;
+            break;
+        }
+    }
+    free( psz_mrl );
+
+    lock( p_mi );
+    libvlc_media_release( p_mi->p_md );
+    libvlc_media_retain( p_md );
+    p_mi->p_md = p_md;
+    p_mi->p_libvlc_instance = p_md->p_libvlc_instance;
+    unlock( p_mi );
+    unlock_input( p_mi );
+
+    libvlc_event_t event;
+    event.type = libvlc_MediaPlayerMediaChanged;
+    event.u.media_player_media_changed.new_media = p_md;
+    libvlc_event_send( p_mi->p_event_manager, &event );
+
+    return start_input( p_mi, p_standby, NULL );
+}
+
+/**************************************************************************
+ * Play a program demuxed by another media player.
+ *
+ * The view input plays a dummy media that only waits, its decoders are fed
+ * by the demuxer of the source input.
+ **************************************************************************/
+int libvlc_media_player_play_view( libvlc_media_player_t *p_mi,
+                                   libvlc_media_player_t *p_source,
+                                   int i_program )
+{
+    input_thread_t *p_source_input = libvlc_get_input_thread( p_source );
+    if( !p_source_input )
+    {
+        libvlc_printerr( "Source media player is not playing" );
+        return -1;
+    }
+
+    input_view_t *p_view = input_view_New( p_source_input, i_program );
+    vlc_object_release( p_source_input );
+    if( !p_view )
+    {
+        libvlc_printerr( "Not enough memory" );
+        return -1;
+    }
+
+    libvlc_media_t *p_md =
+        libvlc_media_new_location( p_source->p_libvlc_instance, "vlc://pause" );
+    if( !p_md )
+    {
+        libvlc_printerr( "Not enough memory" );
+        input_view_Release( p_view );
+        return -1;
+    }
+
+    lock_input( p_mi );
+    release_input_thread( p_mi, true );
+
+    lock( p_mi );
+    libvlc_media_release( p_mi->p_md );
+    p_mi->p_md = p_md;
+    p_mi->p_libvlc_instance = p_md->p_libvlc_instance;
+    unlock( p_mi );
+    unlock_input( p_mi );
+
+    libvlc_event_t event;
+    event.type = libvlc_MediaPlayerMediaChanged;
+    event.u.media_player_media_changed.new_media = p_md;
+    libvlc_event_send( p_mi->p_event_manager, &event );
+
+    return start_input( p_mi, NULL, p_view );
+}
+
+/**************************************************************************
+ * Keep a media connected in the background for a later switch_media().
+ **************************************************************************/
+int libvlc_media_player_set_standby( libvlc_media_player_t *p_mi,
+                                     unsigned i_slot, libvlc_media_t *p_md )
+{
+    input_standby_t *p_standby = NULL;
+
+    if( i_slot >= MEDIA_PLAYER_STANDBY_MAX )
+    {
+        libvlc_printerr( "Invalid standby slot %u", i_slot );
+        return -1;
+    }
+
+    lock_input( p_mi );
+    input_standby_t *p_old = p_mi->input.pp_standby[i_slot];
+    if( p_md )
+    {
+        char *psz_mrl = input_item_GetURI( p_md->p_input_item );
+
+        /* Keep the running one if it is for the same media */
+        if( p_old && psz_mrl &&
+            !strcmp( input_standby_GetMRL( p_old ), psz_mrl ) )
+        {
+            free( psz_mrl );
+            unlock_input( p_mi );
+            return 0;
+        }
+        if( psz_mrl )
+            p_standby = input_standby_New( p_mi, p_md->p_input_item );
+        free( psz_mrl );
+    }
+    p_mi->input.pp_standby[i_slot] = p_standby;
+    unlock_input( p_mi );
+
+    if( p_old )
+        input_standby_Delete( p_old );
+    if( p_md && !p_standby )
+    {
+        libvlc_printerr( "Standby input creation failure" );
+        return -1;
+    }
+    return 0;
+}
+
 void libvlc_media_player_set_pause( libvlc_media_player_t *p_mi, int paused )
 {
     input_thread_t * p_input_thread = libvlc_get_input_thread( p_mi );
@@ -34,6 +34,9 @@
 #include <vlc/libvlc_media.h>
 #include <vlc_input.h>
 
+/* Number of standby inputs a media player can keep */
+#define MEDIA_PLAYER_STANDBY_MAX 2
+
 struct libvlc_media_player_t
 {
     VLC_COMMON_MEMBERS
@@ -45,6 +48,7 @@ struct libvlc_media_player_t
     {
         input_thread_t   *p_thread;
         input_resource_t *p_resource;
+        input_standby_t  *pp_standby[MEDIA_PLAYER_STANDBY_MAX];
         vlc_mutex_t       lock;
     } input;
 
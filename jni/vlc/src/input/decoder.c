@@ -57,6 +57,11 @@ static decoder_t *CreateDecoder( vlc_object_t *, input_thread_t *,
                                  es_format_t *, bool, input_resource_t *,
                                  sout_instance_t *p_sout );
 static void       DeleteDecoder( decoder_t * );
+static void       DecoderReleaseOutputs( decoder_t * );
+static bool       DecoderKeep( decoder_t * );
+static void       DecoderReuse( decoder_t *, vlc_object_t *, input_thread_t *,
+                                  const es_format_t * );
+static void       DecoderReparent( decoder_t *, vlc_object_t * );
 
 static void      *DecoderThread( void * );
 static void       DecoderProcess( decoder_t *, block_t * );
@@ -273,24 +278,35 @@ static decoder_t *decoder_New( vlc_object_t *p_parent, input_thread_t *p_input,
     const char *psz_type = p_sout ? N_("packetizer") : N_("decoder");
     int i_priority;
 
-    /* Create the decoder configuration structure */
-    p_dec = CreateDecoder( p_parent, p_input, fmt,
-                           p_sout != NULL, p_resource, p_sout );
-    if( p_dec == NULL )
+    /* Take over the decoder a previous input left for this format, if any */
+    if( p_input != NULL && p_sout == NULL )
+        p_dec = input_resource_GetDecoder( p_resource, fmt );
+
+    if( p_dec != NULL )
     {
-        msg_Err( p_parent, "could not create %s", psz_type );
-        dialog_Fatal( p_parent, _("Streaming / Transcoding failed"),
-                      _("VLC could not open the %s module."),
-                      vlc_gettext( psz_type ) );
-        return NULL;
+        DecoderReuse( p_dec, p_parent, p_input, fmt );
     }
-
-    if( !p_dec->p_module )
+    else
     {
-        DecoderUnsupportedCodec( p_dec, fmt->i_codec );
+        /* Create the decoder configuration structure */
+        p_dec = CreateDecoder( p_parent, p_input, fmt,
+                               p_sout != NULL, p_resource, p_sout );
+        if( p_dec == NULL )
+        {
+            msg_Err( p_parent, "could not create %s", psz_type );
+            dialog_Fatal( p_parent, _("Streaming / Transcoding failed"),
+                          _("VLC could not open the %s module."),
+                          vlc_gettext( psz_type ) );
+            return NULL;
+        }
 
-        DeleteDecoder( p_dec );
-        return NULL;
+        if( !p_dec->p_module )
+        {
+            DecoderUnsupportedCodec( p_dec, fmt->i_codec );
+
+            DeleteDecoder( p_dec );
+            return NULL;
+        }
     }
 
     p_dec->p_owner->p_clock = p_clock;
@@ -365,8 +381,6 @@ void input_DecoderDelete( decoder_t *p_dec )
     vlc_join( p_owner->thread, NULL );
     p_owner->b_paused = b_was_paused;
 
-    module_unneed( p_dec, p_dec->p_module );
-
     /* */
     if( p_dec->p_owner->cc.b_supported )
     {
@@ -375,7 +389,20 @@ void input_DecoderDelete( decoder_t *p_dec )
             input_DecoderSetCcState( p_dec, false, i );
     }
 
+    /* Keep the module loaded for the next input of the resource */
+    if( DecoderKeep( p_dec ) )
+        return;
+
     /* Delete decoder */
+    input_DecoderDestroy( p_dec );
+}
+
+/**
+ * Destroys a decoder whose thread has been stopped
+ */
+void input_DecoderDestroy( decoder_t *p_dec )
+{
+    module_unneed( p_dec, p_dec->p_module );
     DeleteDecoder( p_dec );
 }
 
@@ -2096,35 +2123,21 @@ static void DecoderError( decoder_t *p_dec, block_t *p_block )
 
 
 /**
- * Destroys a decoder object
- *
- * \param p_dec the decoder object
- * \return nothing
+ * Gives the audio and video outputs of a stopped decoder back to the input
+ * resource
  */
-static void DeleteDecoder( decoder_t * p_dec )
+static void DecoderReleaseOutputs( decoder_t *p_dec )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
 
-    msg_Dbg( p_dec, "killing decoder fourcc `%4.4s', %u PES in FIFO",
-             (char*)&p_dec->fmt_in.i_codec,
-             (unsigned)block_FifoCount( p_owner->p_fifo ) );
-
-    /* Free all packets still in the decoder fifo. */
-    block_FifoEmpty( p_owner->p_fifo );
-    block_FifoRelease( p_owner->p_fifo );
-
-    /* */
-    vlc_mutex_lock( &p_owner->lock );
-    DecoderFlushBuffering( p_dec );
-    vlc_mutex_unlock( &p_owner->lock );
-
-    /* Cleanup */
     if( p_owner->p_aout )
     {
         aout_DecDelete( p_owner->p_aout, p_owner->p_aout_input );
         input_resource_RequestAout( p_owner->p_resource, p_owner->p_aout );
         if( p_owner->p_input != NULL )
             input_SendEventAout( p_owner->p_input );
+        p_owner->p_aout = NULL;
+        p_owner->p_aout_input = NULL;
     }
     if( p_owner->p_vout )
     {
@@ -2137,7 +2150,147 @@ static void DeleteDecoder( decoder_t * p_dec )
                                     0, true );
         if( p_owner->p_input != NULL )
             input_SendEventVout( p_owner->p_input );
+        p_owner->p_vout = NULL;
     }
+}
+
+/**
+ * Parks a decoder whose thread has been stopped in the input resource, so
+ * that the next input of the resource can take it over when its stream
+ * has the same format, instead of unloading and loading the module again.
+ *
+ * \return true if the decoder has been kept
+ */
+static bool DecoderKeep( decoder_t *p_dec )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    input_thread_t *p_input = p_owner->p_input;
+
+    /* Only a resource that outlives its inputs can hand the decoder over */
+    if( p_input == NULL || p_input->p->p_resource_private != NULL ||
+        p_owner->b_packetizer || p_owner->p_sout != NULL || p_dec->b_error )
+        return false;
+    if( p_dec->fmt_in.i_cat != VIDEO_ES && p_dec->fmt_in.i_cat != AUDIO_ES )
+        return false;
+    /* Only while the input is stopped to switch to another one */
+    if( !input_resource_IsKeepingDecoders( p_owner->p_resource ) )
+        return false;
+
+    /* Drop the state of the old stream (the thread is stopped, so b_exit
+     * makes the output discard anything the flush returns) */
+    block_t *p_null = DecoderBlockFlushNew();
+    if( p_null )
+        DecoderProcess( p_dec, p_null );
+
+    block_FifoEmpty( p_owner->p_fifo );
+
+    vlc_mutex_lock( &p_owner->lock );
+    DecoderFlushBuffering( p_dec );
+    vlc_mutex_unlock( &p_owner->lock );
+
+    DecoderReleaseOutputs( p_dec );
+
+    p_owner->p_input = NULL;
+    p_owner->p_clock = NULL;
+
+    /* The stopped input must not be kept alive by its child */
+    DecoderReparent( p_dec, VLC_OBJECT(p_dec->p_libvlc) );
+
+    msg_Dbg( p_dec, "keeping decoder fourcc `%4.4s' for the next input",
+             (char*)&p_dec->fmt_in.i_codec );
+
+    decoder_t *p_old = input_resource_PutDecoder( p_owner->p_resource, p_dec );
+    if( p_old )
+        input_DecoderDestroy( p_old );
+    return true;
+}
+
+/**
+ * Moves a stopped decoder, and its packetizer if any, under another object
+ */
+static void DecoderReparent( decoder_t *p_dec, vlc_object_t *p_parent )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+
+    vlc_object_reparent( p_dec, p_parent );
+    if( p_owner->p_packetizer )
+        vlc_object_reparent( p_owner->p_packetizer, p_parent );
+}
+
+/**
+ * Resets the state of a decoder taken over from a previous input
+ */
+static void DecoderReuse( decoder_t *p_dec, vlc_object_t *p_parent,
+                          input_thread_t *p_input, const es_format_t *fmt )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+
+    DecoderReparent( p_dec, p_parent );
+    /* It was killed along with the previous input */
+    p_dec->b_die = false;
+    if( p_owner->p_packetizer )
+        p_owner->p_packetizer->b_die = false;
+
+    msg_Dbg( p_dec, "reusing decoder fourcc `%4.4s'",
+             (char*)&p_dec->fmt_in.i_codec );
+
+    /* The format is similar, but it describes another stream */
+    p_dec->fmt_in.i_id = p_dec->fmt_out.i_id = fmt->i_id;
+    p_dec->fmt_in.i_group = p_dec->fmt_out.i_group = fmt->i_group;
+    free( p_dec->fmt_in.psz_language );
+    p_dec->fmt_in.psz_language =
+        fmt->psz_language ? strdup( fmt->psz_language ) : NULL;
+    free( p_dec->fmt_in.psz_description );
+    p_dec->fmt_in.psz_description =
+        fmt->psz_description ? strdup( fmt->psz_description ) : NULL;
+
+    p_owner->p_input = p_input;
+    p_owner->i_preroll_end = VLC_TS_INVALID;
+    p_owner->i_last_rate = INPUT_RATE_DEFAULT;
+
+    p_owner->b_exit = false;
+
+    p_owner->b_paused = false;
+    p_owner->pause.i_date = VLC_TS_INVALID;
+    p_owner->pause.i_ignore = 0;
+
+    p_owner->b_buffering = false;
+    p_owner->buffer.b_first = true;
+    p_owner->buffer.b_full = false;
+    p_owner->buffer.i_count = 0;
+
+    p_owner->b_flushing = false;
+
+    for( unsigned i = 0; i < 4; i++ )
+        p_owner->cc.pb_present[i] = false;
+    p_owner->i_ts_delay = 0;
+}
+
+/**
+ * Destroys a decoder object
+ *
+ * \param p_dec the decoder object
+ * \return nothing
+ */
+static void DeleteDecoder( decoder_t * p_dec )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+
+    msg_Dbg( p_dec, "killing decoder fourcc `%4.4s', %u PES in FIFO",
+             (char*)&p_dec->fmt_in.i_codec,
+             (unsigned)block_FifoCount( p_owner->p_fifo ) );
+
+    /* Free all packets still in the decoder fifo. */
+    block_FifoEmpty( p_owner->p_fifo );
+    block_FifoRelease( p_owner->p_fifo );
+
+    /* */
+    vlc_mutex_lock( &p_owner->lock );
+    DecoderFlushBuffering( p_dec );
+    vlc_mutex_unlock( &p_owner->lock );
+
+    /* Cleanup */
+    DecoderReleaseOutputs( p_dec );
 
 #ifdef ENABLE_SOUT
     if( p_owner->p_sout_input )
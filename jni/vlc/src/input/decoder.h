@@ -33,6 +33,12 @@
 decoder_t *input_DecoderNew( input_thread_t *, es_format_t *, input_clock_t *,
                              sout_instance_t * ) VLC_USED;
 
+/**
+ * This function destroys a decoder whose thread is not running anymore,
+ * like the ones kept by an input resource.
+ */
+void input_DecoderDestroy( decoder_t * );
+
 /**
  * This function changes the pause state.
  * The date parameter MUST hold the exact date at wich the change has been
@@ -76,6 +76,7 @@ static void ObjectKillChildrens( input_thread_t *, vlc_object_t * );
 
 static inline int ControlPop( input_thread_t *, int *, vlc_value_t *, mtime_t i_deadline, bool b_postpone_seek );
 static void       ControlRelease( int i_type, vlc_value_t val );
+static bool       ControlIsMandatory( int i_type );
 static bool       ControlIsSeekRequest( int i_type );
 static bool       Control( input_thread_t *, int, vlc_value_t );
 
@@ -398,6 +399,9 @@ static input_thread_t *Create( vlc_object_t *p_parent, input_item_t *p_item,
     p_input->p->i_slave = 0;
     p_input->p->slave   = NULL;
 
+    /* No view */
+    TAB_INIT( p_input->p->i_view, p_input->p->view );
+
     /* */
     if( p_resource )
     {
@@ -411,6 +415,13 @@ static input_thread_t *Create( vlc_object_t *p_parent, input_item_t *p_item,
     }
     input_resource_SetInput( p_input->p->p_resource, p_input );
 
+    /* Optional standby input to start from, owned by the input once set */
+    var_Create( p_input, "input-standby", VLC_VAR_ADDRESS );
+
+    /* Optional view of the program of another input to play instead of the
+     * item, owned by the input once set */
+    var_Create( p_input, "input-view", VLC_VAR_ADDRESS );
+
     /* Init control buffer */
     vlc_mutex_init( &p_input->p->lock_control );
     vlc_cond_init( &p_input->p->wait_control );
@@ -517,6 +528,15 @@ static void Destructor( input_thread_t * p_input )
     if( p_input->p->p_es_out_display )
         es_out_Delete( p_input->p->p_es_out_display );
 
+    /* The standby was not used (early failure) */
+    input_standby_t *p_standby = var_GetAddress( p_input, "input-standby" );
+    if( p_standby )
+        input_standby_Delete( p_standby );
+
+    input_view_t *p_view = var_GetAddress( p_input, "input-view" );
+    if( p_view )
+        input_view_Release( p_view );
+
     if( p_input->p->p_resource )
         input_resource_Release( p_input->p->p_resource );
     if( p_input->p->p_resource_private )
@@ -1281,6 +1301,10 @@ static int Init( input_thread_t * p_input )
         LoadSlaves( p_input );
         InitPrograms( p_input );
 
+        input_view_t *p_view = var_GetAddress( p_input, "input-view" );
+        if( p_view )
+            input_view_Attach( p_view, p_input );
+
         double f_rate = var_InheritFloat( p_input, "rate" );
         if( f_rate != 0.0 && f_rate != 1.0 )
         {
@@ -1397,6 +1421,11 @@ static void End( input_thread_t * p_input )
     /* Clean control variables */
     input_ControlVarStop( p_input );
 
+    /* Stop receiving the program we view, before our es_out goes away */
+    input_view_t *p_view = var_GetAddress( p_input, "input-view" );
+    if( p_view )
+        input_view_Detach( p_view );
+
     /* Stop es out activity */
     es_out_SetMode( p_input->p->p_es_out, ES_OUT_MODE_NONE );
 
@@ -1411,6 +1440,11 @@ static void End( input_thread_t * p_input )
     }
     free( p_input->p->slave );
 
+    /* The demuxer does not use the views anymore */
+    for( i = 0; i < p_input->p->i_view; i++ )
+        input_view_Release( p_input->p->view[i] );
+    TAB_CLEAN( p_input->p->i_view, p_input->p->view );
+
     /* Unload all modules */
     if( p_input->p->p_es_out )
         es_out_Delete( p_input->p->p_es_out );
@@ -1484,6 +1518,26 @@ void input_ControlPush( input_thread_t *p_input,
         p_input->p->i_control = 0;
     }
 
+    if( p_input->p->i_control >= INPUT_CONTROL_FIFO_SIZE &&
+        ControlIsMandatory( i_type ) )
+    {
+        /* Make room by trashing the last control that may be lost */
+        for( int i = p_input->p->i_control - 1; i >= 0; i-- )
+        {
+            input_control_t *p_ctrl = &p_input->p->control[i];
+            if( ControlIsMandatory( p_ctrl->i_type ) )
+                continue;
+
+            msg_Err( p_input, "input control fifo overflow, trashing type=%d",
+                     p_ctrl->i_type );
+            ControlRelease( p_ctrl->i_type, p_ctrl->val );
+            p_input->p->i_control--;
+            memmove( p_ctrl, p_ctrl + 1,
+                     sizeof(*p_ctrl) * (p_input->p->i_control - i) );
+            break;
+        }
+    }
+
     if( p_input->p->i_control >= INPUT_CONTROL_FIFO_SIZE )
     {
         msg_Err( p_input, "input control fifo overflow, trashing type=%d",
@@ -1599,6 +1653,21 @@ static bool ControlIsSeekRequest( int i_type )
     }
 }
 
+/* The views of a program must not be lost: a source would keep sending the
+ * program to a view that went away, and a view would wait forever */
+static bool ControlIsMandatory( int i_type )
+{
+    switch( i_type )
+    {
+    case INPUT_CONTROL_ADD_VIEW:
+    case INPUT_CONTROL_DEL_VIEW:
+    case INPUT_CONTROL_VIEW_FAILED:
+        return true;
+    default:
+        return false;
+    }
+}
+
 static void ControlRelease( int i_type, vlc_value_t val )
 {
     switch( i_type )
@@ -1608,6 +1677,11 @@ static void ControlRelease( int i_type, vlc_value_t val )
         free( val.psz_string );
         break;
 
+    case INPUT_CONTROL_ADD_VIEW:
+    case INPUT_CONTROL_DEL_VIEW:
+        input_view_Release( val.p_address );
+        break;
+
     default:
         break;
     }
@@ -2151,6 +2225,61 @@ static bool Control( input_thread_t *p_input,
             b_force_update = true;
             break;
 
+        case INPUT_CONTROL_ADD_VIEW:
+        {
+            input_view_t *p_view = val.p_address;
+            const int i_program = input_view_GetProgram( p_view );
+
+            for( int i = 0; i < p_input->p->i_view; i++ )
+            {
+                if( input_view_GetProgram( p_input->p->view[i] ) == i_program )
+                {
+                    msg_Err( p_input, "program %d is already viewed", i_program );
+                    input_view_Fail( p_view );
+                    input_view_Release( p_view );
+                    p_view = NULL;
+                    break;
+                }
+            }
+            if( !p_view )
+                break;
+
+            if( demux_Control( p_input->p->input.p_demux, DEMUX_SET_GROUP_OUTPUT,
+                               i_program, input_view_GetEsOut( p_view ) ) )
+            {
+                msg_Err( p_input, "program %d cannot be viewed apart", i_program );
+                input_view_Fail( p_view );
+                input_view_Release( p_view );
+                break;
+            }
+            TAB_APPEND( p_input->p->i_view, p_input->p->view, p_view );
+            break;
+        }
+
+        case INPUT_CONTROL_DEL_VIEW:
+        {
+            input_view_t *p_view = val.p_address;
+
+            for( int i = 0; i < p_input->p->i_view; i++ )
+            {
+                if( p_input->p->view[i] != p_view )
+                    continue;
+
+                demux_Control( p_input->p->input.p_demux, DEMUX_SET_GROUP_OUTPUT,
+                               input_view_GetProgram( p_view ), NULL );
+                TAB_REMOVE( p_input->p->i_view, p_input->p->view, p_view );
+                input_view_Release( p_view );
+                break;
+            }
+            input_view_Release( p_view );
+            break;
+        }
+
+        case INPUT_CONTROL_VIEW_FAILED:
+            msg_Err( p_input, "the viewed program cannot be played" );
+            input_ChangeState( p_input, ERROR_S );
+            break;
+
         case INPUT_CONTROL_SET_BOOKMARK:
         {
             seekpoint_t bookmark;
@@ -2462,8 +2591,22 @@ static int InputSourceInit( input_thread_t *p_input,
     }
     else
     {
+        /* Start from a pre-tuned standby input if we were given one */
+        input_standby_t *p_standby = NULL;
+        stream_t *p_standby_stream = NULL;
+
+        if( &p_input->p->input == in )
+            p_standby = var_GetAddress( p_input, "input-standby" );
+        if( p_standby )
+        {
+            var_SetAddress( p_input, "input-standby", NULL );
+            in->p_access = input_standby_Promote( p_standby, p_input,
+                                                  &p_standby_stream );
+        }
+
         /* Now try a real access */
-        in->p_access = access_New( p_input, p_input, psz_access, psz_demux, psz_path );
+        if( in->p_access == NULL )
+            in->p_access = access_New( p_input, p_input, psz_access, psz_demux, psz_path );
         if( in->p_access == NULL )
         {
             if( vlc_object_alive( p_input ) )
@@ -2546,7 +2689,10 @@ static int InputSourceInit( input_thread_t *p_input,
             TAB_APPEND( i_input_list, ppsz_input_list, NULL );
 
         /* Create the stream_t */
-        in->p_stream = stream_AccessNew( in->p_access, ppsz_input_list );
+        if( p_standby_stream )
+            in->p_stream = p_standby_stream;
+        else
+            in->p_stream = stream_AccessNew( in->p_access, ppsz_input_list );
         if( ppsz_input_list )
         {
             for( int i = 0; ppsz_input_list[i] != NULL; i++ )
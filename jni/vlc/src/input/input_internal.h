@@ -130,6 +130,9 @@ struct input_thread_private_t
     /* Slave sources (subs, and others) */
     int            i_slave;
     input_source_t **slave;
+    /* Views given a program of the main source */
+    int            i_view;
+    input_view_t   **view;
 
     /* Resources */
     input_resource_t *p_resource;
@@ -208,6 +211,10 @@ enum input_control_e
     INPUT_CONTROL_SET_RECORD_STATE,
 
     INPUT_CONTROL_SET_FRAME_NEXT,
+
+    INPUT_CONTROL_ADD_VIEW,
+    INPUT_CONTROL_DEL_VIEW,
+    INPUT_CONTROL_VIEW_FAILED,
 };
 
 /* Internal helpers */
@@ -239,6 +246,17 @@ void input_ControlVarTitle( input_thread_t *, int i_title );
 
 void input_ConfigVarInit ( input_thread_t * );
 
+/* standby.c */
+access_t *input_standby_Promote( input_standby_t *, input_thread_t *, stream_t ** );
+
+/* view.c */
+input_view_t *input_view_Hold( input_view_t * );
+int input_view_GetProgram( input_view_t * );
+es_out_t *input_view_GetEsOut( input_view_t * );
+void input_view_Attach( input_view_t *, input_thread_t * );
+void input_view_Detach( input_view_t * );
+void input_view_Fail( input_view_t * );
+
 /* Subtitles */
 char **subtitles_Detect( input_thread_t *, char* path, const char *fname );
 int subtitles_Filter( const char *);
@@ -35,11 +35,14 @@
 #include <vlc_spu.h>
 #include <vlc_aout.h>
 #include <vlc_sout.h>
+#include <vlc_codec.h>
 #include "../libvlc.h"
 #include "../stream_output/stream_output.h"
 #include "../audio_output/aout_internal.h"
 #include "../video_output/vout_control.h"
 #include "input_interface.h"
+#include "clock.h"
+#include "decoder.h"
 #include "resource.h"
 
 struct input_resource_t
@@ -73,6 +76,11 @@ struct input_resource_t
     /* TODO? track more than one audio output (like video outputs) */
     bool            b_aout_busy;
     aout_instance_t *p_aout;
+
+    /* Decoders left by the previous input (stopped, module still loaded) */
+    bool            b_keep_decoders;
+    decoder_t       *p_video_dec_free;
+    decoder_t       *p_audio_dec_free;
 };
 
 /* */
@@ -409,10 +417,51 @@ static void TerminateAout( input_resource_t *p_resource )
         vlc_object_release( p_aout );
 }
 
+/* */
+static decoder_t **GetDecoderSlot( input_resource_t *p_resource, int i_cat )
+{
+    if( i_cat == VIDEO_ES )
+        return &p_resource->p_video_dec_free;
+    if( i_cat == AUDIO_ES )
+        return &p_resource->p_audio_dec_free;
+    return NULL;
+}
+
+static bool IsDecoderSimilar( const decoder_t *p_dec, const es_format_t *p_fmt )
+{
+    if( !es_format_IsSimilar( &p_dec->fmt_in, p_fmt ) )
+        return false;
+
+    /* Without out of band headers, the decoder gets them from the stream */
+    if( p_fmt->i_extra > 0 &&
+        ( p_fmt->i_extra != p_dec->fmt_in.i_extra ||
+          memcmp( p_fmt->p_extra, p_dec->fmt_in.p_extra, p_fmt->i_extra ) ) )
+        return false;
+    return true;
+}
+
+static void TerminateDecoders( input_resource_t *p_resource )
+{
+    vlc_mutex_lock( &p_resource->lock );
+    decoder_t *p_video = p_resource->p_video_dec_free;
+    decoder_t *p_audio = p_resource->p_audio_dec_free;
+    p_resource->p_video_dec_free = NULL;
+    p_resource->p_audio_dec_free = NULL;
+    vlc_mutex_unlock( &p_resource->lock );
+
+    /* This gives their outputs back to us, so it cannot be done locked */
+    if( p_video )
+        input_DecoderDestroy( p_video );
+    if( p_audio )
+        input_DecoderDestroy( p_audio );
+}
+
 static void Destructor( gc_object_t *p_gc )
 {
     input_resource_t *p_resource = vlc_priv( p_gc, input_resource_t );
 
+    /* Kept decoders use us, input_resource_Terminate destroys them */
+    assert( !p_resource->p_video_dec_free && !p_resource->p_audio_dec_free );
     DestroySout( p_resource );
     DestroyVout( p_resource );
     DestroyAout( p_resource );
@@ -524,6 +573,50 @@ void input_resource_TerminateSout( input_resource_t *p_resource )
     input_resource_RequestSout( p_resource, NULL, NULL );
 }
 
+/* */
+void input_resource_SetKeepDecoders( input_resource_t *p_resource, bool b_keep )
+{
+    vlc_mutex_lock( &p_resource->lock );
+    p_resource->b_keep_decoders = b_keep;
+    vlc_mutex_unlock( &p_resource->lock );
+}
+bool input_resource_IsKeepingDecoders( input_resource_t *p_resource )
+{
+    vlc_mutex_lock( &p_resource->lock );
+    const bool b_keep = p_resource->b_keep_decoders;
+    vlc_mutex_unlock( &p_resource->lock );
+
+    return b_keep;
+}
+decoder_t *input_resource_PutDecoder( input_resource_t *p_resource,
+                                      decoder_t *p_dec )
+{
+    vlc_mutex_lock( &p_resource->lock );
+    decoder_t **pp_slot = GetDecoderSlot( p_resource, p_dec->fmt_in.i_cat );
+    assert( pp_slot != NULL );
+    decoder_t *p_old = *pp_slot;
+    *pp_slot = p_dec;
+    vlc_mutex_unlock( &p_resource->lock );
+
+    return p_old;
+}
+decoder_t *input_resource_GetDecoder( input_resource_t *p_resource,
+                                      const es_format_t *p_fmt )
+{
+    decoder_t *p_dec = NULL;
+
+    vlc_mutex_lock( &p_resource->lock );
+    decoder_t **pp_slot = GetDecoderSlot( p_resource, p_fmt->i_cat );
+    if( pp_slot && *pp_slot && IsDecoderSimilar( *pp_slot, p_fmt ) )
+    {
+        p_dec = *pp_slot;
+        *pp_slot = NULL;
+    }
+    vlc_mutex_unlock( &p_resource->lock );
+
+    return p_dec;
+}
+
 void input_resource_Terminate( input_resource_t *p_resource )
 {
     input_resource_TerminateSout( p_resource );
@@ -532,6 +625,8 @@ void input_resource_Terminate( input_resource_t *p_resource )
     TerminateAout( p_resource );
     vlc_mutex_unlock( &p_resource->lock );
 
+    TerminateDecoders( p_resource );
+
     input_resource_TerminateVout( p_resource );
 }
 
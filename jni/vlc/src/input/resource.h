@@ -67,6 +67,26 @@ vout_thread_t *input_resource_HoldVout( input_resource_t * );
  */
 void input_resource_HoldVouts( input_resource_t *, vout_thread_t ***, size_t * );
 
+/**
+ * This function tells if the decoders of a stopping input are to be kept
+ * (see input_resource_SetKeepDecoders).
+ */
+bool input_resource_IsKeepingDecoders( input_resource_t * );
+
+/**
+ * This function keeps a stopped decoder for the next input.
+ *
+ * It returns the decoder kept so far for the same category if any, that
+ * the caller must destroy with input_DecoderDestroy.
+ */
+decoder_t *input_resource_PutDecoder( input_resource_t *, decoder_t * );
+
+/**
+ * This function returns the kept decoder able to decode the given format,
+ * if any. The caller owns it from then on.
+ */
+decoder_t *input_resource_GetDecoder( input_resource_t *, const es_format_t * );
+
 /**
  * This function releases all resources (object).
  */
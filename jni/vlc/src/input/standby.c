@@ -0,0 +1,588 @@
+/*****************************************************************************
+ * standby.c: pre-tuned inputs kept connected in the background
+ *****************************************************************************
+ * Copyright (C) 2011 the VideoLAN team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_input.h>
+#include <vlc_access.h>
+#include <vlc_block.h>
+
+#include "access.h"
+#include "stream.h"
+#include "input_internal.h"
+
+/*
+ * A standby opens the access of an input item and keeps reading it without
+ * demuxing nor decoding anything. The transport stream is only inspected
+ * enough to remember the last PAT, the last PMT and every packet since the
+ * last random access point of the first video stream. When the standby is
+ * promoted, the input gets the already connected access and a stream that
+ * first returns PAT + PMT + cached GOP and then the live data.
+ */
+
+#define TS_PACKET_SIZE    188
+#define STANDBY_GOP_MAX   (4 * 1024 * 1024)
+#define STANDBY_CHUNK     (64 * 1024)
+/* How long a promotion waits for the reading thread before giving up on
+ * the (stalled) connection */
+#define STANDBY_STOP_WAIT (200000)
+
+struct input_standby_t
+{
+    VLC_COMMON_MEMBERS
+
+    char            *psz_mrl;
+
+    vlc_thread_t    thread;
+    vlc_mutex_t     lock;
+    vlc_cond_t      wait;
+    bool            b_stop;
+    bool            b_done;         /* the thread has returned */
+
+    access_t        *p_access;
+    stream_t        *p_stream;
+
+    /* Transport stream tracking */
+    int             i_pmt_pid;
+    int             i_video_pid;
+    bool            b_rap;          /* a random access point has been seen */
+    uint8_t         pat[TS_PACKET_SIZE];
+    bool            b_pat;
+    uint8_t         pmt[TS_PACKET_SIZE];
+    bool            b_pmt;
+
+    /* Packets since the last random access point (protected by lock) */
+    block_t         *p_gop;
+    block_t         *p_gop_last;
+    size_t          i_gop;
+};
+
+static void *Thread( void * );
+
+static void GopFlush( input_standby_t *p_sby )
+{
+    block_ChainRelease( p_sby->p_gop );
+    p_sby->p_gop = NULL;
+    p_sby->p_gop_last = NULL;
+    p_sby->i_gop = 0;
+}
+
+static void GopAppend( input_standby_t *p_sby, const uint8_t *p_pkt )
+{
+    block_t *p_last = p_sby->p_gop_last;
+
+    if( p_last == NULL ||
+        p_last->i_buffer + TS_PACKET_SIZE > STANDBY_CHUNK )
+    {
+        p_last = block_Alloc( STANDBY_CHUNK );
+        if( unlikely(p_last == NULL) )
+            return;
+        p_last->i_buffer = 0;
+        if( p_sby->p_gop_last )
+            p_sby->p_gop_last->p_next = p_last;
+        else
+            p_sby->p_gop = p_last;
+        p_sby->p_gop_last = p_last;
+    }
+    memcpy( &p_last->p_buffer[p_last->i_buffer], p_pkt, TS_PACKET_SIZE );
+    p_last->i_buffer += TS_PACKET_SIZE;
+    p_sby->i_gop += TS_PACKET_SIZE;
+}
+
+/* Returns the offset of the first section of a PSI packet, or -1 */
+static int PsiSection( const uint8_t *p_pkt )
+{
+    if( !(p_pkt[1] & 0x40) )
+        return -1;
+
+    int i_skip = 4;
+    if( p_pkt[3] & 0x20 )
+        i_skip += 1 + p_pkt[4];
+    if( i_skip >= TS_PACKET_SIZE )
+        return -1;
+    i_skip += 1 + p_pkt[i_skip]; /* pointer field */
+    if( i_skip + 8 > TS_PACKET_SIZE )
+        return -1;
+    return i_skip;
+}
+
+static void ParsePAT( input_standby_t *p_sby, const uint8_t *p_pkt )
+{
+    int i_sec = PsiSection( p_pkt );
+    if( i_sec < 0 || p_pkt[i_sec] != 0x00 )
+        return;
+
+    const uint8_t *p = &p_pkt[i_sec];
+    int i_length = ((p[1] & 0x0f) << 8) | p[2];
+    int i_end = __MIN( i_sec + 3 + i_length - 4, TS_PACKET_SIZE );
+
+    for( int i = i_sec + 8; i + 4 <= i_end; i += 4 )
+    {
+        int i_program = (p_pkt[i] << 8) | p_pkt[i+1];
+        if( i_program == 0 )
+            continue; /* NIT */
+        p_sby->i_pmt_pid = ((p_pkt[i+2] & 0x1f) << 8) | p_pkt[i+3];
+        break;
+    }
+    memcpy( p_sby->pat, p_pkt, TS_PACKET_SIZE );
+    p_sby->b_pat = true;
+}
+
+static void ParsePMT( input_standby_t *p_sby, const uint8_t *p_pkt )
+{
+    int i_sec = PsiSection( p_pkt );
+    if( i_sec < 0 || i_sec + 12 > TS_PACKET_SIZE || p_pkt[i_sec] != 0x02 )
+        return;
+
+    const uint8_t *p = &p_pkt[i_sec];
+    int i_length = ((p[1] & 0x0f) << 8) | p[2];
+    int i_end = __MIN( i_sec + 3 + i_length - 4, TS_PACKET_SIZE );
+    int i = i_sec + 12 + (((p[10] & 0x0f) << 8) | p[11]);
+
+    for( ; i + 5 <= i_end; i += 5 + (((p_pkt[i+3] & 0x0f) << 8) | p_pkt[i+4]) )
+    {
+        switch( p_pkt[i] )
+        {
+            case 0x01: /* MPEG-1 video */
+            case 0x02: /* MPEG-2 video */
+            case 0x10: /* MPEG-4 video */
+            case 0x1b: /* H.264 */
+            case 0xea: /* VC-1 */
+                p_sby->i_video_pid = ((p_pkt[i+1] & 0x1f) << 8) | p_pkt[i+2];
+                i = i_end;
+                break;
+            default:
+                break;
+        }
+    }
+    memcpy( p_sby->pmt, p_pkt, TS_PACKET_SIZE );
+    p_sby->b_pmt = true;
+}
+
+static void HandlePacket( input_standby_t *p_sby, const uint8_t *p_pkt )
+{
+    const int i_pid = ((p_pkt[1] & 0x1f) << 8) | p_pkt[2];
+
+    if( i_pid == 0 )
+    {
+        ParsePAT( p_sby, p_pkt );
+        return;
+    }
+    if( i_pid == p_sby->i_pmt_pid )
+    {
+        ParsePMT( p_sby, p_pkt );
+        return;
+    }
+
+    vlc_mutex_lock( &p_sby->lock );
+    if( i_pid == p_sby->i_video_pid &&
+        (p_pkt[3] & 0x20) && p_pkt[4] > 0 && (p_pkt[5] & 0x40) )
+    {
+        /* random_access_indicator: restart the cached GOP here */
+        GopFlush( p_sby );
+        p_sby->b_rap = true;
+    }
+    if( p_sby->b_rap )
+    {
+        if( p_sby->i_gop + TS_PACKET_SIZE > STANDBY_GOP_MAX )
+        {
+            /* Too long GOP, wait for the next random access point */
+            GopFlush( p_sby );
+            p_sby->b_rap = false;
+        }
+        else
+            GopAppend( p_sby, p_pkt );
+    }
+    vlc_mutex_unlock( &p_sby->lock );
+}
+
+static bool IsStopped( input_standby_t *p_sby )
+{
+    vlc_mutex_lock( &p_sby->lock );
+    bool b_stop = p_sby->b_stop;
+    vlc_mutex_unlock( &p_sby->lock );
+    return b_stop;
+}
+
+static void *Thread( void *data )
+{
+    input_standby_t *p_sby = data;
+    const char *psz_access, *psz_demux;
+    char *psz_path;
+    char *psz_dup = strdup( p_sby->psz_mrl );
+
+    int canc = vlc_savecancel();
+    if( unlikely(psz_dup == NULL) )
+        goto end;
+
+    input_SplitMRL( &psz_access, &psz_demux, &psz_path, psz_dup );
+    access_t *p_access = access_New( p_sby, NULL, psz_access, psz_demux, psz_path );
+    free( psz_dup );
+
+    /* If stopped meanwhile, the loop below does not read: a promotion can
+     * still use the access */
+    vlc_mutex_lock( &p_sby->lock );
+    p_sby->p_access = p_access;
+    vlc_mutex_unlock( &p_sby->lock );
+
+    if( p_access != NULL )
+        p_sby->p_stream = stream_AccessNew( p_access, NULL );
+
+    if( p_sby->p_stream == NULL )
+    {
+        msg_Warn( p_sby, "cannot open standby input `%s'", p_sby->psz_mrl );
+        goto end;
+    }
+
+    uint8_t pkt[TS_PACKET_SIZE];
+    while( !IsStopped( p_sby ) )
+    {
+        const uint8_t *p_peek;
+
+        if( stream_Peek( p_sby->p_stream, &p_peek, 1 ) < 1 )
+            break;
+        if( p_peek[0] != 0x47 )
+        {
+            /* Lost sync: skip one byte at a time until we find it again */
+            stream_Read( p_sby->p_stream, NULL, 1 );
+            continue;
+        }
+        if( stream_Read( p_sby->p_stream, pkt, TS_PACKET_SIZE ) < TS_PACKET_SIZE )
+            break;
+        HandlePacket( p_sby, pkt );
+    }
+    msg_Dbg( p_sby, "standby input `%s' stopped with %zu bytes cached",
+             p_sby->psz_mrl, p_sby->i_gop );
+end:
+    vlc_mutex_lock( &p_sby->lock );
+    p_sby->b_done = true;
+    vlc_cond_signal( &p_sby->wait );
+    vlc_mutex_unlock( &p_sby->lock );
+    vlc_restorecancel( canc );
+    return NULL;
+}
+
+#undef input_standby_New
+/**
+ * Creates a standby input for the given item and starts connecting it.
+ */
+input_standby_t *input_standby_New( vlc_object_t *p_parent, input_item_t *p_item )
+{
+    input_standby_t *p_sby = vlc_custom_create( p_parent, sizeof(*p_sby),
+                                                "standby" );
+    if( unlikely(p_sby == NULL) )
+        return NULL;
+
+    /* The access inherits the options of the item, as in an input */
+    vlc_mutex_lock( &p_item->lock );
+    assert( (int)p_item->optflagc == p_item->i_options );
+    for( int i = 0; i < p_item->i_options; i++ )
+        var_OptionParse( VLC_OBJECT(p_sby), p_item->ppsz_options[i],
+                         !!(p_item->optflagv[i] & VLC_INPUT_OPTION_TRUSTED) );
+    vlc_mutex_unlock( &p_item->lock );
+
+    p_sby->psz_mrl = input_item_GetURI( p_item );
+    vlc_mutex_init( &p_sby->lock );
+    vlc_cond_init( &p_sby->wait );
+    p_sby->b_stop = false;
+    p_sby->b_done = false;
+    p_sby->p_access = NULL;
+    p_sby->p_stream = NULL;
+    p_sby->i_pmt_pid = -1;
+    p_sby->i_video_pid = -1;
+    p_sby->b_rap = false;
+    p_sby->b_pat = false;
+    p_sby->b_pmt = false;
+    p_sby->p_gop = NULL;
+    p_sby->p_gop_last = NULL;
+    p_sby->i_gop = 0;
+
+    if( unlikely(p_sby->psz_mrl == NULL) ||
+        vlc_clone( &p_sby->thread, Thread, p_sby, VLC_THREAD_PRIORITY_LOW ) )
+    {
+        free( p_sby->psz_mrl );
+        vlc_cond_destroy( &p_sby->wait );
+        vlc_mutex_destroy( &p_sby->lock );
+        vlc_object_release( p_sby );
+        return NULL;
+    }
+    msg_Dbg( p_sby, "standby input `%s' started", p_sby->psz_mrl );
+    return p_sby;
+}
+
+/* Stops the thread. Unless b_abort, the access is only killed if the
+ * thread does not stop in time (stalled source). Returns true if the
+ * access was killed, it cannot be used anymore then. */
+static bool Stop( input_standby_t *p_sby, bool b_abort )
+{
+    const mtime_t i_deadline = mdate() + STANDBY_STOP_WAIT;
+
+    vlc_mutex_lock( &p_sby->lock );
+    p_sby->b_stop = true;
+    /* The thread checks b_stop between two packets */
+    while( !b_abort && !p_sby->b_done )
+    {
+        if( vlc_cond_timedwait( &p_sby->wait, &p_sby->lock, i_deadline ) )
+            break;
+    }
+    const bool b_kill = !p_sby->b_done;
+    if( b_kill && p_sby->p_access )
+        vlc_object_kill( p_sby->p_access );
+    vlc_mutex_unlock( &p_sby->lock );
+
+    vlc_join( p_sby->thread, NULL );
+    return b_kill;
+}
+
+static void Destroy( input_standby_t *p_sby )
+{
+    GopFlush( p_sby );
+    vlc_cond_destroy( &p_sby->wait );
+    vlc_mutex_destroy( &p_sby->lock );
+    free( p_sby->psz_mrl );
+    vlc_object_release( p_sby );
+}
+
+/**
+ * Stops and destroys a standby input that has not been promoted.
+ */
+void input_standby_Delete( input_standby_t *p_sby )
+{
+    Stop( p_sby, true );
+
+    if( p_sby->p_stream )
+        stream_Delete( p_sby->p_stream );
+    if( p_sby->p_access )
+        access_Delete( p_sby->p_access );
+    Destroy( p_sby );
+}
+
+/**
+ * Returns the MRL a standby input was created for.
+ */
+const char *input_standby_GetMRL( input_standby_t *p_sby )
+{
+    return p_sby->psz_mrl;
+}
+
+/*****************************************************************************
+ * Prefix stream: returns the cached packets then the live data
+ *****************************************************************************/
+struct stream_sys_t
+{
+    uint8_t  *p_prefix;
+    size_t   i_prefix;
+    size_t   i_pos;
+
+    uint8_t  *p_peek;
+    size_t   i_peek;
+};
+
+static int PrefixRead( stream_t *s, void *p_read, unsigned int i_read )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    unsigned int i_copy = __MIN( i_read, p_sys->i_prefix - p_sys->i_pos );
+
+    if( p_read && i_copy > 0 )
+        memcpy( p_read, &p_sys->p_prefix[p_sys->i_pos], i_copy );
+    p_sys->i_pos += i_copy;
+
+    if( i_copy == i_read )
+        return i_copy;
+
+    int i_ret = stream_Read( s->p_source,
+                             p_read ? (uint8_t *)p_read + i_copy : NULL,
+                             i_read - i_copy );
+    return i_ret < 0 ? (int)i_copy : (int)i_copy + i_ret;
+}
+
+static int PrefixPeek( stream_t *s, const uint8_t **pp_peek, unsigned int i_peek )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    size_t i_left = p_sys->i_prefix - p_sys->i_pos;
+
+    if( i_left == 0 )
+        return stream_Peek( s->p_source, pp_peek, i_peek );
+    if( i_peek <= i_left )
+    {
+        *pp_peek = &p_sys->p_prefix[p_sys->i_pos];
+        return i_peek;
+    }
+
+    /* The peek crosses the end of the prefix */
+    const uint8_t *p_src;
+    int i_src = stream_Peek( s->p_source, &p_src, i_peek - i_left );
+    if( i_src < 0 )
+        i_src = 0;
+    if( p_sys->i_peek < i_left + i_src )
+    {
+        uint8_t *p = realloc( p_sys->p_peek, i_left + i_src );
+        if( unlikely(p == NULL) )
+            return -1;
+        p_sys->p_peek = p;
+        p_sys->i_peek = i_left + i_src;
+    }
+    memcpy( p_sys->p_peek, &p_sys->p_prefix[p_sys->i_pos], i_left );
+    memcpy( &p_sys->p_peek[i_left], p_src, i_src );
+    *pp_peek = p_sys->p_peek;
+    return i_left + i_src;
+}
+
+static int PrefixControl( stream_t *s, int i_query, va_list args )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    switch( i_query )
+    {
+        case STREAM_GET_POSITION:
+        {
+            uint64_t *pi_64 = va_arg( args, uint64_t * );
+            uint64_t i_pos;
+
+            stream_Control( s->p_source, STREAM_GET_POSITION, &i_pos );
+            *pi_64 = i_pos - (p_sys->i_prefix - p_sys->i_pos);
+            return VLC_SUCCESS;
+        }
+        case STREAM_SET_POSITION:
+            /* Seeking drops whatever is left of the cache */
+            p_sys->i_pos = p_sys->i_prefix;
+            /* fall through */
+        default:
+            return stream_vaControl( s->p_source, i_query, args );
+    }
+}
+
+static void PrefixDelete( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    stream_Delete( s->p_source );
+    free( p_sys->p_prefix );
+    free( p_sys->p_peek );
+    free( p_sys );
+    stream_CommonDelete( s );
+}
+
+/**
+ * Promotes a standby input into p_input.
+ *
+ * The standby is consumed whatever happens. On success, the connected
+ * access is returned and *pp_stream is set to the stream the demuxer must
+ * use; both belong to the caller. NULL is returned if the standby could not
+ * connect, the input must then open the access itself.
+ */
+access_t *input_standby_Promote( input_standby_t *p_sby, input_thread_t *p_input,
+                                 stream_t **pp_stream )
+{
+    const bool b_killed = Stop( p_sby, false );
+
+    access_t *p_access = p_sby->p_access;
+    stream_t *p_source = p_sby->p_stream;
+    stream_t *s = NULL;
+    stream_sys_t *p_sys = NULL;
+
+    if( b_killed )
+        msg_Warn( p_input, "standby input `%s' stalled", p_sby->psz_mrl );
+    if( p_source == NULL || b_killed )
+        goto error;
+
+    /* Move the access, and its stream, under the input: they are killed
+     * with it and inherit its variables from now on */
+    vlc_object_reparent( p_access, p_input );
+    if( !vlc_object_alive( p_input ) )
+        goto error; /* killed before the access was its child */
+
+    s = stream_CommonNew( VLC_OBJECT(p_input) );
+    p_sys = calloc( 1, sizeof(*p_sys) );
+    if( unlikely(s == NULL || p_sys == NULL) )
+        goto error;
+
+    /* PAT + PMT + cached GOP, flattened once at zap time */
+    size_t i_prefix = p_sby->i_gop;
+    if( i_prefix > 0 )
+        i_prefix += (p_sby->b_pat + p_sby->b_pmt) * TS_PACKET_SIZE;
+    if( i_prefix > 0 )
+    {
+        p_sys->p_prefix = malloc( i_prefix );
+        if( unlikely(p_sys->p_prefix == NULL) )
+            goto error;
+
+        uint8_t *p = p_sys->p_prefix;
+        if( p_sby->b_pat )
+        {
+            memcpy( p, p_sby->pat, TS_PACKET_SIZE );
+            p += TS_PACKET_SIZE;
+        }
+        if( p_sby->b_pmt )
+        {
+            memcpy( p, p_sby->pmt, TS_PACKET_SIZE );
+            p += TS_PACKET_SIZE;
+        }
+        for( block_t *b = p_sby->p_gop; b != NULL; b = b->p_next )
+        {
+            memcpy( p, b->p_buffer, b->i_buffer );
+            p += b->i_buffer;
+        }
+    }
+    p_sys->i_prefix = i_prefix;
+
+    s->psz_access = strdup( p_source->psz_access );
+    s->psz_path = strdup( p_source->psz_path );
+    if( unlikely(s->psz_path == NULL) )
+        goto error;
+    s->p_source = p_source;
+    s->p_sys = p_sys;
+    s->pf_read = PrefixRead;
+    s->pf_peek = PrefixPeek;
+    s->pf_control = PrefixControl;
+    s->pf_destroy = PrefixDelete;
+
+    /* Hand the objects over to the input */
+    p_access->p_input = p_input;
+    p_source->p_input = p_input;
+    s->p_input = p_input;
+
+    msg_Dbg( p_input, "promoted standby input `%s' with %zu bytes cached",
+             p_sby->psz_mrl, i_prefix );
+    *pp_stream = s;
+    Destroy( p_sby );
+    return p_access;
+
+error:
+    if( p_sys )
+        free( p_sys->p_prefix );
+    free( p_sys );
+    if( s )
+        stream_CommonDelete( s );
+    if( p_source )
+        stream_Delete( p_source );
+    if( p_access )
+        access_Delete( p_access );
+    Destroy( p_sby );
+    return NULL;
+}
@@ -31,6 +31,7 @@
 #include <vlc_common.h>
 #include <vlc_strings.h>
 #include <vlc_memory.h>
+#include <vlc_atomic.h>
 
 #include <libvlc.h>
 
@@ -42,31 +43,26 @@
 // #define STREAM_DEBUG 1
 
 /* TODO:
- *  - tune the 2 methods (block/stream)
  *  - compute cost for seek
- *  - improve stream mode seeking with closest segments
  *  - ...
  */
 
-/* Two methods:
+/* Two ways to fill the cache:
  *  - using pf_block
- *      One linked list of data read
+ *      The blocks of the access are put in the cache as is.
  *  - using pf_read
- *      More complex scheme using mutliple track to avoid seeking
+ *      The data are read directly into new cache segments.
  *  - using directly the access (only indirection for peeking).
  *      This method is known to introduce much less latency.
- *      It should probably defaulted (instead of the stream method (2)).
+ *      It should probably defaulted (instead of the cache).
  */
 
-/* How many tracks we have, currently only used for stream mode */
 #ifdef OPTIMIZE_MEMORY
-#   define STREAM_CACHE_TRACK 1
-    /* Max size of our cache 128Ko per track */
-#   define STREAM_CACHE_SIZE  (STREAM_CACHE_TRACK*1024*128)
+    /* Max size of our cache 128Ko */
+#   define STREAM_CACHE_SIZE  (1024*128)
 #else
-#   define STREAM_CACHE_TRACK 3
-    /* Max size of our cache 4Mo per track */
-#   define STREAM_CACHE_SIZE  (4*STREAM_CACHE_TRACK*1024*1024)
+    /* Max size of our cache 12Mo */
+#   define STREAM_CACHE_SIZE  (12*1024*1024)
 #endif
 
 /* How many data we try to prebuffer
@@ -74,37 +70,46 @@
  * efficient demux probing */
 #define STREAM_CACHE_PREBUFFER_SIZE (128)
 
-/* Method1: Simple, for pf_block.
- *  We get blocks and put them in the linked list.
- *  We release blocks once the total size is bigger than CACHE_BLOCK_SIZE
- */
-
-/* Method2: A bit more complex, for pf_read
- *  - We use ring buffers, only one if unseekable, all if seekable
- *  - Upon seek date current ring, then search if one ring match the pos,
- *      yes: switch to it, seek the access to match the end of the ring
- *      no: search the ring with i_end the closer to i_pos,
- *          if close enough, read data and use this ring
- *          else use the oldest ring, seek and use it.
+/* The cache is one linked list of data read, the segments.
+ *  We release segments once the total size is bigger than STREAM_CACHE_SIZE.
  *
- *  TODO: - with access non seekable: use all space available for only one ring, but
- *          we have to support seekable/non-seekable switch on the fly.
- *        - compute a good value for i_read_size
- *        - ?
+ *  Segments are reference counted: stream_Block() returns blocks pointing
+ *  into them instead of copying the data, and stream_Peek() only copies
+ *  when the peeked data span several segments.
+ *  As the owner of such a block may modify it, the segments handed out that
+ *  way are never served again from the cache: a seek back into them goes
+ *  to the access. Non seekable accesses cannot do that, so their data are
+ *  always copied (see b_lend).
+ */
+/* Size of the segments read from a pf_read access: we start with
+ * STREAM_READ_ATONCE, then read about STREAM_READ_PERIOD worth of data at
+ * the measured access throughput */
+#define STREAM_READ_ATONCE (32*1024)
+#define STREAM_READ_MIN    (4*1024)
+#define STREAM_READ_MAX    (STREAM_CACHE_SIZE/16)
+#define STREAM_READ_PERIOD (CLOCK_FREQ/20)
+
+/* Prefetch mode:
+ *  A thread reads the access ahead into a queue of segments, up to
+ *  "stream-prefetch-buffer-size", and the cache is refilled from that queue.
+ *  The thread owns the access while reading; any other use of the access
+ *  must hold prefetch.access_lock and flush the queue if it moves the access.
  */
-#define STREAM_READ_ATONCE 1024
-#define STREAM_CACHE_TRACK_SIZE (STREAM_CACHE_SIZE/STREAM_CACHE_TRACK)
 
 typedef struct
 {
-    int64_t i_date;
-
-    uint64_t i_start;
-    uint64_t i_end;
+    block_t      self;
+    block_t     *p_data;    /* Block of the access, NULL for inline data */
+    vlc_atomic_t refs;
+    bool         b_lent;    /* Part of it was handed out by SegmentSlice */
+    uint8_t      p_inline[];
+} stream_segment_t;
 
-    uint8_t *p_buffer;
-
-} stream_track_t;
+typedef struct
+{
+    block_t           self;
+    stream_segment_t *p_segment;
+} stream_slice_t;
 
 typedef struct
 {
@@ -127,7 +132,7 @@ struct stream_sys_t
 
     uint64_t     i_pos;      /* Current reading offset */
 
-    /* Method 1: pf_block */
+    /* Cache, filled using pf_block or pf_read */
     struct
     {
         uint64_t i_start;        /* Offset of block for p_first */
@@ -138,23 +143,34 @@ struct stream_sys_t
         block_t *p_first;
         block_t **pp_last;
 
+        bool     b_lend;         /* AStreamBlock may hand out segments */
     } block;
 
-    /* Method 2: for pf_read */
+    /* Read size for pf_read, adapted to the access throughput */
     struct
     {
-        unsigned i_offset;   /* Buffer offset in the current track */
-        int      i_tk;       /* Current track */
-        stream_track_t tk[STREAM_CACHE_TRACK];
+        unsigned i_size;
+        uint64_t i_byterate;     /* Average throughput in bytes/s */
+        mtime_t  i_date;         /* Date of the previous read */
+    } read;
 
-        /* Global buffer */
-        uint8_t *p_buffer;
-
-        /* */
-        unsigned i_used; /* Used since last read */
-        unsigned i_read_size;
-
-    } stream;
+    /* Prefetch thread */
+    struct
+    {
+        bool         b_enabled;
+        vlc_thread_t thread;
+        vlc_mutex_t  access_lock;
+        vlc_mutex_t  lock;
+        vlc_cond_t   wait_data;  /* Data fetched or EOF */
+        vlc_cond_t   wait_space; /* Data taken or flushed */
+        bool         b_exit;
+        bool         b_eof;
+
+        uint64_t     i_budget;
+        uint64_t     i_size;     /* Total amount of data in the queue */
+        block_t     *p_first;
+        block_t    **pp_last;
+    } prefetch;
 
     /* Peek temporary buffer */
     unsigned int i_peek;
@@ -183,18 +199,18 @@ struct stream_sys_t
     access_t       *p_list_access;
 };
 
-/* Method 1: */
 static int  AStreamReadBlock( stream_t *s, void *p_read, unsigned int i_read );
 static int  AStreamPeekBlock( stream_t *s, const uint8_t **p_peek, unsigned int i_read );
+static block_t *AStreamBlock( stream_t *s, unsigned int i_size );
 static int  AStreamSeekBlock( stream_t *s, uint64_t i_pos );
 static void AStreamPrebufferBlock( stream_t *s );
+static void AStreamResetBlock( stream_t *s );
+static block_t *AStreamFetch( stream_t *s, bool *pb_eof );
+static block_t *AStreamFill( stream_t *s, bool *pb_eof );
+static void *AStreamPrefetchThread( void * );
+static void AStreamPrefetchFlush( stream_t *s );
+static void AStreamPrefetchClean( stream_t *s );
 static block_t *AReadBlock( stream_t *s, bool *pb_eof );
-
-/* Method 2 */
-static int  AStreamReadStream( stream_t *s, void *p_read, unsigned int i_read );
-static int  AStreamPeekStream( stream_t *s, const uint8_t **pp_peek, unsigned int i_read );
-static int  AStreamSeekStream( stream_t *s, uint64_t i_pos );
-static void AStreamPrebufferStream( stream_t *s );
 static int  AReadStream( stream_t *s, void *p_read, unsigned int i_read );
 
 /* Common */
@@ -213,6 +229,8 @@ stream_t *stream_CommonNew( vlc_object_t *p_obj )
     if( !s )
         return NULL;
 
+    s->pf_block = NULL;
+
     s->p_text = malloc( sizeof(*s->p_text) );
     if( !s->p_text )
     {
@@ -308,6 +326,26 @@ stream_t *stream_AccessNew( access_t *p_access, char **ppsz_list )
         p_sys->method = STREAM_METHOD_STREAM;
 
     p_sys->i_pos = p_access->info.i_pos;
+    p_sys->block.p_first = NULL;
+
+    p_sys->read.i_size = STREAM_READ_ATONCE;
+    p_sys->read.i_byterate = 0;
+    p_sys->read.i_date = 0;
+
+    /* Prefetch (the thread is started before prebuffering) */
+    p_sys->prefetch.b_enabled = false;
+    vlc_mutex_init( &p_sys->prefetch.access_lock );
+    vlc_mutex_init( &p_sys->prefetch.lock );
+    vlc_cond_init( &p_sys->prefetch.wait_data );
+    vlc_cond_init( &p_sys->prefetch.wait_space );
+    p_sys->prefetch.b_exit = false;
+    p_sys->prefetch.b_eof = false;
+    p_sys->prefetch.i_budget =
+        (uint64_t)__MAX( var_InheritInteger( s, "stream-prefetch-buffer-size" ),
+                         1 ) * 1024;
+    p_sys->prefetch.i_size = 0;
+    p_sys->prefetch.p_first = NULL;
+    p_sys->prefetch.pp_last = &p_sys->prefetch.p_first;
 
     /* Stats */
     access_Control( p_access, ACCESS_CAN_FASTSEEK, &p_sys->stat.b_fastseek );
@@ -370,82 +408,39 @@ stream_t *stream_AccessNew( access_t *p_access, char **ppsz_list )
     p_sys->i_peek = 0;
     p_sys->p_peek = NULL;
 
-    if( p_sys->method == STREAM_METHOD_BLOCK )
-    {
-        msg_Dbg( s, "Using block method for AStream*" );
-        s->pf_read = AStreamReadBlock;
-        s->pf_peek = AStreamPeekBlock;
-
-        /* Init all fields of p_sys->block */
-        p_sys->block.i_start = p_sys->i_pos;
-        p_sys->block.i_offset = 0;
-        p_sys->block.p_current = NULL;
-        p_sys->block.i_size = 0;
-        p_sys->block.p_first = NULL;
-        p_sys->block.pp_last = &p_sys->block.p_first;
+    msg_Dbg( s, "Using %s method for AStream*",
+             p_sys->method == STREAM_METHOD_BLOCK ? "block" : "stream" );
+    s->pf_read = AStreamReadBlock;
+    s->pf_peek = AStreamPeekBlock;
+    s->pf_block = AStreamBlock;
 
-        /* Do the prebuffering */
-        AStreamPrebufferBlock( s );
+    /* Init all fields of p_sys->block */
+    AStreamResetBlock( s );
+    access_Control( p_access, ACCESS_CAN_SEEK, &p_sys->block.b_lend );
 
-        if( p_sys->block.i_size <= 0 )
-        {
-            msg_Err( s, "cannot pre fill buffer" );
-            goto error;
-        }
-    }
-    else
+    if( var_InheritBool( s, "stream-prefetch" ) )
     {
-        int i;
-
-        assert( p_sys->method == STREAM_METHOD_STREAM );
-
-        msg_Dbg( s, "Using stream method for AStream*" );
-
-        s->pf_read = AStreamReadStream;
-        s->pf_peek = AStreamPeekStream;
-
-        /* Allocate/Setup our tracks */
-        p_sys->stream.i_offset = 0;
-        p_sys->stream.i_tk     = 0;
-        p_sys->stream.p_buffer = malloc( STREAM_CACHE_SIZE );
-        if( p_sys->stream.p_buffer == NULL )
-            goto error;
-        p_sys->stream.i_used   = 0;
-        p_sys->stream.i_read_size = STREAM_READ_ATONCE;
-#if STREAM_READ_ATONCE < 256
-#   error "Invalid STREAM_READ_ATONCE value"
-#endif
-
-        for( i = 0; i < STREAM_CACHE_TRACK; i++ )
-        {
-            p_sys->stream.tk[i].i_date  = 0;
-            p_sys->stream.tk[i].i_start = p_sys->i_pos;
-            p_sys->stream.tk[i].i_end   = p_sys->i_pos;
-            p_sys->stream.tk[i].p_buffer=
-                &p_sys->stream.p_buffer[i * STREAM_CACHE_TRACK_SIZE];
-        }
+        if( vlc_clone( &p_sys->prefetch.thread, AStreamPrefetchThread, s,
+                       VLC_THREAD_PRIORITY_INPUT ) )
+            msg_Err( s, "cannot start prefetch thread" );
+        else
+            p_sys->prefetch.b_enabled = true;
+    }
 
-        /* Do the prebuffering */
-        AStreamPrebufferStream( s );
+    /* Do the prebuffering */
+    AStreamPrebufferBlock( s );
 
-        if( p_sys->stream.tk[p_sys->stream.i_tk].i_end <= 0 )
-        {
-            msg_Err( s, "cannot pre fill buffer" );
-            goto error;
-        }
+    if( p_sys->block.i_size <= 0 )
+    {
+        msg_Err( s, "cannot pre fill buffer" );
+        goto error;
     }
 
     return s;
 
 error:
-    if( p_sys->method == STREAM_METHOD_BLOCK )
-    {
-        /* Nothing yet */
-    }
-    else
-    {
-        free( p_sys->stream.p_buffer );
-    }
+    AStreamPrefetchClean( s );
+    block_ChainRelease( p_sys->block.p_first );
     while( p_sys->i_list > 0 )
         free( p_sys->list[--(p_sys->i_list)] );
     free( p_sys->list );
@@ -461,11 +456,8 @@ static void AStreamDestroy( stream_t *s )
 {
     stream_sys_t *p_sys = s->p_sys;
 
-    if( p_sys->method == STREAM_METHOD_BLOCK )
-        block_ChainRelease( p_sys->block.p_first );
-    else
-        free( p_sys->stream.p_buffer );
-
+    AStreamPrefetchClean( s );
+    block_ChainRelease( p_sys->block.p_first );
     free( p_sys->p_peek );
 
     if( p_sys->p_list_access && p_sys->p_list_access != p_sys->p_access )
@@ -497,44 +489,12 @@ static void AStreamControlReset( stream_t *s )
 {
     stream_sys_t *p_sys = s->p_sys;
 
+    /* The access has been moved: drop all the data read so far */
+    vlc_assert_locked( &p_sys->prefetch.access_lock );
     p_sys->i_pos = p_sys->p_access->info.i_pos;
 
-    if( p_sys->method == STREAM_METHOD_BLOCK )
-    {
-        block_ChainRelease( p_sys->block.p_first );
-
-        /* Init all fields of p_sys->block */
-        p_sys->block.i_start = p_sys->i_pos;
-        p_sys->block.i_offset = 0;
-        p_sys->block.p_current = NULL;
-        p_sys->block.i_size = 0;
-        p_sys->block.p_first = NULL;
-        p_sys->block.pp_last = &p_sys->block.p_first;
-
-        /* Do the prebuffering */
-        AStreamPrebufferBlock( s );
-    }
-    else
-    {
-        int i;
-
-        assert( p_sys->method == STREAM_METHOD_STREAM );
-
-        /* Setup our tracks */
-        p_sys->stream.i_offset = 0;
-        p_sys->stream.i_tk     = 0;
-        p_sys->stream.i_used   = 0;
-
-        for( i = 0; i < STREAM_CACHE_TRACK; i++ )
-        {
-            p_sys->stream.tk[i].i_date  = 0;
-            p_sys->stream.tk[i].i_start = p_sys->i_pos;
-            p_sys->stream.tk[i].i_end   = p_sys->i_pos;
-        }
-
-        /* Do the prebuffering */
-        AStreamPrebufferStream( s );
-    }
+    AStreamPrefetchFlush( s );
+    AStreamResetBlock( s );
 }
 
 /****************************************************************************
@@ -600,16 +560,7 @@ static int AStreamControl( stream_t *s, int i_query, va_list args )
 
         case STREAM_SET_POSITION:
             i_64 = va_arg( args, uint64_t );
-            switch( p_sys->method )
-            {
-            case STREAM_METHOD_BLOCK:
-                return AStreamSeekBlock( s, i_64 );
-            case STREAM_METHOD_STREAM:
-                return AStreamSeekStream( s, i_64 );
-            default:
-                assert(0);
-                return VLC_EGENERIC;
-            }
+            return AStreamSeekBlock( s, i_64 );
 
         case STREAM_CONTROL_ACCESS:
         {
@@ -624,19 +575,36 @@ static int AStreamControl( stream_t *s, int i_query, va_list args )
                             "DON'T USE STREAM_CONTROL_ACCESS !!!" );
                 return VLC_EGENERIC;
             }
+            const bool b_reset = i_int == ACCESS_SET_TITLE ||
+                                 i_int == ACCESS_SET_SEEKPOINT;
+
+            vlc_mutex_lock( &p_sys->prefetch.access_lock );
             int i_ret = access_vaControl( p_access, i_int, args );
-            if( i_int == ACCESS_SET_TITLE || i_int == ACCESS_SET_SEEKPOINT )
+            if( b_reset )
                 AStreamControlReset( s );
+            vlc_mutex_unlock( &p_sys->prefetch.access_lock );
+
+            /* Prebuffer again (outside of the lock, the prefetch thread
+             * may be the one filling the cache) */
+            if( b_reset )
+                AStreamPrebufferBlock( s );
             return i_ret;
         }
 
         case STREAM_UPDATE_SIZE:
+            vlc_mutex_lock( &p_sys->prefetch.access_lock );
             AStreamControlUpdate( s );
+            vlc_mutex_unlock( &p_sys->prefetch.access_lock );
             return VLC_SUCCESS;
 
         case STREAM_GET_CONTENT_TYPE:
-            return access_Control( p_access, ACCESS_GET_CONTENT_TYPE,
-                                    va_arg( args, char ** ) );
+        {
+            vlc_mutex_lock( &p_sys->prefetch.access_lock );
+            int i_ret = access_Control( p_access, ACCESS_GET_CONTENT_TYPE,
+                                        va_arg( args, char ** ) );
+            vlc_mutex_unlock( &p_sys->prefetch.access_lock );
+            return i_ret;
+        }
         case STREAM_SET_RECORD_STATE:
         default:
             msg_Err( s, "invalid stream_vaControl query=0x%x", i_query );
@@ -646,8 +614,285 @@ static int AStreamControl( stream_t *s, int i_query, va_list args )
 }
 
 /****************************************************************************
- * Method 1:
+ * Cache segments:
+ ****************************************************************************/
+static void SegmentRelease( block_t *p_block )
+{
+    stream_segment_t *p_seg = (stream_segment_t *)p_block;
+
+    if( vlc_atomic_dec( &p_seg->refs ) > 0 )
+        return;
+
+    if( p_seg->p_data )
+        block_Release( p_seg->p_data );
+    free( p_seg );
+}
+
+static block_t *SegmentWrap( block_t *p_data )
+{
+    stream_segment_t *p_seg = malloc( sizeof(*p_seg) );
+    if( unlikely(p_seg == NULL) )
+    {
+        block_Release( p_data );
+        return NULL;
+    }
+
+    block_Init( &p_seg->self, p_data->p_buffer, p_data->i_buffer );
+    p_seg->self.pf_release = SegmentRelease;
+    p_seg->p_data = p_data;
+    vlc_atomic_set( &p_seg->refs, 1 );
+    p_seg->b_lent = false;
+    return &p_seg->self;
+}
+
+/* Adapts the read size to the throughput seen between two reads, which
+ * includes the time spent waiting for the access */
+static void SegmentAdaptReadSize( stream_t *s, unsigned i_read, mtime_t i_date )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    const mtime_t i_last = p_sys->read.i_date;
+
+    p_sys->read.i_date = i_date;
+    if( i_last <= 0 || i_date <= i_last )
+        return;
+
+    const uint64_t i_rate = (uint64_t)i_read * CLOCK_FREQ / (i_date - i_last);
+    if( p_sys->read.i_byterate == 0 )
+        p_sys->read.i_byterate = i_rate;
+    else
+        p_sys->read.i_byterate = ( 7 * p_sys->read.i_byterate + i_rate ) / 8;
+
+    uint64_t i_size = p_sys->read.i_byterate * STREAM_READ_PERIOD / CLOCK_FREQ;
+    i_size = __MAX( __MIN( i_size, STREAM_READ_MAX ), STREAM_READ_MIN );
+    p_sys->read.i_size = ( i_size + STREAM_READ_MIN - 1 ) & ~(STREAM_READ_MIN - 1);
+}
+
+static block_t *SegmentRead( stream_t *s, bool *pb_eof )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    const unsigned i_size = p_sys->read.i_size;
+
+    stream_segment_t *p_seg = malloc( sizeof(*p_seg) + i_size );
+    if( unlikely(p_seg == NULL) )
+    {
+        *pb_eof = true;
+        return NULL;
+    }
+
+    int i_read = AReadStream( s, p_seg->p_inline, i_size );
+    *pb_eof = i_read == 0;
+    if( i_read <= 0 )
+    {
+        free( p_seg );
+        return NULL;
+    }
+    SegmentAdaptReadSize( s, i_read, mdate() );
+
+    /* Give back the unused space of short reads */
+    if( (unsigned)i_read < i_size )
+    {
+        stream_segment_t *p_realloc = realloc( p_seg, sizeof(*p_seg) + i_read );
+        if( p_realloc != NULL )
+            p_seg = p_realloc;
+    }
+
+    block_Init( &p_seg->self, p_seg->p_inline, i_read );
+    p_seg->self.pf_release = SegmentRelease;
+    p_seg->p_data = NULL;
+    vlc_atomic_set( &p_seg->refs, 1 );
+    p_seg->b_lent = false;
+    return &p_seg->self;
+}
+
+static void SliceRelease( block_t *p_block )
+{
+    stream_slice_t *p_slice = (stream_slice_t *)p_block;
+
+    SegmentRelease( &p_slice->p_segment->self );
+    free( p_slice );
+}
+
+/* Returns a block pointing to i_size bytes of a segment, without copy */
+static block_t *SegmentSlice( block_t *p_block, size_t i_offset, size_t i_size )
+{
+    stream_segment_t *p_seg = (stream_segment_t *)p_block;
+    stream_slice_t *p_slice = malloc( sizeof(*p_slice) );
+
+    if( unlikely(p_slice == NULL) )
+        return NULL;
+
+    block_Init( &p_slice->self, &p_block->p_buffer[i_offset], i_size );
+    p_slice->self.pf_release = SliceRelease;
+    p_slice->p_segment = p_seg;
+    vlc_atomic_inc( &p_seg->refs );
+    p_seg->b_lent = true;
+    return &p_slice->self;
+}
+
+/* Gets the next segment(s) from the access */
+static block_t *AStreamFetch( stream_t *s, bool *pb_eof )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    /* The accesses of a concatenated list may each use another method */
+    access_t *p_access = p_sys->i_list ? p_sys->p_list_access
+                                       : p_sys->p_access;
+    if( p_access->pf_block == NULL )
+        return SegmentRead( s, pb_eof );
+
+    block_t *p_data = AReadBlock( s, pb_eof );
+    block_t *p_first = NULL;
+    block_t **pp_last = &p_first;
+
+    while( p_data )
+    {
+        block_t *p_next = p_data->p_next;
+        block_t *p_seg;
+
+        p_data->p_next = NULL;
+        p_seg = SegmentWrap( p_data );
+        if( p_seg )
+        {
+            *pp_last = p_seg;
+            pp_last = &p_seg->p_next;
+        }
+        p_data = p_next;
+    }
+    return p_first;
+}
+
+/****************************************************************************
+ * Prefetch:
  ****************************************************************************/
+static void *AStreamPrefetchThread( void *data )
+{
+    stream_t *s = data;
+    stream_sys_t *p_sys = s->p_sys;
+    int canc = vlc_savecancel();
+
+    vlc_mutex_lock( &p_sys->prefetch.lock );
+    for( ;; )
+    {
+        while( !p_sys->prefetch.b_exit &&
+               ( p_sys->prefetch.b_eof ||
+                 p_sys->prefetch.i_size >= p_sys->prefetch.i_budget ) )
+            vlc_cond_wait( &p_sys->prefetch.wait_space, &p_sys->prefetch.lock );
+        if( p_sys->prefetch.b_exit )
+            break;
+        vlc_mutex_unlock( &p_sys->prefetch.lock );
+
+        bool b_eof;
+        block_t *b;
+
+        vlc_mutex_lock( &p_sys->prefetch.access_lock );
+        b = AStreamFetch( s, &b_eof );
+
+        /* Queue the data before releasing the access: a seek flushes the
+         * queue after moving the access */
+        vlc_mutex_lock( &p_sys->prefetch.lock );
+        vlc_mutex_unlock( &p_sys->prefetch.access_lock );
+
+        while( b )
+        {
+            p_sys->prefetch.i_size += b->i_buffer;
+            *p_sys->prefetch.pp_last = b;
+            p_sys->prefetch.pp_last = &b->p_next;
+            b = b->p_next;
+        }
+        if( b_eof || !vlc_object_alive( s ) )
+            p_sys->prefetch.b_eof = true;
+        vlc_cond_signal( &p_sys->prefetch.wait_data );
+    }
+    vlc_mutex_unlock( &p_sys->prefetch.lock );
+
+    vlc_restorecancel( canc );
+    return NULL;
+}
+
+/* Drops the data read ahead, must be called after moving the access */
+static void AStreamPrefetchFlush( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    vlc_mutex_lock( &p_sys->prefetch.lock );
+    block_ChainRelease( p_sys->prefetch.p_first );
+    p_sys->prefetch.p_first = NULL;
+    p_sys->prefetch.pp_last = &p_sys->prefetch.p_first;
+    p_sys->prefetch.i_size = 0;
+    p_sys->prefetch.b_eof = false;
+    vlc_cond_signal( &p_sys->prefetch.wait_space );
+    vlc_mutex_unlock( &p_sys->prefetch.lock );
+}
+
+static void AStreamPrefetchClean( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    if( p_sys->prefetch.b_enabled )
+    {
+        vlc_mutex_lock( &p_sys->prefetch.lock );
+        p_sys->prefetch.b_exit = true;
+        vlc_cond_signal( &p_sys->prefetch.wait_space );
+        vlc_mutex_unlock( &p_sys->prefetch.lock );
+
+        /* The thread may have to finish a pending access read first */
+        vlc_join( p_sys->prefetch.thread, NULL );
+        p_sys->prefetch.b_enabled = false;
+    }
+    block_ChainRelease( p_sys->prefetch.p_first );
+    p_sys->prefetch.p_first = NULL;
+    p_sys->prefetch.pp_last = &p_sys->prefetch.p_first;
+    p_sys->prefetch.i_size = 0;
+
+    vlc_cond_destroy( &p_sys->prefetch.wait_space );
+    vlc_cond_destroy( &p_sys->prefetch.wait_data );
+    vlc_mutex_destroy( &p_sys->prefetch.lock );
+    vlc_mutex_destroy( &p_sys->prefetch.access_lock );
+}
+
+/* Gets the next segment(s) for the cache, from the prefetch queue if any.
+ * Only waits when nothing has been read ahead yet. */
+static block_t *AStreamFill( stream_t *s, bool *pb_eof )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    block_t *b;
+
+    if( !p_sys->prefetch.b_enabled )
+        return AStreamFetch( s, pb_eof );
+
+    vlc_mutex_lock( &p_sys->prefetch.lock );
+    while( p_sys->prefetch.p_first == NULL && !p_sys->prefetch.b_eof )
+        vlc_cond_wait( &p_sys->prefetch.wait_data, &p_sys->prefetch.lock );
+
+    b = p_sys->prefetch.p_first;
+    *pb_eof = p_sys->prefetch.b_eof;
+
+    p_sys->prefetch.p_first = NULL;
+    p_sys->prefetch.pp_last = &p_sys->prefetch.p_first;
+    p_sys->prefetch.i_size = 0;
+    vlc_cond_signal( &p_sys->prefetch.wait_space );
+    vlc_mutex_unlock( &p_sys->prefetch.lock );
+
+    return b;
+}
+
+/****************************************************************************
+ * Cache:
+ ****************************************************************************/
+static void AStreamResetBlock( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    block_ChainRelease( p_sys->block.p_first );
+
+    p_sys->block.i_start = p_sys->i_pos;
+    p_sys->block.i_offset = 0;
+    p_sys->block.p_current = NULL;
+    p_sys->block.i_size = 0;
+    p_sys->block.p_first = NULL;
+    p_sys->block.pp_last = &p_sys->block.p_first;
+}
+
 static void AStreamPrebufferBlock( stream_t *s )
 {
     stream_sys_t *p_sys = s->p_sys;
@@ -682,7 +927,7 @@ static void AStreamPrebufferBlock( stream_t *s )
         }
 
         /* Fetch a block */
-        if( ( b = AReadBlock( s, &b_eof ) ) == NULL )
+        if( ( b = AStreamFill( s, &b_eof ) ) == NULL )
         {
             if( b_eof )
                 break;
@@ -839,6 +1084,61 @@ static int AStreamPeekBlock( stream_t *s, const uint8_t **pp_peek, unsigned int
     return i_data;
 }
 
+static block_t *AStreamBlock( stream_t *s, unsigned int i_size )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    block_t *b = p_sys->block.p_current;
+
+    if( b == NULL ) return NULL; /* EOF */
+
+    /* Data crossing a segment boundary have to be gathered, and so have the
+     * data that could not be read again after their owner modified them */
+    if( !p_sys->block.b_lend || i_size > b->i_buffer - p_sys->block.i_offset )
+    {
+        block_t *p_bk = block_Alloc( i_size );
+        if( p_bk == NULL )
+            return NULL;
+
+        int i_read = AStreamReadBlock( s, p_bk->p_buffer, i_size );
+        if( i_read <= 0 )
+        {
+            block_Release( p_bk );
+            return NULL;
+        }
+        p_bk->i_buffer = i_read;
+        return p_bk;
+    }
+
+    /* Otherwise we can directly give a reference to our buffer */
+    block_t *p_bk = SegmentSlice( b, p_sys->block.i_offset, i_size );
+    if( p_bk == NULL )
+        return NULL;
+
+    p_sys->block.i_offset += i_size;
+    p_sys->i_pos += i_size;
+
+    if( p_sys->block.i_offset >= b->i_buffer )
+    {
+        /* Current block is now empty, switch to next */
+        p_sys->block.i_offset = 0;
+        p_sys->block.p_current = b->p_next;
+
+        /* Get a new block if needed (EOF is reported by the next call) */
+        if( !p_sys->block.p_current )
+            AStreamRefillBlock( s );
+    }
+    return p_bk;
+}
+
+/* Tells if data from b on were handed out without copy */
+static bool AStreamIsLent( block_t *b )
+{
+    for( ; b != NULL; b = b->p_next )
+        if( ((stream_segment_t *)b)->b_lent )
+            return true;
+    return false;
+}
+
 static int AStreamSeekBlock( stream_t *s, uint64_t i_pos )
 {
     stream_sys_t *p_sys = s->p_sys;
@@ -858,16 +1158,20 @@ static int AStreamSeekBlock( stream_t *s, uint64_t i_pos )
             b = b->p_next;
         }
 
-        p_sys->block.p_current = b;
-        p_sys->block.i_offset = i_offset - i_current;
+        /* The segments handed out by AStreamBlock may have been modified */
+        if( !AStreamIsLent( b ) )
+        {
+            p_sys->block.p_current = b;
+            p_sys->block.i_offset = i_offset - i_current;
 
-        p_sys->i_pos = i_pos;
+            p_sys->i_pos = i_pos;
 
-        return VLC_SUCCESS;
+            return VLC_SUCCESS;
+        }
     }
 
     /* We may need to seek or to read data */
-    if( i_offset < 0 )
+    if( i_offset < 0 || (uint64_t)i_offset < p_sys->block.i_size )
     {
         bool b_aseek;
         access_Control( p_access, ACCESS_CAN_SEEK, &b_aseek );
@@ -917,21 +1221,21 @@ static int AStreamSeekBlock( stream_t *s, uint64_t i_pos )
     if( b_seek )
     {
         int64_t i_start, i_end;
-        /* Do the access seek */
+        int i_ret;
+
+        /* Do the access seek, and drop what was read ahead */
+        vlc_mutex_lock( &p_sys->prefetch.access_lock );
         i_start = mdate();
-        if( ASeek( s, i_pos ) ) return VLC_EGENERIC;
+        i_ret = ASeek( s, i_pos );
         i_end = mdate();
+        if( !i_ret )
+            AStreamPrefetchFlush( s );
+        vlc_mutex_unlock( &p_sys->prefetch.access_lock );
+        if( i_ret ) return VLC_EGENERIC;
 
-        /* Release data */
-        block_ChainRelease( p_sys->block.p_first );
-
-        /* Reinit */
-        p_sys->block.i_start = p_sys->i_pos = i_pos;
-        p_sys->block.i_offset = 0;
-        p_sys->block.p_current = NULL;
-        p_sys->block.i_size = 0;
-        p_sys->block.p_first = NULL;
-        p_sys->block.pp_last = &p_sys->block.p_first;
+        /* Release data and reinit */
+        p_sys->i_pos = i_pos;
+        AStreamResetBlock( s );
 
         /* Refill a block */
         if( AStreamRefillBlock( s ) )
@@ -1005,7 +1309,7 @@ static int AStreamRefillBlock( stream_t *s )
             return VLC_EGENERIC;
 
         /* Fetch a block */
-        if( ( b = AReadBlock( s, &b_eof ) ) )
+        if( ( b = AStreamFill( s, &b_eof ) ) )
             break;
         if( b_eof )
             return VLC_EGENERIC;
@@ -1033,431 +1337,6 @@ static int AStreamRefillBlock( stream_t *s )
 }
 
 
-/****************************************************************************
- * Method 2:
- ****************************************************************************/
-static int AStreamRefillStream( stream_t *s );
-static int AStreamReadNoSeekStream( stream_t *s, void *p_read, unsigned int i_read );
-
-static int AStreamReadStream( stream_t *s, void *p_read, unsigned int i_read )
-{
-    stream_sys_t *p_sys = s->p_sys;
-
-    if( !p_read )
-    {
-        const uint64_t i_pos_wanted = p_sys->i_pos + i_read;
-
-        if( AStreamSeekStream( s, i_pos_wanted ) )
-        {
-            if( p_sys->i_pos != i_pos_wanted )
-                return 0;
-        }
-        return i_read;
-    }
-    return AStreamReadNoSeekStream( s, p_read, i_read );
-}
-
-static int AStreamPeekStream( stream_t *s, const uint8_t **pp_peek, unsigned int i_read )
-{
-    stream_sys_t *p_sys = s->p_sys;
-    stream_track_t *tk = &p_sys->stream.tk[p_sys->stream.i_tk];
-    uint64_t i_off;
-
-    if( tk->i_start >= tk->i_end ) return 0; /* EOF */
-
-#ifdef STREAM_DEBUG
-    msg_Dbg( s, "AStreamPeekStream: %d pos=%"PRId64" tk=%d "
-             "start=%"PRId64" offset=%d end=%"PRId64,
-             i_read, p_sys->i_pos, p_sys->stream.i_tk,
-             tk->i_start, p_sys->stream.i_offset, tk->i_end );
-#endif
-
-    /* Avoid problem, but that should *never* happen */
-    if( i_read > STREAM_CACHE_TRACK_SIZE / 2 )
-        i_read = STREAM_CACHE_TRACK_SIZE / 2;
-
-    while( tk->i_end < tk->i_start + p_sys->stream.i_offset + i_read )
-    {
-        if( p_sys->stream.i_used <= 1 )
-        {
-            /* Be sure we will read something */
-            p_sys->stream.i_used += tk->i_start + p_sys->stream.i_offset + i_read - tk->i_end;
-        }
-        if( AStreamRefillStream( s ) ) break;
-    }
-
-    if( tk->i_end < tk->i_start + p_sys->stream.i_offset + i_read )
-    {
-        i_read = tk->i_end - tk->i_start - p_sys->stream.i_offset;
-    }
-
-
-    /* Now, direct pointer or a copy ? */
-    i_off = (tk->i_start + p_sys->stream.i_offset) % STREAM_CACHE_TRACK_SIZE;
-    if( i_off + i_read <= STREAM_CACHE_TRACK_SIZE )
-    {
-        *pp_peek = &tk->p_buffer[i_off];
-        return i_read;
-    }
-
-    if( p_sys->i_peek < i_read )
-    {
-        p_sys->p_peek = realloc_or_free( p_sys->p_peek, i_read );
-        if( !p_sys->p_peek )
-        {
-            p_sys->i_peek = 0;
-            return 0;
-        }
-        p_sys->i_peek = i_read;
-    }
-
-    memcpy( p_sys->p_peek, &tk->p_buffer[i_off],
-            STREAM_CACHE_TRACK_SIZE - i_off );
-    memcpy( &p_sys->p_peek[STREAM_CACHE_TRACK_SIZE - i_off],
-            &tk->p_buffer[0], i_read - (STREAM_CACHE_TRACK_SIZE - i_off) );
-
-    *pp_peek = p_sys->p_peek;
-    return i_read;
-}
-
-static int AStreamSeekStream( stream_t *s, uint64_t i_pos )
-{
-    stream_sys_t *p_sys = s->p_sys;
-
-    stream_track_t *p_current = &p_sys->stream.tk[p_sys->stream.i_tk];
-    access_t *p_access = p_sys->p_access;
-
-    if( p_current->i_start >= p_current->i_end  && i_pos >= p_current->i_end )
-        return 0; /* EOF */
-
-#ifdef STREAM_DEBUG
-    msg_Dbg( s, "AStreamSeekStream: to %"PRId64" pos=%"PRId64
-             " tk=%d start=%"PRId64" offset=%d end=%"PRId64,
-             i_pos, p_sys->i_pos, p_sys->stream.i_tk,
-             p_current->i_start,
-             p_sys->stream.i_offset,
-             p_current->i_end );
-#endif
-
-    bool   b_aseek;
-    access_Control( p_access, ACCESS_CAN_SEEK, &b_aseek );
-    if( !b_aseek && i_pos < p_current->i_start )
-    {
-        msg_Warn( s, "AStreamSeekStream: can't seek" );
-        return VLC_EGENERIC;
-    }
-
-    bool   b_afastseek;
-    access_Control( p_access, ACCESS_CAN_FASTSEEK, &b_afastseek );
-
-    /* FIXME compute seek cost (instead of static 'stupid' value) */
-    uint64_t i_skip_threshold;
-    if( b_aseek )
-        i_skip_threshold = b_afastseek ? 128 : 3*p_sys->stream.i_read_size;
-    else
-        i_skip_threshold = INT64_MAX;
-
-    /* Date the current track */
-    p_current->i_date = mdate();
-
-    /* Search a new track slot */
-    stream_track_t *tk = NULL;
-    int i_tk_idx = -1;
-
-    /* Prefer the current track */
-    if( p_current->i_start <= i_pos && i_pos <= p_current->i_end + i_skip_threshold )
-    {
-        tk = p_current;
-        i_tk_idx = p_sys->stream.i_tk;
-    }
-    if( !tk )
-    {
-        /* Try to maximize already read data */
-        for( int i = 0; i < STREAM_CACHE_TRACK; i++ )
-        {
-            stream_track_t *t = &p_sys->stream.tk[i];
-
-            if( t->i_start > i_pos || i_pos > t->i_end )
-                continue;
-
-            if( !tk || tk->i_end < t->i_end )
-            {
-                tk = t;
-                i_tk_idx = i;
-            }
-        }
-    }
-    if( !tk )
-    {
-        /* Use the oldest unused */
-        for( int i = 0; i < STREAM_CACHE_TRACK; i++ )
-        {
-            stream_track_t *t = &p_sys->stream.tk[i];
-
-            if( !tk || tk->i_date > t->i_date )
-            {
-                tk = t;
-                i_tk_idx = i;
-            }
-        }
-    }
-    assert( i_tk_idx >= 0 && i_tk_idx < STREAM_CACHE_TRACK );
-
-    if( tk != p_current )
-        i_skip_threshold = 0;
-    if( tk->i_start <= i_pos && i_pos <= tk->i_end + i_skip_threshold )
-    {
-#ifdef STREAM_DEBUG
-        msg_Err( s, "AStreamSeekStream: reusing %d start=%"PRId64
-                 " end=%"PRId64"(%s)",
-                 i_tk_idx, tk->i_start, tk->i_end,
-                 tk != p_current ? "seek" : i_pos > tk->i_end ? "skip" : "noseek" );
-#endif
-        if( tk != p_current )
-        {
-            assert( b_aseek );
-
-            /* Seek at the end of the buffer
-             * TODO it is stupid to seek now, it would be better to delay it
-             */
-            if( ASeek( s, tk->i_end ) )
-                return VLC_EGENERIC;
-        }
-        else if( i_pos > tk->i_end )
-        {
-            uint64_t i_skip = i_pos - tk->i_end;
-            while( i_skip > 0 )
-            {
-                const int i_read_max = __MIN( 10 * STREAM_READ_ATONCE, i_skip );
-                if( AStreamReadNoSeekStream( s, NULL, i_read_max ) != i_read_max )
-                    return VLC_EGENERIC;
-                i_skip -= i_read_max;
-            }
-        }
-    }
-    else
-    {
-#ifdef STREAM_DEBUG
-        msg_Err( s, "AStreamSeekStream: hard seek" );
-#endif
-        /* Nothing good, seek and choose oldest segment */
-        if( ASeek( s, i_pos ) )
-            return VLC_EGENERIC;
-
-        tk->i_start = i_pos;
-        tk->i_end   = i_pos;
-    }
-    p_sys->stream.i_offset = i_pos - tk->i_start;
-    p_sys->stream.i_tk = i_tk_idx;
-    p_sys->i_pos = i_pos;
-
-    /* If there is not enough data left in the track, refill  */
-    /* TODO How to get a correct value for
-     *    - refilling threshold
-     *    - how much to refill
-     */
-    if( tk->i_end < tk->i_start + p_sys->stream.i_offset + p_sys->stream.i_read_size )
-    {
-        if( p_sys->stream.i_used < STREAM_READ_ATONCE / 2 )
-            p_sys->stream.i_used = STREAM_READ_ATONCE / 2;
-
-        if( AStreamRefillStream( s ) && i_pos == tk->i_end )
-            return VLC_EGENERIC;
-    }
-    return VLC_SUCCESS;
-}
-
-static int AStreamReadNoSeekStream( stream_t *s, void *p_read, unsigned int i_read )
-{
-    stream_sys_t *p_sys = s->p_sys;
-    stream_track_t *tk = &p_sys->stream.tk[p_sys->stream.i_tk];
-
-    uint8_t *p_data = (uint8_t *)p_read;
-    unsigned int i_data = 0;
-
-    if( tk->i_start >= tk->i_end )
-        return 0; /* EOF */
-
-#ifdef STREAM_DEBUG
-    msg_Dbg( s, "AStreamReadStream: %d pos=%"PRId64" tk=%d start=%"PRId64
-             " offset=%d end=%"PRId64,
-             i_read, p_sys->i_pos, p_sys->stream.i_tk,
-             tk->i_start, p_sys->stream.i_offset, tk->i_end );
-#endif
-
-    while( i_data < i_read )
-    {
-        unsigned i_off = (tk->i_start + p_sys->stream.i_offset) % STREAM_CACHE_TRACK_SIZE;
-        unsigned int i_current =
-            __MIN( tk->i_end - tk->i_start - p_sys->stream.i_offset,
-                   STREAM_CACHE_TRACK_SIZE - i_off );
-        int i_copy = __MIN( i_current, i_read - i_data );
-
-        if( i_copy <= 0 ) break; /* EOF */
-
-        /* Copy data */
-        /* msg_Dbg( s, "AStreamReadStream: copy %d", i_copy ); */
-        if( p_data )
-        {
-            memcpy( p_data, &tk->p_buffer[i_off], i_copy );
-            p_data += i_copy;
-        }
-        i_data += i_copy;
-        p_sys->stream.i_offset += i_copy;
-
-        /* Update pos now */
-        p_sys->i_pos += i_copy;
-
-        /* */
-        p_sys->stream.i_used += i_copy;
-
-        if( tk->i_end + i_data <= tk->i_start + p_sys->stream.i_offset + i_read )
-        {
-            const unsigned i_read_requested = __MAX( __MIN( i_read - i_data,
-                                                            STREAM_READ_ATONCE * 10 ),
-                                                     STREAM_READ_ATONCE / 2 );
-
-            if( p_sys->stream.i_used < i_read_requested )
-                p_sys->stream.i_used = i_read_requested;
-
-            if( AStreamRefillStream( s ) )
-            {
-                /* EOF */
-                if( tk->i_start >= tk->i_end ) break;
-            }
-        }
-    }
-
-    return i_data;
-}
-
-
-static int AStreamRefillStream( stream_t *s )
-{
-    stream_sys_t *p_sys = s->p_sys;
-    stream_track_t *tk = &p_sys->stream.tk[p_sys->stream.i_tk];
-
-    /* We read but won't increase i_start after initial start + offset */
-    int i_toread =
-        __MIN( p_sys->stream.i_used, STREAM_CACHE_TRACK_SIZE -
-               (tk->i_end - tk->i_start - p_sys->stream.i_offset) );
-    bool b_read = false;
-    int64_t i_start, i_stop;
-
-    if( i_toread <= 0 ) return VLC_EGENERIC; /* EOF */
-
-#ifdef STREAM_DEBUG
-    msg_Dbg( s, "AStreamRefillStream: used=%d toread=%d",
-                 p_sys->stream.i_used, i_toread );
-#endif
-
-    i_start = mdate();
-    while( i_toread > 0 )
-    {
-        int i_off = tk->i_end % STREAM_CACHE_TRACK_SIZE;
-        int i_read;
-
-        if( s->b_die )
-            return VLC_EGENERIC;
-
-        i_read = __MIN( i_toread, STREAM_CACHE_TRACK_SIZE - i_off );
-        i_read = AReadStream( s, &tk->p_buffer[i_off], i_read );
-
-        /* msg_Dbg( s, "AStreamRefillStream: read=%d", i_read ); */
-        if( i_read <  0 )
-        {
-            continue;
-        }
-        else if( i_read == 0 )
-        {
-            if( !b_read )
-                return VLC_EGENERIC;
-            return VLC_SUCCESS;
-        }
-        b_read = true;
-
-        /* Update end */
-        tk->i_end += i_read;
-
-        /* Windows of STREAM_CACHE_TRACK_SIZE */
-        if( tk->i_start + STREAM_CACHE_TRACK_SIZE < tk->i_end )
-        {
-            unsigned i_invalid = tk->i_end - tk->i_start - STREAM_CACHE_TRACK_SIZE;
-
-            tk->i_start += i_invalid;
-            p_sys->stream.i_offset -= i_invalid;
-        }
-
-        i_toread -= i_read;
-        p_sys->stream.i_used -= i_read;
-
-        p_sys->stat.i_bytes += i_read;
-        p_sys->stat.i_read_count++;
-    }
-    i_stop = mdate();
-
-    p_sys->stat.i_read_time += i_stop - i_start;
-
-    return VLC_SUCCESS;
-}
-
-static void AStreamPrebufferStream( stream_t *s )
-{
-    stream_sys_t *p_sys = s->p_sys;
-
-    int64_t i_first = 0;
-    int64_t i_start;
-
-    msg_Dbg( s, "starting pre-buffering" );
-    i_start = mdate();
-    for( ;; )
-    {
-        stream_track_t *tk = &p_sys->stream.tk[p_sys->stream.i_tk];
-
-        int64_t i_date = mdate();
-        int i_read;
-        int i_buffered = tk->i_end - tk->i_start;
-
-        if( s->b_die || i_buffered >= STREAM_CACHE_PREBUFFER_SIZE )
-        {
-            int64_t i_byterate;
-
-            /* Update stat */
-            p_sys->stat.i_bytes = i_buffered;
-            p_sys->stat.i_read_time = i_date - i_start;
-            i_byterate = ( INT64_C(1000000) * p_sys->stat.i_bytes ) /
-                         (p_sys->stat.i_read_time+1);
-
-            msg_Dbg( s, "pre-buffering done %"PRId64" bytes in %"PRId64"s - "
-                     "%"PRId64" KiB/s",
-                     p_sys->stat.i_bytes,
-                     p_sys->stat.i_read_time / INT64_C(1000000),
-                     i_byterate / 1024 );
-            break;
-        }
-
-        /* */
-        i_read = STREAM_CACHE_TRACK_SIZE - i_buffered;
-        i_read = __MIN( (int)p_sys->stream.i_read_size, i_read );
-        i_read = AReadStream( s, &tk->p_buffer[i_buffered], i_read );
-        if( i_read <  0 )
-            continue;
-        else if( i_read == 0 )
-            break;  /* EOF */
-
-        if( i_first == 0 )
-        {
-            i_first = mdate();
-            msg_Dbg( s, "received first data after %d ms",
-                     (int)((i_first-i_start)/1000) );
-        }
-
-        tk->i_end += i_read;
-
-        p_sys->stat.i_read_count++;
-    }
-}
-
 /****************************************************************************
  * stream_ReadLine:
  ****************************************************************************/
@@ -1723,6 +1602,10 @@ static int AReadStream( stream_t *s, void *p_read, unsigned int i_read )
 
         p_sys->p_list_access = p_list_access;
 
+        /* A block access is read by the next AStreamFetch() */
+        if( p_list_access->pf_read == NULL )
+            return -1;
+
         /* We have to read some data */
         return AReadStream( s, p_read, i_read_orig );
     }
@@ -1791,6 +1674,13 @@ static block_t *AReadBlock( stream_t *s, bool *pb_eof )
 
         p_sys->p_list_access = p_list_access;
 
+        /* A stream access is read by the next AStreamFetch() */
+        if( p_list_access->pf_block == NULL )
+        {
+            if( pb_eof ) *pb_eof = false;
+            return NULL;
+        }
+
         /* We have to read some data */
         return AReadBlock( s, pb_eof );
     }
@@ -1928,6 +1818,9 @@ block_t *stream_Block( stream_t *s, int i_size )
 {
     if( i_size <= 0 ) return NULL;
 
+    if( s->pf_block != NULL )
+        return s->pf_block( s, i_size );
+
     /* emulate block read */
     block_t *p_bk = block_New( s, i_size );
     if( p_bk )
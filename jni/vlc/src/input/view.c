@@ -0,0 +1,328 @@
+/*****************************************************************************
+ * view.c: programs of an input displayed by other inputs
+ *****************************************************************************
+ * Copyright (C) 2011 the VideoLAN team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_input.h>
+#include <vlc_es_out.h>
+#include <vlc_block.h>
+
+#include "input_internal.h"
+
+/*
+ * A view lets an input (the view input) play one program of another input
+ * (the source) without reading the stream again. The source demuxer sends
+ * the elementary streams of that program to the es_out of the view instead
+ * of its own one (DEMUX_SET_GROUP_OUTPUT). That es_out is a proxy owned by
+ * the view: the view input can end at any time, after what the demuxer
+ * output is silently dropped until the source removes the view. When the
+ * source cannot do that for the program, the view input ends in error.
+ *
+ * A view is referenced by its creator (handed over to the view input with
+ * the "input-view" variable), and by the source while it uses it or has a
+ * pending control about it.
+ */
+
+struct es_out_id_t
+{
+    es_out_id_t *p_id; /* in the es_out of the view input, or NULL */
+};
+
+struct input_view_t
+{
+    vlc_mutex_t     lock;
+    unsigned        i_refs;
+
+    input_thread_t  *p_source;  /* held until the view input detaches */
+    int             i_program;
+
+    /* View input and its es_out, NULL when not attached (protected by lock) */
+    input_thread_t  *p_input;
+    es_out_t        *p_out;
+    int             i_es;
+    es_out_id_t     **es;
+
+    /* Given to the demuxer of the source */
+    es_out_t        out;
+};
+
+static es_out_id_t *EsOutAdd( es_out_t *, const es_format_t * );
+static int          EsOutSend( es_out_t *, es_out_id_t *, block_t * );
+static void         EsOutDel( es_out_t *, es_out_id_t * );
+static int          EsOutControl( es_out_t *, int i_query, va_list );
+
+input_view_t *input_view_New( input_thread_t *p_source, int i_program )
+{
+    input_view_t *p_view = malloc( sizeof(*p_view) );
+    if( !p_view )
+        return NULL;
+
+    vlc_mutex_init( &p_view->lock );
+    p_view->i_refs = 1;
+    p_view->p_source = vlc_object_hold( p_source );
+    p_view->i_program = i_program;
+    p_view->p_input = NULL;
+    p_view->p_out = NULL;
+    TAB_INIT( p_view->i_es, p_view->es );
+
+    p_view->out.pf_add = EsOutAdd;
+    p_view->out.pf_send = EsOutSend;
+    p_view->out.pf_del = EsOutDel;
+    p_view->out.pf_control = EsOutControl;
+    p_view->out.pf_destroy = NULL;
+    p_view->out.p_sys = (es_out_sys_t *)p_view;
+
+    return p_view;
+}
+
+input_view_t *input_view_Hold( input_view_t *p_view )
+{
+    vlc_mutex_lock( &p_view->lock );
+    p_view->i_refs++;
+    vlc_mutex_unlock( &p_view->lock );
+    return p_view;
+}
+
+void input_view_Release( input_view_t *p_view )
+{
+    vlc_mutex_lock( &p_view->lock );
+    assert( p_view->i_refs > 0 );
+    const bool b_last = --p_view->i_refs == 0;
+    vlc_mutex_unlock( &p_view->lock );
+
+    if( !b_last )
+        return;
+
+    /* Only the source could still use the es_out, and it does not */
+    assert( p_view->p_out == NULL );
+    for( int i = 0; i < p_view->i_es; i++ )
+        free( p_view->es[i] );
+    TAB_CLEAN( p_view->i_es, p_view->es );
+
+    if( p_view->p_source )
+        vlc_object_release( p_view->p_source );
+    vlc_mutex_destroy( &p_view->lock );
+    free( p_view );
+}
+
+int input_view_GetProgram( input_view_t *p_view )
+{
+    return p_view->i_program;
+}
+
+es_out_t *input_view_GetEsOut( input_view_t *p_view )
+{
+    return &p_view->out;
+}
+
+/**
+ * Called by the view input once its es_out is ready.
+ */
+void input_view_Attach( input_view_t *p_view, input_thread_t *p_input )
+{
+    vlc_mutex_lock( &p_view->lock );
+    p_view->p_input = p_input;
+    p_view->p_out = p_input->p->p_es_out;
+    input_thread_t *p_source = p_view->p_source;
+    vlc_mutex_unlock( &p_view->lock );
+
+    if( !p_source )
+        return;
+
+    msg_Dbg( p_input, "viewing program %d of input %p",
+             p_view->i_program, (void *)p_source );
+
+    vlc_value_t val = { .p_address = input_view_Hold( p_view ) };
+    input_ControlPush( p_source, INPUT_CONTROL_ADD_VIEW, &val );
+}
+
+/**
+ * Called by the view input before its es_out is destroyed.
+ */
+void input_view_Detach( input_view_t *p_view )
+{
+    vlc_mutex_lock( &p_view->lock );
+    for( int i = 0; i < p_view->i_es; i++ )
+    {
+        es_out_id_t *id = p_view->es[i];
+        if( id->p_id && p_view->p_out )
+            es_out_Del( p_view->p_out, id->p_id );
+        id->p_id = NULL;
+    }
+    p_view->p_input = NULL;
+    p_view->p_out = NULL;
+
+    input_thread_t *p_source = p_view->p_source;
+    p_view->p_source = NULL;
+    vlc_mutex_unlock( &p_view->lock );
+
+    if( !p_source )
+        return;
+
+    vlc_value_t val = { .p_address = input_view_Hold( p_view ) };
+    input_ControlPush( p_source, INPUT_CONTROL_DEL_VIEW, &val );
+    /* This can destroy the source if it is already stopped, and release
+     * its references to the view: the view lock cannot be held here */
+    vlc_object_release( p_source );
+}
+
+/**
+ * Called by the source when it cannot demux the program for the view: the
+ * view input ends in error.
+ */
+void input_view_Fail( input_view_t *p_view )
+{
+    vlc_mutex_lock( &p_view->lock );
+    if( p_view->p_input )
+        input_ControlPush( p_view->p_input, INPUT_CONTROL_VIEW_FAILED, NULL );
+    vlc_mutex_unlock( &p_view->lock );
+}
+
+/*****************************************************************************
+ * es_out proxy, called by the demuxer of the source
+ *****************************************************************************/
+static es_out_id_t *EsOutAdd( es_out_t *out, const es_format_t *p_fmt )
+{
+    input_view_t *p_view = (input_view_t *)out->p_sys;
+    es_out_id_t *id = malloc( sizeof(*id) );
+    if( !id )
+        return NULL;
+
+    vlc_mutex_lock( &p_view->lock );
+    id->p_id = p_view->p_out ? es_out_Add( p_view->p_out, p_fmt ) : NULL;
+    TAB_APPEND( p_view->i_es, p_view->es, id );
+    vlc_mutex_unlock( &p_view->lock );
+
+    return id;
+}
+
+static int EsOutSend( es_out_t *out, es_out_id_t *id, block_t *p_block )
+{
+    input_view_t *p_view = (input_view_t *)out->p_sys;
+    int i_ret = VLC_SUCCESS;
+
+    vlc_mutex_lock( &p_view->lock );
+    if( id->p_id )
+        i_ret = es_out_Send( p_view->p_out, id->p_id, p_block );
+    else
+        block_Release( p_block );
+    vlc_mutex_unlock( &p_view->lock );
+
+    return i_ret;
+}
+
+static void EsOutDel( es_out_t *out, es_out_id_t *id )
+{
+    input_view_t *p_view = (input_view_t *)out->p_sys;
+
+    vlc_mutex_lock( &p_view->lock );
+    if( id->p_id )
+        es_out_Del( p_view->p_out, id->p_id );
+    TAB_REMOVE( p_view->i_es, p_view->es, id );
+    vlc_mutex_unlock( &p_view->lock );
+
+    free( id );
+}
+
+static int EsOutControl( es_out_t *out, int i_query, va_list args )
+{
+    input_view_t *p_view = (input_view_t *)out->p_sys;
+    int i_ret = VLC_EGENERIC;
+
+    vlc_mutex_lock( &p_view->lock );
+    if( !p_view->p_out )
+    {
+        vlc_mutex_unlock( &p_view->lock );
+        return VLC_EGENERIC;
+    }
+
+    switch( i_query )
+    {
+    case ES_OUT_SET_GROUP_PCR:
+    {
+        int i_group = (int)va_arg( args, int );
+        int64_t i_pcr = (int64_t)va_arg( args, int64_t );
+        i_ret = es_out_Control( p_view->p_out, i_query, i_group, i_pcr );
+        break;
+    }
+    case ES_OUT_RESET_PCR:
+        i_ret = es_out_Control( p_view->p_out, i_query );
+        break;
+
+    case ES_OUT_SET_GROUP_META:
+    case ES_OUT_SET_GROUP_EPG:
+    {
+        int i_group = (int)va_arg( args, int );
+        void *p_arg = va_arg( args, void * );
+        i_ret = es_out_Control( p_view->p_out, i_query, i_group, p_arg );
+        break;
+    }
+    case ES_OUT_DEL_GROUP:
+    {
+        int i_group = (int)va_arg( args, int );
+        i_ret = es_out_Control( p_view->p_out, i_query, i_group );
+        break;
+    }
+
+    case ES_OUT_SET_ES_SCRAMBLED_STATE:
+    {
+        es_out_id_t *id = (es_out_id_t *)va_arg( args, es_out_id_t * );
+        bool b_scrambled = (bool)va_arg( args, int );
+        if( id->p_id )
+            i_ret = es_out_Control( p_view->p_out, i_query,
+                                    id->p_id, b_scrambled );
+        break;
+    }
+    case ES_OUT_SET_ES_FMT:
+    {
+        es_out_id_t *id = (es_out_id_t *)va_arg( args, es_out_id_t * );
+        es_format_t *p_fmt = (es_format_t *)va_arg( args, es_format_t * );
+        if( id->p_id )
+            i_ret = es_out_Control( p_view->p_out, i_query,
+                                    id->p_id, p_fmt );
+        break;
+    }
+    case ES_OUT_GET_ES_STATE:
+    {
+        es_out_id_t *id = (es_out_id_t *)va_arg( args, es_out_id_t * );
+        bool *pb_enabled = (bool *)va_arg( args, bool * );
+        if( id->p_id )
+            i_ret = es_out_Control( p_view->p_out, i_query,
+                                    id->p_id, pb_enabled );
+        break;
+    }
+
+    default:
+        /* The program selection and the playback state belong to the
+         * view input */
+        break;
+    }
+    vlc_mutex_unlock( &p_view->lock );
+
+    return i_ret;
+}
@@ -784,6 +784,15 @@ static const char *const ppsz_clock_descriptions[] =
     "This is the maximum size in bytes of the temporary files " \
     "that will be used to store the timeshifted streams." )
 
+#define STREAM_PREFETCH_TEXT N_("Stream prefetch")
+#define STREAM_PREFETCH_LONGTEXT N_( \
+    "Read the input ahead from a dedicated thread, so that network " \
+    "stalls do not block the demuxer while data are available." )
+
+#define STREAM_PREFETCH_SIZE_TEXT N_("Stream prefetch buffer size (kB)")
+#define STREAM_PREFETCH_SIZE_LONGTEXT N_( \
+    "Maximum amount of data read ahead by the stream prefetch thread." )
+
 #define INPUT_TITLE_FORMAT_TEXT N_( "Change title according to current media" )
 #define INPUT_TITLE_FORMAT_LONGTEXT N_( "This option allows you to set the title according to what's being played<br>"  \
     "$a: Artist<br>$b: Album<br>$c: Copyright<br>$t: Title<br>$g: Genre<br>"  \
@@ -893,6 +902,31 @@ static const char *const ppsz_clock_descriptions[] =
 #define TIMEOUT_LONGTEXT N_( \
     "Default TCP connection timeout (in milliseconds). " )
 
+#define NET_RCVBUF_TEXT N_("Socket receive buffer size")
+#define NET_RCVBUF_LONGTEXT N_( \
+    "Receive buffer size of the network sockets (in bytes). " \
+    "0 keeps the default of the module or of the system." )
+
+#define NET_SNDBUF_TEXT N_("Socket send buffer size")
+#define NET_SNDBUF_LONGTEXT N_( \
+    "Send buffer size of the network sockets (in bytes). " \
+    "0 keeps the default of the module or of the system." )
+
+#define NET_RCVLOWAT_TEXT N_("Socket receive low watermark")
+#define NET_RCVLOWAT_LONGTEXT N_( \
+    "Minimum number of bytes the network sockets wait for before waking " \
+    "up a reader. 0 keeps the system default." )
+
+#define NET_NODELAY_TEXT N_("Disable Nagle algorithm")
+#define NET_NODELAY_LONGTEXT N_( \
+    "Send small TCP segments immediately (TCP_NODELAY)." )
+
+#define NET_QUICKACK_TEXT N_("TCP quick acknowledgements")
+#define NET_QUICKACK_LONGTEXT N_( \
+    "Acknowledge received TCP segments immediately (TCP_QUICKACK), " \
+    "where supported. The system resets it, so it is only kept on the " \
+    "connections read with a buffered reader, like HTTP." )
+
 #define SOCKS_SERVER_TEXT N_("SOCKS server")
 #define SOCKS_SERVER_LONGTEXT N_( \
     "SOCKS proxy server to use. This must be of the form " \
@@ -1886,6 +1920,16 @@ vlc_module_begin ()
     add_obsolete_bool( "ipv4" ) /* since 1.2.0 */
     add_integer( "ipv4-timeout", 5 * 1000, TIMEOUT_TEXT,
                  TIMEOUT_LONGTEXT, true )
+    add_integer( "net-rcvbuf", 0, NET_RCVBUF_TEXT,
+                 NET_RCVBUF_LONGTEXT, true )
+    add_integer( "net-sndbuf", 0, NET_SNDBUF_TEXT,
+                 NET_SNDBUF_LONGTEXT, true )
+    add_integer( "net-rcvlowat", 0, NET_RCVLOWAT_TEXT,
+                 NET_RCVLOWAT_LONGTEXT, true )
+    add_bool( "net-tcp-nodelay", false, NET_NODELAY_TEXT,
+              NET_NODELAY_LONGTEXT, true )
+    add_bool( "net-tcp-quickack", false, NET_QUICKACK_TEXT,
+              NET_QUICKACK_LONGTEXT, true )
 
     set_section( N_( "Socks proxy") , NULL )
     add_string( "socks", NULL,
@@ -1946,6 +1990,11 @@ vlc_module_begin ()
     add_integer( "input-timeshift-granularity", -1, INPUT_TIMESHIFT_GRANULARITY_TEXT,
                  INPUT_TIMESHIFT_GRANULARITY_LONGTEXT, true )
 
+    add_bool( "stream-prefetch", false, STREAM_PREFETCH_TEXT,
+              STREAM_PREFETCH_LONGTEXT, true )
+    add_integer( "stream-prefetch-buffer-size", 4096, STREAM_PREFETCH_SIZE_TEXT,
+                 STREAM_PREFETCH_SIZE_LONGTEXT, true )
+
     add_string( "input-title-format", "$Z", INPUT_TITLE_FORMAT_TEXT, INPUT_TITLE_FORMAT_LONGTEXT, false );
 
 /* Decoder options */
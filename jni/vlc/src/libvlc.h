@@ -120,6 +120,13 @@ vlc_custom_create (vlc_object_t *p_this, size_t i_size, const char *psz_type);
 extern int vlc_object_set_name(vlc_object_t *, const char *);
 #define vlc_object_set_name(o, n) vlc_object_set_name(VLC_OBJECT(o), n)
 
+/**
+ * Moves an object under another parent.
+ */
+void vlc_object_reparent (vlc_object_t *, vlc_object_t *);
+#define vlc_object_reparent(o, p) \
+        vlc_object_reparent(VLC_OBJECT(o), VLC_OBJECT(p))
+
 /* Types */
 typedef void (*vlc_destructor_t) (struct vlc_object_t *);
 void vlc_object_set_destructor (vlc_object_t *, vlc_destructor_t);
@@ -236,6 +243,12 @@ extern const size_t libvlc_config_count;
  */
 void var_OptionParse (vlc_object_t *, const char *, bool trusted);
 
+/*
+ * Block allocator
+ */
+void block_CacheStats( uint64_t *pi_hits, uint64_t *pi_misses,
+                       uint64_t *pi_remote );
+
 /*
  * Stats stuff
  */
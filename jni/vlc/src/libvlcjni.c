@@ -32,14 +32,7 @@
 JavaVM *gJVM = NULL;
 
 /* JNI fields */
-static jclass clz_VlcEvent = 0;
-static jfieldID f_VlcEvent_eventType = 0;
-static jfieldID f_VlcEvent_booleanValue = 0;
-static jfieldID f_VlcEvent_intValue = 0;
-static jfieldID f_VlcEvent_longValue = 0;
-static jfieldID f_VlcEvent_floatValue = 0;
-static jfieldID f_VlcEvent_stringValue = 0;
-static jmethodID m_VlcMediaPlayer_onVlcEvent = 0;
+static jmethodID m_VlcMediaPlayer_onVlcEventsPending = 0;
 
 /*added by zx
  *1 modules all be removed
@@ -53,6 +46,27 @@ static void *vlc_jni_player_gc_thread(void *);
 
 libvlc_instance_t *s_vlc_instance = 0;
 
+/* see nativePollEvents() */
+typedef struct _vlc_jni_event
+{
+    int32_t type;
+    int32_t intValue;
+    int64_t longValue;
+    float floatValue;
+    int32_t reserved;
+} vlc_jni_event_t;
+
+#define VLC_JNI_EVENT_SIZE 24
+#define VLC_JNI_EVENT_QUEUE 64
+/* the queue, the overflow marker and the two coalesced records */
+#define VLC_JNI_EVENT_MAX (VLC_JNI_EVENT_QUEUE + 3)
+
+/* not a libvlc event: intValue events were dropped, the queue was full */
+#define VLC_JNI_EVENT_OVERFLOW 4096
+
+#define VLC_JNI_EVENT_PENDING_TIME 1
+#define VLC_JNI_EVENT_PENDING_POSITION 2
+
 typedef struct _vlc_jni_player
 {
     int status;
@@ -66,6 +80,20 @@ typedef struct _vlc_jni_player
     int buffering;
     void *surface;
     vlc_mutex_t surface_lock;
+    vlc_cond_t surface_wait;
+    bool surface_busy; /* locked by the vout, see jni_LockAndGetAndroidSurface() */
+    /* events, see nativePollEvents() */
+    vlc_mutex_t event_lock;
+    vlc_jni_event_t event_queue[VLC_JNI_EVENT_QUEUE];
+    int event_first;
+    int event_count;
+    vlc_jni_event_t event_time;
+    vlc_jni_event_t event_position;
+    int event_pending;
+    int event_dropped;
+    bool event_woken;
+    vlc_jni_event_t event_records[VLC_JNI_EVENT_MAX];
+    jobject event_buffer;
 } vlc_jni_player_t;
 
 static void *s_surface = 0;
@@ -152,7 +180,7 @@ static inline vlc_jni_player_t *vlc_jni_player_find_by_vout(vlc_object_t *p_vout
         }
         for (size_t c = 0; c < n; c++)
         {
-            if ((int) p_vout == (int) pp_vouts[c])
+            if (p_vout == (vlc_object_t *) pp_vouts[c])
                 vj = t;
             vlc_object_release((vlc_object_t *) pp_vouts[c]);
         }
@@ -196,30 +224,104 @@ JNIEXPORT int Java_org_stagex_danmaku_helper_SystemUtility_setenv(JNIEnv *env, j
     return err;
 }
 
+/*
+ * Events are not delivered to Java from the libvlc event thread anymore.
+ * They are queued in a per player ring, and the high rate time/position
+ * updates only keep their latest value until another event is queued.
+ * Java is woken up once when the queue stops being empty, and then fetches
+ * everything at once with nativePollEvents() into the direct ByteBuffer
+ * returned by nativeGetEventBuffer(), which holds VLC_JNI_EVENT_MAX records
+ * of VLC_JNI_EVENT_SIZE bytes in native byte order:
+ *   int type, int intValue (also booleanValue), long longValue,
+ *   float floatValue, int reserved
+ * Events that do not fit in the ring are replaced by one
+ * VLC_JNI_EVENT_OVERFLOW record.
+ * */
+static vlc_jni_event_t *vlc_jni_event_queue(vlc_jni_player_t *vj)
+{
+    if (vj->event_count >= VLC_JNI_EVENT_QUEUE)
+        return NULL;
+    vlc_jni_event_t *e = &vj->event_queue[(vj->event_first + vj->event_count) % VLC_JNI_EVENT_QUEUE];
+    vj->event_count += 1;
+    return e;
+}
+
+/* Queue the coalesced records, so that they keep their place before the
+ * next events */
+static void vlc_jni_event_queue_pending(vlc_jni_player_t *vj)
+{
+    vlc_jni_event_t *e;
+    if ((vj->event_pending & VLC_JNI_EVENT_PENDING_POSITION) && (e = vlc_jni_event_queue(vj)))
+    {
+        *e = vj->event_position;
+        vj->event_pending &= ~VLC_JNI_EVENT_PENDING_POSITION;
+    }
+    if ((vj->event_pending & VLC_JNI_EVENT_PENDING_TIME) && (e = vlc_jni_event_queue(vj)))
+    {
+        *e = vj->event_time;
+        vj->event_pending &= ~VLC_JNI_EVENT_PENDING_TIME;
+    }
+}
+
+static void vlc_jni_event_push(vlc_jni_player_t *vj, int type, int i, int64_t l, float f)
+{
+    vlc_jni_event_t *e;
+    vlc_mutex_lock(&vj->event_lock);
+    switch (type) {
+    case libvlc_MediaPlayerTimeChanged:
+        e = &vj->event_time;
+        vj->event_pending |= VLC_JNI_EVENT_PENDING_TIME;
+        break;
+    case libvlc_MediaPlayerPositionChanged:
+        e = &vj->event_position;
+        vj->event_pending |= VLC_JNI_EVENT_PENDING_POSITION;
+        break;
+    default:
+        if (vj->event_dropped == 0)
+            vlc_jni_event_queue_pending(vj);
+        /* once an event is dropped, the next ones wait for the poll too,
+         * so that the overflow marker is at the right place */
+        e = (vj->event_dropped == 0) ? vlc_jni_event_queue(vj) : NULL;
+        if (!e)
+        {
+            vj->event_dropped += 1;
+            __android_log_print(ANDROID_LOG_WARN, "vmplayer", "event %d dropped", type);
+        }
+        break;
+    }
+    if (e)
+    {
+        e->type = type;
+        e->intValue = i;
+        e->longValue = l;
+        e->floatValue = f;
+        e->reserved = 0;
+    }
+    bool wake = !vj->event_woken;
+    vj->event_woken = true;
+    vlc_mutex_unlock(&vj->event_lock);
+
+    if (wake)
+    {
+        JNIEnv *env;
+        if ((*gJVM)->AttachCurrentThread(gJVM, &env, 0) < 0)
+            return;
+        (*env)->CallVoidMethod(env, vj->reference, m_VlcMediaPlayer_onVlcEventsPending);
+    }
+}
+
 static void vlc_event_callback(const libvlc_event_t *ev, void *data)
 {
-    JNIEnv *env;
-    jobject obj_VlcMediaPlayer;
-    jobject obj_VlcEvent;
-    int trigger = 1;
+    vlc_jni_player_t *vj = (vlc_jni_player_t *) data;
 
-    if ((*gJVM)->AttachCurrentThread(gJVM, &env, 0) < 0)
-        return;
-    obj_VlcEvent = (*env)->AllocObject(env, clz_VlcEvent);
-    if (!obj_VlcEvent)
-        return;
-    vlc_jni_player_t *vj = vlc_jni_player_find_or_throw(env, (jobject) data);
-    char *mrl = libvlc_media_get_mrl(vj->media);
-    (*env)->SetIntField(env, obj_VlcEvent, f_VlcEvent_eventType, ev->type);
     switch (ev->type) {
     case libvlc_MediaDurationChanged: {
         int64_t duration = ev->u.media_duration_changed.new_duration;
-        (*env)->SetLongField(env, obj_VlcEvent, f_VlcEvent_longValue, (jlong) duration);
+        vlc_jni_event_push(vj, ev->type, -1, duration, -1.0f);
         break;
     }
     case libvlc_MediaStateChanged: {
         int state = ev->u.media_state_changed.new_state;
-        (*env)->SetIntField(env, obj_VlcEvent, f_VlcEvent_intValue, state);
         /* wake up if there is an error */
         if (state == libvlc_MediaPlayerEncounteredError) {
             vlc_mutex_lock(&vj->parse_lock);
@@ -227,22 +329,20 @@ static void vlc_event_callback(const libvlc_event_t *ev, void *data)
             vlc_cond_broadcast(&vj->parse_cond);
             vlc_mutex_unlock(&vj->parse_lock);
         }
+        vlc_jni_event_push(vj, ev->type, state, -1, -1.0f);
         break;
     }
     case libvlc_MediaParsedChanged: {
         libvlc_media_player_play(vj->player);
-        trigger = 0;
         break;
     }
     case libvlc_MediaPlayerBuffering: {
         float cache = ev->u.media_player_buffering.new_cache;
-        (*env)->SetFloatField(env, obj_VlcEvent, f_VlcEvent_floatValue, cache);
+        vlc_jni_event_push(vj, ev->type, -1, -1, cache);
         if ((int) cache == 100) {
             vj->buffering += 1;
             /* if it's the first time */
             if (vj->buffering == 1) {
-                /* send buffering update event now */
-                (*env)->CallVoidMethod(env, vj->reference, m_VlcMediaPlayer_onVlcEvent, obj_VlcEvent);
                 libvlc_media_player_set_pause(vj->player, 1);
                 /* asynchonous preparing is done */
                 vlc_mutex_lock(&vj->parse_lock);
@@ -250,59 +350,93 @@ static void vlc_event_callback(const libvlc_event_t *ev, void *data)
                 vlc_cond_broadcast(&vj->parse_cond);
                 vlc_mutex_unlock(&vj->parse_lock);
                 /* simulate a media prepared event */
-                (*env)->SetIntField(env, obj_VlcEvent, f_VlcEvent_eventType, libvlc_MediaParsedChanged);
-                (*env)->SetBooleanField(env, obj_VlcEvent, f_VlcEvent_booleanValue, 1);
+                vlc_jni_event_push(vj, libvlc_MediaParsedChanged, 1, -1, -1.0f);
             }
         }
         break;
     }
     case libvlc_MediaPlayerTimeChanged: {
         int64_t time = ev->u.media_player_time_changed.new_time;
-        (*env)->SetLongField(env, obj_VlcEvent, f_VlcEvent_longValue, (jlong) time);
+        vlc_jni_event_push(vj, ev->type, -1, time, -1.0f);
         break;
     }
     case libvlc_MediaPlayerPositionChanged: {
         float position = ev->u.media_player_position_changed.new_position;
-        (*env)->SetFloatField(env, obj_VlcEvent, f_VlcEvent_floatValue, position);
+        vlc_jni_event_push(vj, ev->type, -1, -1, position);
         break;
     }
     case libvlc_MediaPlayerSeekableChanged: {
         int seekable = ev->u.media_player_seekable_changed.new_seekable;
-        (*env)->SetBooleanField(env, obj_VlcEvent, f_VlcEvent_booleanValue, seekable > 0);
+        vlc_jni_event_push(vj, ev->type, seekable > 0, -1, -1.0f);
         break;
     }
     case libvlc_MediaPlayerPausableChanged: {
         int pausable = ev->u.media_player_pausable_changed.new_pausable;
-        (*env)->SetBooleanField(env, obj_VlcEvent, f_VlcEvent_booleanValue, pausable > 0);
+        vlc_jni_event_push(vj, ev->type, pausable > 0, -1, -1.0f);
         break;
     }
     case libvlc_MediaPlayerTitleChanged: {
         int title = ev->u.media_player_title_changed.new_title;
-        (*env)->SetIntField(env, obj_VlcEvent, f_VlcEvent_intValue, title);
-        break;
-    }
-    case libvlc_MediaPlayerSnapshotTaken: {
-        char *p = ev->u.media_player_snapshot_taken.psz_filename;
-        jstring path = (*env)->NewStringUTF(env, p);
-        (*env)->SetObjectField(env, obj_VlcEvent, f_VlcEvent_stringValue, path);
+        vlc_jni_event_push(vj, ev->type, title, -1, -1.0f);
         break;
     }
     case libvlc_MediaPlayerLengthChanged: {
         int64_t length = ev->u.media_player_length_changed.new_length;
-        (*env)->SetLongField(env, obj_VlcEvent, f_VlcEvent_longValue, (jlong) length);
+        vlc_jni_event_push(vj, ev->type, -1, length, -1.0f);
         break;
     }
     default:
+        vlc_jni_event_push(vj, ev->type, -1, -1, -1.0f);
         break;
     }
-    if (trigger)
-        (*env)->CallVoidMethod(env, vj->reference, m_VlcMediaPlayer_onVlcEvent, obj_VlcEvent);
-    (*env)->DeleteLocalRef(env, obj_VlcEvent);
-    free(mrl);
     /* EXPLAIN: this is called in pthread wrapper routines */
     // (*gJVM)->DetachCurrentThread(gJVM);
 }
 
+JNIEXPORT jobject JNICALL NAME(nativeGetEventBuffer)(JNIEnv *env, jobject thiz)
+{
+    vlc_jni_player_t *vj = vlc_jni_player_find_or_throw(env, thiz);
+    return vj->event_buffer;
+}
+
+/*
+ * Copy the pending events to the event buffer, returns their count.
+ * The buffer holds everything that can be pending, so the queue is always
+ * drained and the next event wakes Java up again.
+ * */
+JNIEXPORT jint JNICALL NAME(nativePollEvents)(JNIEnv *env, jobject thiz)
+{
+    vlc_jni_player_t *vj = vlc_jni_player_find_or_throw(env, thiz);
+    vlc_jni_event_t *out = vj->event_records;
+    int n = 0;
+    vlc_mutex_lock(&vj->event_lock);
+    while (vj->event_count > 0)
+    {
+        out[n++] = vj->event_queue[vj->event_first];
+        vj->event_first = (vj->event_first + 1) % VLC_JNI_EVENT_QUEUE;
+        vj->event_count -= 1;
+    }
+    if (vj->event_dropped > 0)
+    {
+        vlc_jni_event_t *e = &out[n++];
+        e->type = VLC_JNI_EVENT_OVERFLOW;
+        e->intValue = vj->event_dropped;
+        e->longValue = -1;
+        e->floatValue = -1.0f;
+        e->reserved = 0;
+        vj->event_dropped = 0;
+    }
+    /* the coalesced records are newer than anything queued */
+    if (vj->event_pending & VLC_JNI_EVENT_PENDING_POSITION)
+        out[n++] = vj->event_position;
+    if (vj->event_pending & VLC_JNI_EVENT_PENDING_TIME)
+        out[n++] = vj->event_time;
+    vj->event_pending = 0;
+    vj->event_woken = false;
+    vlc_mutex_unlock(&vj->event_lock);
+    return n;
+}
+
 JNIEXPORT void JNICALL NAME(nativeAttachSurface)(JNIEnv *env, jobject thiz, jobject s)
 {
     vlc_jni_player_t *vj = vlc_jni_player_find_or_throw(env, thiz);
@@ -324,6 +458,8 @@ JNIEXPORT void JNICALL NAME(nativeAttachSurface)(JNIEnv *env, jobject thiz, jobj
     (*env)->DeleteLocalRef(env, clz);
     surface = (*env)->GetIntField(env, s, f_Surface_mSurface);
     vlc_mutex_lock(&vj->surface_lock);
+    while (vj->surface_busy)
+        vlc_cond_wait(&vj->surface_wait, &vj->surface_lock);
     vj->surface = (void *) surface;
     vlc_mutex_unlock(&vj->surface_lock);
 }
@@ -332,6 +468,8 @@ JNIEXPORT void JNICALL NAME(nativeDetachSurface)(JNIEnv *env, jobject thiz)
 {
     vlc_jni_player_t *vj = vlc_jni_player_find_or_throw(env, thiz);
     vlc_mutex_lock(&vj->surface_lock);
+    while (vj->surface_busy)
+        vlc_cond_wait(&vj->surface_wait, &vj->surface_lock);
     vj->surface = 0;
     vlc_mutex_unlock(&vj->surface_lock);
 }
@@ -360,22 +498,10 @@ JNIEXPORT void JNICALL NAME(nativeCreate)(JNIEnv *env, jobject thiz)
 {
     /* setup JNI fields if needed */
     jclass clz;
-    if (!m_VlcMediaPlayer_onVlcEvent)
+    if (!m_VlcMediaPlayer_onVlcEventsPending)
     {
         clz = (*env)->GetObjectClass(env, thiz);
-        m_VlcMediaPlayer_onVlcEvent = (*env)->GetMethodID(env, clz, "onVlcEvent", "(L" PREFIX "VlcMediaPlayer$VlcEvent;)V");
-        (*env)->DeleteLocalRef(env, clz);
-    }
-    if (!clz_VlcEvent)
-    {
-        clz = (*env)->FindClass(env, PREFIX "VlcMediaPlayer$VlcEvent");
-        clz_VlcEvent = (*env)->NewGlobalRef(env, clz);
-        f_VlcEvent_eventType = (*env)->GetFieldID(env, clz, "eventType", "I");
-        f_VlcEvent_booleanValue = (*env)->GetFieldID(env, clz, "booleanValue", "Z");
-        f_VlcEvent_intValue = (*env)->GetFieldID(env, clz, "intValue", "I");
-        f_VlcEvent_longValue = (*env)->GetFieldID(env, clz, "longValue", "J");
-        f_VlcEvent_floatValue = (*env)->GetFieldID(env, clz, "floatValue", "F");
-        f_VlcEvent_stringValue = (*env)->GetFieldID(env, clz, "stringValue", "Ljava/lang/String;");
+        m_VlcMediaPlayer_onVlcEventsPending = (*env)->GetMethodID(env, clz, "onVlcEventsPending", "()V");
         (*env)->DeleteLocalRef(env, clz);
     }
     /* */
@@ -395,12 +521,17 @@ JNIEXPORT void JNICALL NAME(nativeCreate)(JNIEnv *env, jobject thiz)
     vlc_mutex_init(&vj->parse_lock);
     vlc_cond_init(&vj->parse_cond);
     vlc_mutex_init(&vj->surface_lock);
+    vlc_cond_init(&vj->surface_wait);
+    vlc_mutex_init(&vj->event_lock);
+    jobject buffer = (*env)->NewDirectByteBuffer(env, vj->event_records, sizeof(vj->event_records));
+    vj->event_buffer = (*env)->NewGlobalRef(env, buffer);
+    (*env)->DeleteLocalRef(env, buffer);
     vj->status = 1;
     vj->player = libvlc_media_player_new(s_vlc_instance);
     libvlc_event_manager_t *em = libvlc_media_player_event_manager(vj->player);
     for (int i = 0; i < sizeof(mp_listening) / sizeof(*mp_listening); i++)
     {
-        libvlc_event_attach(em, mp_listening[i], vlc_event_callback, thiz);
+        libvlc_event_attach(em, mp_listening[i], vlc_event_callback, vj);
     }
     vlc_jni_player_push(vj);
 }
@@ -548,7 +679,7 @@ JNIEXPORT void JNICALL NAME(nativeSetDataSource)(JNIEnv *env, jobject thiz, jstr
         libvlc_event_manager_t *em = libvlc_media_event_manager(media);
         for (int i = 0; i < sizeof(md_listening) / sizeof(*md_listening); i++)
         {
-            libvlc_event_attach(em, md_listening[i], vlc_event_callback, thiz);
+            libvlc_event_attach(em, md_listening[i], vlc_event_callback, vj);
         }
         /* this will cancel current input and start a new one */
         libvlc_media_player_set_media(vj->player, media);
@@ -564,6 +695,102 @@ JNIEXPORT void JNICALL NAME(nativeSetDataSource)(JNIEnv *env, jobject thiz, jstr
     }
 }
 
+/*
+ * Keep a source connected in the background (slot 0 or 1), so that a later
+ * nativeSwitchSource() on the same path starts from its cached data.
+ * A null path frees the slot.
+ * */
+JNIEXPORT void JNICALL NAME(nativeSetStandbySource)(JNIEnv *env, jobject thiz, jint slot, jstring path)
+{
+    vlc_jni_player_t *vj = vlc_jni_player_find_or_throw(env, thiz);
+    if (!path)
+    {
+        libvlc_media_player_set_standby(vj->player, slot, NULL);
+        return;
+    }
+    const char *str = (*env)->GetStringUTFChars(env, path, 0);
+    if (!str)
+    {
+        /* XXX: throw */
+        return;
+    }
+    libvlc_media_t *media = (*str == '/') ? libvlc_media_new_path(s_vlc_instance, str) : libvlc_media_new_location(s_vlc_instance, str);
+    (*env)->ReleaseStringUTFChars(env, path, str);
+    if (!media)
+    {
+        /* XXX: throw */
+        return;
+    }
+    libvlc_media_player_set_standby(vj->player, slot, media);
+    libvlc_media_release(media);
+}
+
+/*
+ * Warm channel switch: keep the player, its vout and its aout alive and only
+ * replace the input. The new media is played right away, so there is no
+ * prepare step and no pause on the first full buffer.
+ * */
+JNIEXPORT void JNICALL NAME(nativeSwitchSource)(JNIEnv *env, jobject thiz, jstring path)
+{
+    vlc_jni_player_t *vj = vlc_jni_player_find_or_throw(env, thiz);
+    const char *str = (*env)->GetStringUTFChars(env, path, 0);
+    if (!str)
+    {
+        /* XXX: throw */
+        return;
+    }
+    libvlc_media_t *media = (*str == '/') ? libvlc_media_new_path(s_vlc_instance, str) : libvlc_media_new_location(s_vlc_instance, str);
+    (*env)->ReleaseStringUTFChars(env, path, str);
+    if (!media)
+    {
+        /* XXX: throw */
+        return;
+    }
+    libvlc_media_t *old = vj->media;
+    libvlc_event_manager_t *em;
+    if (old)
+    {
+        em = libvlc_media_event_manager(old);
+        for (int i = 0; i < sizeof(md_listening) / sizeof(*md_listening); i++)
+        {
+            libvlc_event_detach(em, md_listening[i], vlc_event_callback, vj);
+        }
+    }
+    em = libvlc_media_event_manager(media);
+    for (int i = 0; i < sizeof(md_listening) / sizeof(*md_listening); i++)
+    {
+        libvlc_event_attach(em, md_listening[i], vlc_event_callback, vj);
+    }
+    vj->media = media;
+    /* already prepared, see libvlc_MediaPlayerBuffering */
+    vj->buffering = 1;
+    libvlc_media_player_switch_media(vj->player, media);
+    if (old)
+        libvlc_media_release(old);
+}
+
+/*
+ * Multi-view: play one program of the stream played by another player,
+ * which demuxes it for both (e.g. a preview thumbnail of another service
+ * of the same multiplex).
+ * */
+JNIEXPORT void JNICALL NAME(nativeSetViewSource)(JNIEnv *env, jobject thiz, jobject source, jint program)
+{
+    vlc_jni_player_t *vj = vlc_jni_player_find_or_throw(env, thiz);
+    vlc_jni_player_t *src = vlc_jni_player_find_or_throw(env, source);
+    if (!vj || !src)
+        return;
+    /* already prepared, see libvlc_MediaPlayerBuffering */
+    vj->buffering = 1;
+    if (libvlc_media_player_play_view(vj->player, src->player, program) == -1)
+    {
+        vj->buffering = 0;
+        jclass exception = (*env)->FindClass(env, "java/lang/IllegalStateException");
+        if (exception)
+            (*env)->ThrowNew(env, exception, libvlc_errmsg());
+    }
+}
+
 JNIEXPORT void JNICALL NAME(nativeSetLooping)(JNIEnv *env, jobject thiz, jboolean looping)
 {
 
@@ -637,22 +864,27 @@ static void *vlc_jni_player_gc_thread(void *para)
             em = libvlc_media_event_manager(md);
             for (int i = 0; i < sizeof(md_listening) / sizeof(*md_listening); i++)
             {
-                libvlc_event_detach(em, md_listening[i], vlc_event_callback, vj->object);
+                libvlc_event_detach(em, md_listening[i], vlc_event_callback, vj);
             }
         }
         em = libvlc_media_player_event_manager(vj->player);
         for (int i = 0; i < sizeof(mp_listening) / sizeof(*mp_listening); i++)
         {
-            libvlc_event_detach(em, mp_listening[i], vlc_event_callback, vj->object);
+            libvlc_event_detach(em, mp_listening[i], vlc_event_callback, vj);
 		}
         libvlc_media_player_stop(vj->player);
         libvlc_media_player_release(vj->player);
         /* XXX: free global reference */
+        JNIEnv *env;
+        if ((*gJVM)->AttachCurrentThread(gJVM, &env, 0) >= 0)
+            (*env)->DeleteGlobalRef(env, vj->event_buffer);
 
         /* */
         vlc_mutex_destroy(&vj->parse_lock);
         vlc_cond_destroy(&vj->parse_cond);
         vlc_mutex_destroy(&vj->surface_lock);
+        vlc_cond_destroy(&vj->surface_wait);
+        vlc_mutex_destroy(&vj->event_lock);
         free(vj);
         
 		nIsRemoved = 1;
@@ -660,22 +892,43 @@ static void *vlc_jni_player_gc_thread(void *para)
     }
 }
 
-void *jni_LockAndGetAndroidSurface(vlc_object_t *p_vout)
+/*
+ * The vout display looks its player up once, the result stays valid as
+ * long as the vout: the player is stopped, and its vouts are destroyed,
+ * before the gc thread frees it.
+ * It fails until the vout is registered to the input, the caller must
+ * try again on the next frame then.
+ * */
+void *jni_GetAndroidPlayer(vlc_object_t *p_vout)
 {
-    vlc_jni_player_t *vj = vlc_jni_player_find_by_vout(p_vout);
-    if (vj)
-    {
-        vlc_mutex_lock(&vj->surface_lock);
-        return vj->surface;
-    }
-    return NULL;
+    return vlc_jni_player_find_by_vout(p_vout);
 }
 
-void jni_UnlockAndroidSurface(vlc_object_t *p_vout)
+/*
+ * The vout keeps the surface from the decoder thread, where its picture is
+ * taken, to the vout thread, where it is posted: the surface is marked busy
+ * in between instead of holding the mutex across threads. Attaching or
+ * detaching a surface waits for the picture to be posted.
+ * */
+void *jni_LockAndGetAndroidSurface(void *player)
 {
-    vlc_jni_player_t *vj = vlc_jni_player_find_by_vout(p_vout);
-    if (vj)
-        vlc_mutex_unlock(&vj->surface_lock);
+    vlc_jni_player_t *vj = (vlc_jni_player_t *) player;
+    vlc_mutex_lock(&vj->surface_lock);
+    while (vj->surface_busy)
+        vlc_cond_wait(&vj->surface_wait, &vj->surface_lock);
+    void *surface = vj->surface;
+    vj->surface_busy = surface != NULL;
+    vlc_mutex_unlock(&vj->surface_lock);
+    return surface;
+}
+
+void jni_UnlockAndroidSurface(void *player)
+{
+    vlc_jni_player_t *vj = (vlc_jni_player_t *) player;
+    vlc_mutex_lock(&vj->surface_lock);
+    vj->surface_busy = false;
+    vlc_cond_broadcast(&vj->surface_wait);
+    vlc_mutex_unlock(&vj->surface_lock);
 }
 
 void jni_SetAndroidSurfaceSize(vlc_object_t *p_vout, int width, int height)
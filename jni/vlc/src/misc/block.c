@@ -29,25 +29,83 @@
 #endif
 
 #include <vlc_common.h>
+#include <vlc_atomic.h>
 #include <sys/stat.h>
 #include <assert.h>
 #include <errno.h>
 #include "vlc_block.h"
+#include "libvlc.h"
 
 /**
  * @section Block handling functions.
  */
 
+typedef struct block_cache_t block_cache_t;
+
 /**
  * Internal state for heap block.
   */
 struct block_sys_t
 {
     block_t     self;
+    block_cache_t *p_cache;     /* Owner cache, NULL if not from a cache */
+    unsigned    i_class;
     size_t      i_allocated_buffer;
     uint8_t     p_allocated_buffer[];
 };
 
+/**
+ * Size classes of the block caches.
+ * A block is taken from a class only if it wastes less than half of it,
+ * other sizes are always allocated from the heap.
+ */
+static const struct
+{
+    size_t   i_size;
+    unsigned i_max;     /* Maximum number of cached blocks per thread */
+} block_classes[] = {
+    {   204, 512 },     /* TS packets (188, 192, 204) */
+    {  1316, 256 },     /* 7 TS packets */
+    {  1500, 256 },     /* Ethernet MTU */
+    {  4096,  64 },
+    { 65536,   8 },     /* UDP datagram maximum */
+};
+#define BLOCK_CLASSES (sizeof(block_classes) / sizeof(block_classes[0]))
+
+/* Hits and misses are accounted per thread, and added to the global
+ * counters by batches of that many allocations */
+#define BLOCK_STATS_BATCH 256
+
+/**
+ * Per-thread block cache.
+ * Only its thread uses the free lists. Blocks released by other threads
+ * are pushed on a lock-free stack, which the thread takes as a whole.
+ */
+struct block_cache_t
+{
+    block_sys_t *free[BLOCK_CLASSES];
+    unsigned     count[BLOCK_CLASSES];
+    unsigned     i_hits;
+    unsigned     i_misses;
+
+    vlc_atomic_t remote;    /* Stack of blocks released by other threads */
+    vlc_atomic_t refs;      /* Thread and blocks not returned to the heap */
+    vlc_atomic_t dead;      /* Thread has exited */
+};
+
+static vlc_mutex_t cache_lock = VLC_STATIC_MUTEX;
+static vlc_threadvar_t cache_key;
+static vlc_atomic_t cache_ready = VLC_ATOMIC_INIT(0);
+
+static struct
+{
+    vlc_atomic_t hits;
+    vlc_atomic_t misses;
+    vlc_atomic_t remote;
+} cache_stats = {
+    VLC_ATOMIC_INIT(0), VLC_ATOMIC_INIT(0), VLC_ATOMIC_INIT(0),
+};
+
 #ifndef NDEBUG
 static void BlockNoRelease( block_t *b )
 {
@@ -73,9 +131,167 @@ void block_Init( block_t *restrict b, void *buf, size_t size )
 #endif
 }
 
+static void BlockCacheUnref( block_cache_t *p_cache )
+{
+    if( vlc_atomic_dec( &p_cache->refs ) == 0 )
+        free( p_cache );
+}
+
+/* Returns a block of a cache to the heap */
+static void BlockCacheFree( block_sys_t *p_sys )
+{
+    block_cache_t *p_cache = p_sys->p_cache;
+
+    free( p_sys );
+    BlockCacheUnref( p_cache );
+}
+
+/* Frees a stack of blocks returned to a dead cache */
+static void BlockCacheFreeStack( block_sys_t *p_sys )
+{
+    while( p_sys != NULL )
+    {
+        block_sys_t *p_next = (block_sys_t *)p_sys->self.p_next;
+
+        BlockCacheFree( p_sys );
+        p_sys = p_next;
+    }
+}
+
+static void BlockCacheFlushStats( block_cache_t *p_cache )
+{
+    vlc_atomic_add( &cache_stats.hits, p_cache->i_hits );
+    vlc_atomic_add( &cache_stats.misses, p_cache->i_misses );
+    p_cache->i_hits = p_cache->i_misses = 0;
+}
+
+/* Thread exit */
+static void BlockCacheDestroy( void *data )
+{
+    block_cache_t *p_cache = data;
+
+    vlc_atomic_set( &p_cache->dead, 1 );
+    BlockCacheFlushStats( p_cache );
+
+    for( unsigned i = 0; i < BLOCK_CLASSES; i++ )
+        BlockCacheFreeStack( p_cache->free[i] );
+    BlockCacheFreeStack( (block_sys_t *)vlc_atomic_swap( &p_cache->remote, 0 ) );
+
+    BlockCacheUnref( p_cache );
+}
+
+static block_cache_t *BlockCacheGet( void )
+{
+    if( unlikely(!vlc_atomic_get( &cache_ready )) )
+    {
+        vlc_mutex_lock( &cache_lock );
+        if( !vlc_atomic_get( &cache_ready ) &&
+            !vlc_threadvar_create( &cache_key, BlockCacheDestroy ) )
+            vlc_atomic_set( &cache_ready, 1 );
+        vlc_mutex_unlock( &cache_lock );
+
+        if( !vlc_atomic_get( &cache_ready ) )
+            return NULL;
+    }
+
+    block_cache_t *p_cache = vlc_threadvar_get( cache_key );
+    if( unlikely(p_cache == NULL) )
+    {
+        p_cache = calloc( 1, sizeof(*p_cache) );
+        if( p_cache == NULL )
+            return NULL;
+        vlc_atomic_set( &p_cache->remote, 0 );
+        vlc_atomic_set( &p_cache->refs, 1 );
+        vlc_atomic_set( &p_cache->dead, 0 );
+        if( vlc_threadvar_set( cache_key, p_cache ) )
+        {
+            free( p_cache );
+            return NULL;
+        }
+    }
+    return p_cache;
+}
+
+/* Moves the blocks released by other threads to the free lists */
+static void BlockCacheCollect( block_cache_t *p_cache )
+{
+    block_sys_t *p_sys =
+        (block_sys_t *)vlc_atomic_swap( &p_cache->remote, 0 );
+
+    while( p_sys != NULL )
+    {
+        block_sys_t *p_next = (block_sys_t *)p_sys->self.p_next;
+        const unsigned i_class = p_sys->i_class;
+
+        if( p_cache->count[i_class] < block_classes[i_class].i_max )
+        {
+            p_sys->self.p_next = (block_t *)p_cache->free[i_class];
+            p_cache->free[i_class] = p_sys;
+            p_cache->count[i_class]++;
+        }
+        else
+            BlockCacheFree( p_sys );
+        p_sys = p_next;
+    }
+}
+
 static void BlockRelease( block_t *p_block )
 {
-    free( p_block );
+    block_sys_t *p_sys = (block_sys_t *)p_block;
+    block_cache_t *p_cache = p_sys->p_cache;
+
+    if( p_cache == NULL )
+    {
+        free( p_sys );
+        return;
+    }
+
+    /* Released by the owner thread */
+    if( p_cache == vlc_threadvar_get( cache_key ) )
+    {
+        const unsigned i_class = p_sys->i_class;
+
+        if( p_cache->count[i_class] < block_classes[i_class].i_max )
+        {
+            p_sys->self.p_next = (block_t *)p_cache->free[i_class];
+            p_cache->free[i_class] = p_sys;
+            p_cache->count[i_class]++;
+        }
+        else
+            BlockCacheFree( p_sys );
+        return;
+    }
+
+    /* Released by another thread: push it back to the owner. The extra
+     * reference keeps the cache alive until we are done with it. */
+    vlc_atomic_inc( &p_cache->refs );
+    vlc_atomic_inc( &cache_stats.remote );
+
+    uintptr_t head;
+    do
+    {
+        head = vlc_atomic_get( &p_cache->remote );
+        p_sys->self.p_next = (block_t *)head;
+    }
+    while( vlc_atomic_compare_swap( &p_cache->remote, head,
+                                    (uintptr_t)p_sys ) != head );
+
+    /* The owner may have exited meanwhile, nobody would collect it */
+    if( vlc_atomic_get( &p_cache->dead ) )
+        BlockCacheFreeStack( (block_sys_t *)vlc_atomic_swap( &p_cache->remote, 0 ) );
+
+    BlockCacheUnref( p_cache );
+}
+
+/**
+ * Gets the block allocator statistics, for all threads.
+ */
+void block_CacheStats( uint64_t *pi_hits, uint64_t *pi_misses,
+                       uint64_t *pi_remote )
+{
+    *pi_hits = vlc_atomic_get( &cache_stats.hits );
+    *pi_misses = vlc_atomic_get( &cache_stats.misses );
+    *pi_remote = vlc_atomic_get( &cache_stats.remote );
 }
 
 static void BlockMetaCopy( block_t *restrict out, const block_t *in )
@@ -98,43 +314,65 @@ static void BlockMetaCopy( block_t *restrict out, const block_t *in )
 
 block_t *block_Alloc( size_t i_size )
 {
-    /* We do only one malloc
-     * TODO: bench if doing 2 malloc but keeping a pool of buffer is better
+    /* We do only one malloc, and keep the blocks of the common sizes in
+     * per-thread caches (see block_classes)
      * 2 * BLOCK_PADDING -> pre + post padding
      */
-    block_sys_t *p_sys;
+    block_sys_t *p_sys = NULL;
+    block_cache_t *p_cache = NULL;
+    unsigned i_class = 0;
+    size_t i_capacity = i_size;
     uint8_t *buf;
 
-#define ALIGN(x) (((x) + BLOCK_ALIGN - 1) & ~(BLOCK_ALIGN - 1))
-#if 0 /*def HAVE_POSIX_MEMALIGN */
-    /* posix_memalign(,16,) is much slower than malloc() on glibc.
-     * -- Courmisch, September 2009, glibc 2.5 & 2.9 */
-    const size_t i_alloc = ALIGN(sizeof(*p_sys)) + (2 * BLOCK_PADDING)
-                         + ALIGN(i_size);
-    void *ptr;
-
-    if( posix_memalign( &ptr, BLOCK_ALIGN, i_alloc ) )
-        return NULL;
+    while( i_class < BLOCK_CLASSES && i_size > block_classes[i_class].i_size )
+        i_class++;
+    if( i_class < BLOCK_CLASSES && 2 * i_size > block_classes[i_class].i_size )
+    {
+        p_cache = BlockCacheGet();
+        i_capacity = block_classes[i_class].i_size;
+    }
 
-    p_sys = ptr;
-    buf = p_sys->p_allocated_buffer + (-sizeof(*p_sys) & (BLOCK_ALIGN - 1));
+    if( p_cache != NULL )
+    {
+        if( p_cache->free[i_class] == NULL )
+            BlockCacheCollect( p_cache );
 
-#else
-    const size_t i_alloc = sizeof(*p_sys) + BLOCK_ALIGN + (2 * BLOCK_PADDING)
-                         + ALIGN(i_size);
-    p_sys = malloc( i_alloc );
+        p_sys = p_cache->free[i_class];
+        if( p_sys != NULL )
+        {
+            p_cache->free[i_class] = (block_sys_t *)p_sys->self.p_next;
+            p_cache->count[i_class]--;
+            p_cache->i_hits++;
+        }
+        else
+            p_cache->i_misses++;
+
+        if( p_cache->i_hits + p_cache->i_misses >= BLOCK_STATS_BATCH )
+            BlockCacheFlushStats( p_cache );
+    }
+
+#define ALIGN(x) (((x) + BLOCK_ALIGN - 1) & ~(BLOCK_ALIGN - 1))
     if( p_sys == NULL )
-        return NULL;
+    {
+        const size_t i_alloc = sizeof(*p_sys) + BLOCK_ALIGN
+                             + (2 * BLOCK_PADDING) + ALIGN(i_capacity);
+        p_sys = malloc( i_alloc );
+        if( p_sys == NULL )
+            return NULL;
 
-    buf = (void *)ALIGN((uintptr_t)p_sys->p_allocated_buffer);
+        /* Fill opaque data */
+        p_sys->i_allocated_buffer = i_alloc - sizeof(*p_sys);
+        p_sys->p_cache = p_cache;
+        p_sys->i_class = i_class;
+        if( p_cache != NULL )
+            vlc_atomic_inc( &p_cache->refs );
+    }
 
-#endif
+    buf = (void *)ALIGN((uintptr_t)p_sys->p_allocated_buffer);
     buf += BLOCK_PADDING;
 
     block_Init( &p_sys->self, buf, i_size );
     p_sys->self.pf_release    = BlockRelease;
-    /* Fill opaque data */
-    p_sys->i_allocated_buffer = i_alloc - sizeof(*p_sys);
 
     return &p_sys->self;
 }
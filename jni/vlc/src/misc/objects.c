@@ -516,6 +516,43 @@ void vlc_object_release( vlc_object_t *p_this )
     }
 }
 
+#undef vlc_object_reparent
+/**
+ * Moves an object under another parent: it is killed with it, and inherits
+ * its variables from it from then on. The object must not be in use by
+ * another thread.
+ */
+void vlc_object_reparent( vlc_object_t *p_this, vlc_object_t *p_parent )
+{
+    vlc_object_internals_t *internals = vlc_internals( p_this );
+    vlc_object_t *p_old = p_this->p_parent;
+
+    assert( p_old != NULL && p_parent != NULL );
+    if( p_old == p_parent )
+        return;
+    vlc_object_hold( p_parent );
+
+    libvlc_lock (p_this->p_libvlc);
+    /* Unlink from the old parent */
+    if (internals->prev != NULL)
+        internals->prev->next = internals->next;
+    else
+        vlc_internals(p_old)->first = internals->next;
+    if (internals->next != NULL)
+        internals->next->prev = internals->prev;
+
+    /* Link to the new one */
+    internals->prev = NULL;
+    internals->next = vlc_internals(p_parent)->first;
+    if (internals->next != NULL)
+        internals->next->prev = internals;
+    vlc_internals(p_parent)->first = internals;
+    p_this->p_parent = p_parent;
+    libvlc_unlock (p_this->p_libvlc);
+
+    vlc_object_release( p_old );
+}
+
 #undef vlc_list_children
 /**
  * Gets the list of children of an objects, and increment their reference
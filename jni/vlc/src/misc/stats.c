@@ -169,6 +169,20 @@ void stats_ComputeInputStats( input_thread_t *p_input, input_stats_t *p_stats )
                       &p_stats->i_read_bytes );
     stats_GetFloat( p_input, p_input->p->counters.p_input_bitrate,
                     &p_stats->f_input_bitrate );
+    /* see net_ReportSockOpts() */
+    p_stats->i_socket_rcvbuf = var_GetInteger( p_input, "sock-rcvbuf" );
+    p_stats->i_socket_sndbuf = var_GetInteger( p_input, "sock-sndbuf" );
+    /* see the httplive stream filter */
+    p_stats->i_adaptive_bandwidth = var_GetInteger( p_input, "adaptive-bandwidth" );
+    p_stats->i_adaptive_variant = var_GetInteger( p_input, "adaptive-variant" );
+    p_stats->i_adaptive_buffer = var_GetInteger( p_input, "adaptive-buffer" );
+    p_stats->i_adaptive_switches = var_GetInteger( p_input, "adaptive-switches" );
+    /* see block_Alloc() */
+    uint64_t i_hits, i_misses, i_remote;
+    block_CacheStats( &i_hits, &i_misses, &i_remote );
+    p_stats->i_block_hits = i_hits;
+    p_stats->i_block_misses = i_misses;
+    p_stats->i_block_remote = i_remote;
     stats_GetInteger( p_input, p_input->p->counters.p_demux_read,
                       &p_stats->i_demux_read_bytes );
     stats_GetFloat( p_input, p_input->p->counters.p_demux_bitrate,
@@ -216,6 +230,11 @@ void stats_ReinitInputStats( input_stats_t *p_stats )
     vlc_mutex_lock( &p_stats->lock );
     p_stats->i_read_packets = p_stats->i_read_bytes =
     p_stats->f_input_bitrate = p_stats->f_average_input_bitrate =
+    p_stats->i_socket_rcvbuf = p_stats->i_socket_sndbuf =
+    p_stats->i_adaptive_bandwidth = p_stats->i_adaptive_variant =
+    p_stats->i_adaptive_buffer = p_stats->i_adaptive_switches =
+    p_stats->i_block_hits = p_stats->i_block_misses =
+    p_stats->i_block_remote =
     p_stats->i_demux_read_packets = p_stats->i_demux_read_bytes =
     p_stats->f_demux_bitrate = p_stats->f_average_demux_bitrate =
     p_stats->i_demux_corrupted = p_stats->i_demux_discontinuity =
@@ -233,10 +252,20 @@ void stats_DumpInputStats( input_stats_t *p_stats  )
     /* f_bitrate is in bytes / microsecond
      * *1000 => bytes / millisecond => kbytes / seconds */
     fprintf( stderr, "Input : %"PRId64" (%"PRId64" bytes) - %f kB/s - "
+                     "socket buffers %"PRId64"/%"PRId64" - "
+                     "adaptive %"PRId64"/%"PRId64" bits/s (%"PRId64" ahead, "
+                     "%"PRId64" switches) - "
+                     "blocks %"PRId64"/%"PRId64" cached (%"PRId64" remote) - "
                      "Demux : %"PRId64" (%"PRId64" bytes) - %f kB/s\n"
                      " - Vout : %"PRId64"/%"PRId64" - Aout : %"PRId64"/%"PRId64" - Sout : %f\n",
                     p_stats->i_read_packets, p_stats->i_read_bytes,
                     p_stats->f_input_bitrate * 1000,
+                    p_stats->i_socket_rcvbuf, p_stats->i_socket_sndbuf,
+                    p_stats->i_adaptive_variant, p_stats->i_adaptive_bandwidth,
+                    p_stats->i_adaptive_buffer, p_stats->i_adaptive_switches,
+                    p_stats->i_block_hits,
+                    p_stats->i_block_hits + p_stats->i_block_misses,
+                    p_stats->i_block_remote,
                     p_stats->i_demux_read_packets, p_stats->i_demux_read_bytes,
                     p_stats->f_demux_bitrate * 1000,
                     p_stats->i_displayed_pictures, p_stats->i_lost_pictures,
@@ -68,6 +68,163 @@ int vlc_getnameinfo( const struct sockaddr *sa, int salen,
     return i_val;
 }
 
+/*
+ * Resolver cache: the numeric addresses of the recently resolved host names
+ * are kept for a short while, so that reconnecting to the same server does
+ * not go through DNS again. Cached entries are turned back into addrinfo
+ * lists with numeric lookups, so the result can still be freed with
+ * freeaddrinfo().
+ */
+#define HOST_CACHE_SIZE  16
+#define HOST_CACHE_ADDRS 4
+#define HOST_CACHE_TTL   (60 * CLOCK_FREQ)
+
+typedef struct
+{
+    char    *psz_node;
+    int      i_family;
+    int      i_socktype;
+    int      i_protocol;
+    int      i_flags;
+    mtime_t  i_date;
+    unsigned i_addrs;
+    char     ppsz_addr[HOST_CACHE_ADDRS][NI_MAXNUMERICHOST];
+} host_cache_entry_t;
+
+static host_cache_entry_t host_cache[HOST_CACHE_SIZE];
+static vlc_mutex_t host_cache_lock = VLC_STATIC_MUTEX;
+
+static host_cache_entry_t *HostCacheFind( const char *node,
+                                          const struct addrinfo *hints )
+{
+    for( unsigned i = 0; i < HOST_CACHE_SIZE; i++ )
+    {
+        host_cache_entry_t *e = &host_cache[i];
+        if( e->psz_node != NULL && !strcmp( e->psz_node, node )
+         && e->i_family == hints->ai_family
+         && e->i_socktype == hints->ai_socktype
+         && e->i_protocol == hints->ai_protocol
+         && e->i_flags == hints->ai_flags )
+            return e;
+    }
+    return NULL;
+}
+
+static int HostCacheLookup( const char *node, const char *service,
+                            const struct addrinfo *p_hints,
+                            struct addrinfo **res )
+{
+    char ppsz_addr[HOST_CACHE_ADDRS][NI_MAXNUMERICHOST];
+    unsigned i_addrs = 0;
+
+    vlc_mutex_lock( &host_cache_lock );
+    host_cache_entry_t *e = HostCacheFind( node, p_hints );
+    if( e != NULL )
+    {
+        if( mdate() - e->i_date < HOST_CACHE_TTL )
+        {
+            i_addrs = e->i_addrs;
+            memcpy( ppsz_addr, e->ppsz_addr, sizeof( ppsz_addr ) );
+        }
+        else
+        {
+            free( e->psz_node );
+            e->psz_node = NULL;
+        }
+    }
+    vlc_mutex_unlock( &host_cache_lock );
+
+    struct addrinfo hints = *p_hints, *first = NULL, **pp_last = &first;
+    hints.ai_flags |= AI_NUMERICHOST;
+    for( unsigned i = 0; i < i_addrs; i++ )
+    {
+        struct addrinfo *ai;
+        if( getaddrinfo( ppsz_addr[i], service, &hints, &ai ) )
+            continue;
+        *pp_last = ai;
+        while( ai->ai_next != NULL )
+            ai = ai->ai_next;
+        pp_last = &ai->ai_next;
+    }
+
+    if( first == NULL )
+        return -1;
+    *res = first;
+    return 0;
+}
+
+static void HostCacheStore( const char *node, const struct addrinfo *hints,
+                            const struct addrinfo *res )
+{
+    host_cache_entry_t entry;
+    entry.i_addrs = 0;
+
+    for( const struct addrinfo *ai = res;
+         ai != NULL && entry.i_addrs < HOST_CACHE_ADDRS; ai = ai->ai_next )
+    {
+        char *psz_addr = entry.ppsz_addr[entry.i_addrs];
+        if( vlc_getnameinfo( ai->ai_addr, ai->ai_addrlen, psz_addr,
+                             NI_MAXNUMERICHOST, NULL, NI_NUMERICHOST ) )
+            continue;
+        /* the same address is listed once per socket type */
+        bool b_dup = false;
+        for( unsigned i = 0; i < entry.i_addrs && !b_dup; i++ )
+            b_dup = !strcmp( entry.ppsz_addr[i], psz_addr );
+        if( !b_dup )
+            entry.i_addrs++;
+    }
+    if( entry.i_addrs == 0 )
+        return;
+
+    entry.psz_node = strdup( node );
+    if( unlikely(entry.psz_node == NULL) )
+        return;
+    entry.i_family = hints->ai_family;
+    entry.i_socktype = hints->ai_socktype;
+    entry.i_protocol = hints->ai_protocol;
+    entry.i_flags = hints->ai_flags;
+    entry.i_date = mdate();
+
+    vlc_mutex_lock( &host_cache_lock );
+    host_cache_entry_t *e = HostCacheFind( node, hints );
+    if( e == NULL )
+    {
+        /* use a free slot, or evict the oldest one */
+        e = &host_cache[0];
+        for( unsigned i = 0; i < HOST_CACHE_SIZE; i++ )
+        {
+            if( host_cache[i].psz_node == NULL )
+            {
+                e = &host_cache[i];
+                break;
+            }
+            if( host_cache[i].i_date < e->i_date )
+                e = &host_cache[i];
+        }
+    }
+    free( e->psz_node );
+    *e = entry;
+    vlc_mutex_unlock( &host_cache_lock );
+}
+
+/**
+ * Forgets the cached addresses of a host, e.g. when none of them could be
+ * connected to.
+ */
+void vlc_getaddrinfo_Flush( const char *node )
+{
+    vlc_mutex_lock( &host_cache_lock );
+    for( unsigned i = 0; i < HOST_CACHE_SIZE; i++ )
+    {
+        host_cache_entry_t *e = &host_cache[i];
+        if( e->psz_node != NULL && !strcmp( e->psz_node, node ) )
+        {
+            free( e->psz_node );
+            e->psz_node = NULL;
+        }
+    }
+    vlc_mutex_unlock( &host_cache_lock );
+}
 
 /**
  * Resolves a host name to a list of socket addresses (like getaddrinfo()).
@@ -156,6 +313,14 @@ int vlc_getaddrinfo( vlc_object_t *p_this, const char *node,
             node = NULL;
     }
 
+    /* Host names lookups are cached, see HostCacheLookup() */
+    const char *psz_key = node;
+    const struct addrinfo key_hints = hints;
+    bool b_cache = node != NULL
+                && !(hints.ai_flags & (AI_PASSIVE|AI_NUMERICHOST|AI_CANONNAME));
+    if( b_cache && !HostCacheLookup( psz_key, psz_service, &hints, res ) )
+        return 0;
+
     int ret;
     node = ToLocale (node);
 #ifdef WIN32
@@ -187,6 +352,8 @@ int vlc_getaddrinfo( vlc_object_t *p_this, const char *node,
 out:
 #endif
     LocaleFree (node);
+    if( b_cache && ret == 0 )
+        HostCacheStore( psz_key, &key_hints, *res );
     return ret;
 }
 
@@ -52,6 +52,9 @@
 #endif
 
 #include <vlc_network.h>
+#if !defined(WIN32) && !defined(UNDER_CE)
+#   include <netinet/tcp.h> /* TCP_NODELAY */
+#endif
 
 #ifndef INADDR_ANY
 #   define INADDR_ANY  0x00000000
@@ -76,6 +79,75 @@
 extern int rootwrap_bind (int family, int socktype, int protocol,
                           const struct sockaddr *addr, size_t alen);
 
+/**
+ * Applies the socket tuning options (net-rcvbuf, net-sndbuf,
+ * net-tcp-nodelay, net-tcp-quickack, net-rcvlowat) to a new socket, before
+ * it is connected or bound. The options are inherited, so an access or an
+ * input item can override them.
+ * @param rcvbuf receive buffer size used when net-rcvbuf is not set (0 to
+ * keep the system default)
+ * @param sndbuf same for the send buffer size and net-sndbuf
+ */
+void net_SetSockOpts (vlc_object_t *obj, int fd, int socktype,
+                      int rcvbuf, int sndbuf)
+{
+    int val = var_InheritInteger (obj, "net-rcvbuf");
+    if (val > 0)
+        rcvbuf = val;
+    if (rcvbuf > 0)
+        setsockopt (fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof (rcvbuf));
+
+    val = var_InheritInteger (obj, "net-sndbuf");
+    if (val > 0)
+        sndbuf = val;
+    if (sndbuf > 0)
+        setsockopt (fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof (sndbuf));
+
+#ifdef SO_RCVLOWAT
+    val = var_InheritInteger (obj, "net-rcvlowat");
+    if (val > 0)
+        setsockopt (fd, SOL_SOCKET, SO_RCVLOWAT, &val, sizeof (val));
+#endif
+
+    if (socktype != SOCK_STREAM)
+        return;
+#ifdef TCP_NODELAY
+    if (var_InheritBool (obj, "net-tcp-nodelay"))
+        setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &(int){ 1 }, sizeof (int));
+#endif
+#ifdef TCP_QUICKACK
+    if (var_InheritBool (obj, "net-tcp-quickack"))
+        setsockopt (fd, IPPROTO_TCP, TCP_QUICKACK, &(int){ 1 }, sizeof (int));
+#endif
+}
+
+/**
+ * Logs the effective buffer sizes of a socket once it is set up, and
+ * publishes them to the input statistics (see stats_ComputeInputStats()).
+ */
+void net_ReportSockOpts (vlc_object_t *obj, int fd)
+{
+    int rcvbuf = 0, sndbuf = 0;
+
+    getsockopt (fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf,
+                &(socklen_t){ sizeof (rcvbuf) });
+    getsockopt (fd, SOL_SOCKET, SO_SNDBUF, &sndbuf,
+                &(socklen_t){ sizeof (sndbuf) });
+    msg_Dbg (obj, "socket %d buffers: receive %d bytes, send %d bytes",
+             fd, rcvbuf, sndbuf);
+
+    for (vlc_object_t *p = obj; p != NULL; p = p->p_parent)
+    {
+        if (strcmp (p->psz_object_type, "input"))
+            continue;
+        var_Create (p, "sock-rcvbuf", VLC_VAR_INTEGER);
+        var_SetInteger (p, "sock-rcvbuf", rcvbuf);
+        var_Create (p, "sock-sndbuf", VLC_VAR_INTEGER);
+        var_SetInteger (p, "sock-sndbuf", sndbuf);
+        break;
+    }
+}
+
 int net_Socket (vlc_object_t *p_this, int family, int socktype,
                 int protocol)
 {
@@ -521,6 +593,281 @@ char *net_Gets( vlc_object_t *p_this, int fd, const v_socket_t *p_vs )
     return psz_line;
 }
 
+/*
+ * Buffered reader: reads ahead from the socket, so that line based
+ * protocols do not need a poll() and a read() for every byte.
+ */
+#define NET_READER_SIZE 4096
+
+struct net_reader_t
+{
+    int fd;
+    const v_socket_t *p_vs;
+    signed char i_quickack; /* net-tcp-quickack, -1 until the first read */
+    size_t i_begin;
+    size_t i_end;
+    uint8_t p_buffer[NET_READER_SIZE];
+};
+
+/**
+ * Creates a buffered reader on a connected socket.
+ * The reader does not own the socket, nor the virtual socket.
+ */
+net_reader_t *net_ReaderNew( int fd, const v_socket_t *p_vs )
+{
+    net_reader_t *p_reader = malloc( sizeof( *p_reader ) );
+    if( unlikely(p_reader == NULL) )
+        return NULL;
+    p_reader->fd = fd;
+    p_reader->p_vs = p_vs;
+    p_reader->i_quickack = -1;
+    p_reader->i_begin = p_reader->i_end = 0;
+    return p_reader;
+}
+
+void net_ReaderDelete( net_reader_t *p_reader )
+{
+    free( p_reader );
+}
+
+/**
+ * @return the number of bytes received from the socket but not read yet.
+ */
+size_t net_ReaderPending( const net_reader_t *p_reader )
+{
+    return p_reader->i_end - p_reader->i_begin;
+}
+
+/**
+ * Reads from the socket of a reader. Linux leaves the quick ACK mode on its
+ * own after a delayed ACK decision, so TCP_QUICKACK is set again after every
+ * receive when net-tcp-quickack is enabled.
+ */
+static ssize_t net_ReaderRecv( vlc_object_t *p_this, net_reader_t *p_reader,
+                               void *p_data, size_t i_data )
+{
+    ssize_t i_ret = net_Read( p_this, p_reader->fd, p_reader->p_vs,
+                              p_data, i_data, false );
+#ifdef TCP_QUICKACK
+    if( p_reader->i_quickack < 0 )
+        p_reader->i_quickack = var_InheritBool( p_this, "net-tcp-quickack" );
+    if( p_reader->i_quickack > 0 && i_ret > 0 )
+        setsockopt( p_reader->fd, IPPROTO_TCP, TCP_QUICKACK,
+                    &(int){ 1 }, sizeof (int) );
+#endif
+    return i_ret;
+}
+
+static ssize_t net_ReaderFill( vlc_object_t *p_this, net_reader_t *p_reader )
+{
+    assert( p_reader->i_begin == p_reader->i_end );
+    ssize_t i_ret = net_ReaderRecv( p_this, p_reader,
+                                    p_reader->p_buffer, NET_READER_SIZE );
+    p_reader->i_begin = 0;
+    p_reader->i_end = i_ret > 0 ? i_ret : 0;
+    return i_ret;
+}
+
+#undef net_ReaderRead
+/**
+ * Reads from a buffered reader, with the same semantics as net_Read().
+ * Large reads bypass the buffer once it is drained.
+ */
+ssize_t net_ReaderRead( vlc_object_t *p_this, net_reader_t *p_reader,
+                        void *restrict p_data, size_t i_data, bool waitall )
+{
+    size_t i_total = 0;
+
+    while( i_data > 0 )
+    {
+        size_t i_pending = net_ReaderPending( p_reader );
+        if( i_pending > 0 )
+        {
+            size_t i_copy = __MIN( i_pending, i_data );
+            memcpy( p_data, &p_reader->p_buffer[p_reader->i_begin], i_copy );
+            p_reader->i_begin += i_copy;
+            p_data = (uint8_t *)p_data + i_copy;
+            i_data -= i_copy;
+            i_total += i_copy;
+        }
+        else
+        {
+            ssize_t i_read;
+            const bool b_direct = i_data >= NET_READER_SIZE;
+            if( b_direct )
+            {
+                i_read = net_ReaderRecv( p_this, p_reader, p_data, i_data );
+                if( i_read > 0 )
+                {
+                    p_data = (uint8_t *)p_data + i_read;
+                    i_data -= i_read;
+                    i_total += i_read;
+                }
+            }
+            else
+                i_read = net_ReaderFill( p_this, p_reader );
+
+            if( i_read < 0 )
+                return i_total > 0 ? (ssize_t)i_total : -1;
+            if( i_read == 0 )
+                break; /* EOF */
+            if( b_direct && !waitall )
+                break;
+            continue;
+        }
+
+        if( !waitall )
+            break;
+    }
+    return i_total;
+}
+
+#undef net_ReaderGets
+/**
+ * Reads a line from a buffered reader, see net_Gets().
+ */
+char *net_ReaderGets( vlc_object_t *p_this, net_reader_t *p_reader )
+{
+    char *psz_line = NULL;
+    size_t i_line = 0;
+
+    for( ;; )
+    {
+        if( net_ReaderPending( p_reader ) == 0
+         && net_ReaderFill( p_this, p_reader ) <= 0 )
+        {
+            if( i_line == 0 )
+            {
+                free( psz_line );
+                return NULL;
+            }
+            break;
+        }
+
+        const uint8_t *p = &p_reader->p_buffer[p_reader->i_begin];
+        size_t i_pending = net_ReaderPending( p_reader );
+        const uint8_t *p_eol = memchr( p, '\n', i_pending );
+        size_t i_copy = p_eol ? (size_t)(p_eol - p) : i_pending;
+
+        psz_line = xrealloc( psz_line, i_line + i_copy + 1 );
+        memcpy( &psz_line[i_line], p, i_copy );
+        i_line += i_copy;
+        p_reader->i_begin += i_copy;
+        if( p_eol )
+        {
+            p_reader->i_begin++;
+            break;
+        }
+    }
+
+    if( i_line > 0 && psz_line[i_line - 1] == '\r' )
+        i_line--;
+    psz_line[i_line] = '\0';
+    return psz_line;
+}
+
+/*
+ * Message buffer: protocol requests are assembled in memory, and sent with
+ * one net_Write() instead of one per header line.
+ */
+void net_BufferInit( net_buffer_t *p_buf )
+{
+    p_buf->psz_data = NULL;
+    p_buf->i_length = 0;
+    p_buf->i_size = 0;
+    p_buf->b_error = false;
+}
+
+void net_BufferClean( net_buffer_t *p_buf )
+{
+    free( p_buf->psz_data );
+    net_BufferInit( p_buf );
+}
+
+static bool net_BufferReserve( net_buffer_t *p_buf, size_t i_data )
+{
+    /* keep room for the nul terminator */
+    if( p_buf->i_length + i_data < p_buf->i_size )
+        return true;
+
+    size_t i_size = __MAX( 2 * p_buf->i_size, 512 );
+    while( i_size <= p_buf->i_length + i_data )
+        i_size *= 2;
+
+    char *psz_data = realloc( p_buf->psz_data, i_size );
+    if( unlikely(psz_data == NULL) )
+    {
+        p_buf->b_error = true;
+        return false;
+    }
+    p_buf->psz_data = psz_data;
+    p_buf->i_size = i_size;
+    return true;
+}
+
+void net_BufferAppend( net_buffer_t *p_buf, const void *p_data, size_t i_data )
+{
+    if( p_buf->b_error || !net_BufferReserve( p_buf, i_data ) )
+        return;
+    memcpy( &p_buf->psz_data[p_buf->i_length], p_data, i_data );
+    p_buf->i_length += i_data;
+    p_buf->psz_data[p_buf->i_length] = '\0';
+}
+
+void net_BufferPrintf( net_buffer_t *p_buf, const char *psz_fmt, ... )
+{
+    va_list args;
+
+    if( p_buf->b_error )
+        return;
+
+    for( size_t i_room = 128;; )
+    {
+        if( !net_BufferReserve( p_buf, i_room ) )
+            return;
+        i_room = p_buf->i_size - p_buf->i_length;
+
+        va_start( args, psz_fmt );
+        int i_len = vsnprintf( &p_buf->psz_data[p_buf->i_length], i_room,
+                               psz_fmt, args );
+        va_end( args );
+
+        if( i_len < 0 )
+        {
+            p_buf->b_error = true;
+            return;
+        }
+        if( (size_t)i_len < i_room )
+        {
+            p_buf->i_length += i_len;
+            return;
+        }
+        i_room = i_len + 1;
+    }
+}
+
+#undef net_BufferSend
+/**
+ * Sends the whole buffer, then empties it.
+ *
+ * @return the number of bytes sent, or -1 if the buffer could not be
+ * assembled or sent completely.
+ */
+ssize_t net_BufferSend( vlc_object_t *p_this, int fd, const v_socket_t *p_vs,
+                        net_buffer_t *p_buf )
+{
+    ssize_t i_ret = -1;
+
+    if( !p_buf->b_error )
+    {
+        i_ret = net_Write( p_this, fd, p_vs, p_buf->psz_data, p_buf->i_length );
+        if( i_ret < (ssize_t)p_buf->i_length )
+            i_ret = -1;
+    }
+    net_BufferClean( p_buf );
+    return i_ret;
+}
+
 #undef net_Printf
 ssize_t net_Printf( vlc_object_t *p_this, int fd, const v_socket_t *p_vs,
                     const char *psz_fmt, ... )
@@ -62,8 +62,16 @@ static int SocksHandshakeTCP( vlc_object_t *,
                               int fd, int i_socks_version,
                               const char *psz_user, const char *psz_passwd,
                               const char *psz_host, int i_port );
+
+/* Parallel connection attempts, see net_Connect() */
+#define CONNECT_MAX   4
+#define CONNECT_DELAY 250 /* ms */
+
 extern int net_Socket( vlc_object_t *p_this, int i_family, int i_socktype,
                        int i_protocol );
+extern void net_SetSockOpts( vlc_object_t *p_this, int fd, int i_socktype,
+                             int i_rcvbuf, int i_sndbuf );
+extern void net_ReportSockOpts( vlc_object_t *p_this, int fd );
 
 #undef net_Connect
 /*****************************************************************************
@@ -138,12 +146,11 @@ int net_Connect( vlc_object_t *p_this, const char *psz_host, int i_port,
     }
 
     i_val = vlc_getaddrinfo( p_this, psz_realhost, i_realport, &hints, &res );
-    free( psz_socks );
-
     if( i_val )
     {
         msg_Err( p_this, "cannot resolve %s port %d : %s", psz_realhost,
                  i_realport, gai_strerror( i_val ) );
+        free( psz_socks );
         return -1;
     }
 
@@ -151,72 +158,126 @@ int net_Connect( vlc_object_t *p_this, const char *psz_host, int i_port,
     if (timeout < 0)
         timeout = -1;
 
-    for( ptr = res; ptr != NULL; ptr = ptr->ai_next )
+    /*
+     * Candidates are raced: a new connection attempt is started every
+     * CONNECT_DELAY ms while none has completed, and the first one that
+     * succeeds wins. Each attempt may last up to the timeout.
+     */
+    struct pollfd ufd[1 + CONNECT_MAX];
+    unsigned n = 0;
+    mtime_t deadline = 0;
+
+    ufd[0].fd = evfd;
+    ufd[0].events = POLLIN;
+    ptr = res;
+
+    while( i_handle == -1 )
     {
-        int fd = net_Socket( p_this, ptr->ai_family,
-                             ptr->ai_socktype, ptr->ai_protocol );
-        if( fd == -1 )
+        if( ptr != NULL && n < CONNECT_MAX )
         {
-            msg_Dbg( p_this, "socket error: %m" );
-            continue;
-        }
+            const struct addrinfo *ai = ptr;
+            ptr = ptr->ai_next;
 
-        if( connect( fd, ptr->ai_addr, ptr->ai_addrlen ) )
-        {
-            int val;
+            int fd = net_Socket( p_this, ai->ai_family,
+                                 ai->ai_socktype, ai->ai_protocol );
+            if( fd == -1 )
+            {
+                msg_Dbg( p_this, "socket error: %m" );
+                continue;
+            }
+            net_SetSockOpts( p_this, fd, ai->ai_socktype, 0, 0 );
 
+            if( connect( fd, ai->ai_addr, ai->ai_addrlen ) == 0 )
+            {
+                i_handle = fd;
+                break;
+            }
             if( net_errno != EINPROGRESS && net_errno != EINTR )
             {
                 msg_Err( p_this, "connection failed: %m" );
-                goto next_ai;
+                net_Close( fd );
+                continue;
             }
 
-            struct pollfd ufd[2] = {
-                { .fd = fd,   .events = POLLOUT },
-                { .fd = evfd, .events = POLLIN },
-            };
+            n++;
+            ufd[n].fd = fd;
+            ufd[n].events = POLLOUT;
+            deadline = mdate() + timeout * INT64_C(1000);
+        }
 
-            do
-                /* NOTE: timeout screwed up if we catch a signal (EINTR) */
-                val = poll (ufd, sizeof (ufd) / sizeof (ufd[0]), timeout);
-            while ((val == -1) && (net_errno == EINTR));
+        if( n == 0 )
+        {
+            if( ptr == NULL )
+                break; /* no candidates left */
+            continue;
+        }
 
-            switch (val)
+        /* wait for an attempt to complete, or until the next one is due */
+        int delay = (ptr != NULL && n < CONNECT_MAX) ? CONNECT_DELAY : -1;
+        if( timeout >= 0 )
+        {
+            mtime_t left = (deadline - mdate()) / 1000;
+            if( left <= 0 )
             {
-                 case -1: /* error */
-                     msg_Err (p_this, "connection polling error: %m");
-                     goto next_ai;
+                msg_Warn( p_this, "connection timed out" );
+                break;
+            }
+            if( delay == -1 || delay > left )
+                delay = left;
+        }
 
-                 case 0: /* timeout */
-                     msg_Warn (p_this, "connection timed out");
-                     goto next_ai;
+        for( unsigned i = 0; i <= n; i++ )
+            ufd[i].revents = 0;
+        if( poll( ufd, 1 + n, delay ) == -1 )
+        {
+            if( net_errno == EINTR )
+                continue;
+            msg_Err( p_this, "connection polling error: %m" );
+            break;
+        }
+        if( ufd[0].revents )
+            break; /* LibVLC object killed */
 
-                 default: /* something happended */
-                     if (ufd[1].revents)
-                         goto next_ai; /* LibVLC object killed */
+        for( unsigned i = 1; i <= n; )
+        {
+            if( !ufd[i].revents )
+            {
+                i++;
+                continue;
             }
 
             /* There is NO WAY around checking SO_ERROR.
              * Don't ifdef it out!!! */
-            if (getsockopt (fd, SOL_SOCKET, SO_ERROR, &val,
+            int val;
+            if (getsockopt (ufd[i].fd, SOL_SOCKET, SO_ERROR, &val,
                             &(socklen_t){ sizeof (val) }) || val)
             {
                 errno = val;
                 msg_Err (p_this, "connection failed: %m");
-                goto next_ai;
+                net_Close( ufd[i].fd );
             }
+            else if( i_handle == -1 )
+                i_handle = ufd[i].fd; /* success! */
+            else
+                net_Close( ufd[i].fd ); /* late winner */
+            ufd[i] = ufd[n--];
         }
+    }
 
-        msg_Dbg( p_this, "connection succeeded (socket = %d)", fd );
-        i_handle = fd; /* success! */
-        break;
+    /* abort the attempts that lost the race */
+    for( unsigned i = 1; i <= n; i++ )
+        net_Close( ufd[i].fd );
 
-next_ai: /* failure */
-        net_Close( fd );
-        continue;
+    if( i_handle != -1 )
+    {
+        msg_Dbg( p_this, "connection succeeded (socket = %d)", i_handle );
+        net_ReportSockOpts( p_this, i_handle );
     }
+    else
+        vlc_getaddrinfo_Flush( psz_realhost );
 
     freeaddrinfo( res );
+    free( psz_socks );
 
     if( i_handle == -1 )
         return -1;
@@ -91,6 +91,9 @@
 
 extern int net_Socket( vlc_object_t *p_this, int i_family, int i_socktype,
                        int i_protocol );
+extern void net_SetSockOpts( vlc_object_t *p_this, int fd, int i_socktype,
+                             int i_rcvbuf, int i_sndbuf );
+extern void net_ReportSockOpts( vlc_object_t *p_this, int fd );
 
 /* */
 static int net_SetupDgramSocket( vlc_object_t *p_obj, int fd, const struct addrinfo *ptr )
@@ -99,14 +102,9 @@ static int net_SetupDgramSocket( vlc_object_t *p_obj, int fd, const struct addri
     setsockopt (fd, SOL_SOCKET, SO_REUSEPORT, &(int){ 1 }, sizeof (int));
 #endif
 
-#ifdef SO_RCVBUF
     /* Increase the receive buffer size to 1/2MB (8Mb/s during 1/2s)
      * to avoid packet loss caused in case of scheduling hiccups */
-    setsockopt (fd, SOL_SOCKET, SO_RCVBUF,
-                (void *)&(int){ 0x80000 }, sizeof (int));
-    setsockopt (fd, SOL_SOCKET, SO_SNDBUF,
-                (void *)&(int){ 0x80000 }, sizeof (int));
-#endif
+    net_SetSockOpts (p_obj, fd, SOCK_DGRAM, 0x80000, 0x80000);
 
 #if defined (WIN32) || defined (UNDER_CE)
     if (net_SockAddrIsMulticast (ptr->ai_addr, ptr->ai_addrlen)
@@ -129,6 +127,7 @@ static int net_SetupDgramSocket( vlc_object_t *p_obj, int fd, const struct addri
         net_Close (fd);
         return -1;
     }
+    net_ReportSockOpts (p_obj, fd);
     return fd;
 }
 
@@ -680,8 +679,7 @@ int net_ConnectDgram( vlc_object_t *p_this, const char *psz_host, int i_port,
 
         /* Increase the receive buffer size to 1/2MB (8Mb/s during 1/2s)
         * to avoid packet loss caused by scheduling problems */
-        setsockopt (fd, SOL_SOCKET, SO_RCVBUF, &(int){ 0x80000 }, sizeof (int));
-        setsockopt (fd, SOL_SOCKET, SO_SNDBUF, &(int){ 0x80000 }, sizeof (int));
+        net_SetSockOpts (p_this, fd, SOCK_DGRAM, 0x80000, 0x80000);
 
         /* Allow broadcast sending */
         setsockopt (fd, SOL_SOCKET, SO_BROADCAST, &(int){ 1 }, sizeof (int));
@@ -736,6 +734,7 @@ int net_ConnectDgram( vlc_object_t *p_this, const char *psz_host, int i_port,
         return -1;
     }
 
+    net_ReportSockOpts (p_this, i_handle);
     return i_handle;
 }
 
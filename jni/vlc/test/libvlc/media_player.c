@@ -23,6 +23,9 @@
 
 #include "test.h"
 
+#include <pthread.h>
+#include <string.h>
+
 static void wait_playing(libvlc_media_player_t *mp)
 {
     libvlc_state_t state;
@@ -169,6 +172,70 @@ static void test_media_player_pause_stop(const char** argv, int argc)
     libvlc_release (vlc);
 }
 
+/* Writes null transport stream packets for a while, then stalls (without
+ * closing the pipe) until the test ends */
+static void *ts_writer (void *data)
+{
+    int fd = *(int *)data;
+    unsigned char pkt[188];
+
+    memset (pkt, 0xff, sizeof (pkt));
+    pkt[0] = 0x47;
+    pkt[1] = 0x1f;
+    pkt[2] = 0xff;
+    pkt[3] = 0x10;
+
+    for (int i = 0; i < 100; i++)
+    {
+        if (write (fd, pkt, sizeof (pkt)) != sizeof (pkt))
+            break;
+        usleep (10000);
+    }
+    return NULL;
+}
+
+static void test_media_player_standby_stop(const char** argv, int argc)
+{
+    libvlc_instance_t *vlc;
+    libvlc_media_t *md;
+    libvlc_media_player_t *mi;
+    pthread_t writer;
+    char mrl[32];
+    int fds[2];
+
+    log ("Testing stop of a promoted standby input during a stalled read\n");
+
+    assert (pipe (fds) == 0);
+    assert (pthread_create (&writer, NULL, ts_writer, &fds[1]) == 0);
+    snprintf (mrl, sizeof (mrl), "fd://%d", fds[0]);
+
+    vlc = libvlc_new (argc, argv);
+    assert (vlc != NULL);
+
+    md = libvlc_media_new_location (vlc, mrl);
+    assert (md != NULL);
+
+    mi = libvlc_media_player_new (vlc);
+    assert (mi != NULL);
+
+    /* Promote the standby while the data flow */
+    assert (libvlc_media_player_set_standby (mi, 0, md) == 0);
+    usleep (300000);
+    assert (libvlc_media_player_switch_media (mi, md) == 0);
+    libvlc_media_release (md);
+
+    /* Stop once the writer stalled: the read of the promoted access must
+     * be interrupted (test_init() makes a hang fail) */
+    pthread_join (writer, NULL);
+    usleep (200000);
+    libvlc_media_player_stop (mi);
+
+    libvlc_media_player_release (mi);
+    libvlc_release (vlc);
+    close (fds[1]);
+    close (fds[0]);
+}
+
 
 int main (void)
 {
@@ -177,6 +244,7 @@ int main (void)
     test_media_player_set_media (test_defaults_args, test_defaults_nargs);
     test_media_player_play_stop (test_defaults_args, test_defaults_nargs);
     test_media_player_pause_stop (test_defaults_args, test_defaults_nargs);
+    test_media_player_standby_stop (test_defaults_args, test_defaults_nargs);
 
     return 0;
 }
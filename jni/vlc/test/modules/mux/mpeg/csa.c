@@ -0,0 +1,273 @@
+/*****************************************************************************
+ * csa.c: test for the CSA descrambler
+ *****************************************************************************
+ * Copyright (C) 2012 the VideoLAN team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../../libvlc/test.h"
+#include <../src/control/libvlc_internal.h>
+
+#include <vlc_common.h>
+
+#include "../../../../modules/mux/mpeg/csa.h"
+
+#define PACKETS 1000
+
+/* Known answers: clear packets and their scrambled versions, as produced by
+ * the reference csa_Encrypt(), with the odd key 0123456789abcdef and the
+ * even key 1122334455667788 */
+static void fill_clear( uint8_t *p, bool b_adaptation )
+{
+    int i = 4;
+
+    p[0] = 0x47; p[1] = 0x01; p[2] = 0x00; p[3] = 0x10;
+    if( b_adaptation )
+    {
+        p[3] |= 0x20;
+        p[4] = 7;
+        p[5] = 0x10;
+        for( i = 6; i < 12; i++ )
+            p[i] = i;
+    }
+    for( ; i < 188; i++ )
+        p[i] = (i * 7 + 3) & 0xff;
+}
+
+static const uint8_t p_even_scrambled[188] =
+{
+    0x47, 0x01, 0x00, 0x90, 0xcb, 0x17, 0x44, 0xdc, 0xeb, 0x4b, 0xa9, 0x88,
+    0x5c, 0xe4, 0x20, 0x8a, 0x68, 0xdf, 0x2f, 0x92, 0x28, 0x5e, 0x26, 0x97,
+    0x79, 0xe2, 0xf8, 0x50, 0x48, 0x2f, 0xe4, 0x4e, 0xdc, 0x52, 0x0a, 0xdf,
+    0x64, 0xc3, 0x09, 0xb7, 0x78, 0x3c, 0xdd, 0x94, 0x70, 0xb7, 0xea, 0xf8,
+    0x31, 0x81, 0xdf, 0xba, 0x3e, 0x7d, 0x88, 0x04, 0x03, 0xfe, 0xb1, 0xa5,
+    0xf1, 0x31, 0xa6, 0xd8, 0x33, 0xe5, 0x9a, 0xac, 0x2e, 0xac, 0xcd, 0x4f,
+    0x94, 0x77, 0xbd, 0xb1, 0x4e, 0x5a, 0x38, 0x94, 0x36, 0x7f, 0x16, 0x2c,
+    0x26, 0xb7, 0xcd, 0xd7, 0x43, 0xd7, 0x4d, 0x7f, 0xa1, 0x54, 0x01, 0x86,
+    0x2e, 0xae, 0x82, 0x28, 0x2d, 0x9a, 0xde, 0x83, 0x5a, 0x41, 0xe5, 0xab,
+    0xa3, 0xb3, 0xb2, 0x01, 0xef, 0x31, 0xc3, 0xc9, 0xba, 0xed, 0x86, 0x7e,
+    0x88, 0x69, 0xf5, 0x88, 0x83, 0x82, 0x1d, 0x51, 0xc0, 0x3c, 0x84, 0xbd,
+    0x9e, 0x00, 0xa0, 0x97, 0x6f, 0x78, 0xe0, 0x8f, 0x2d, 0x1d, 0xe1, 0x61,
+    0x5e, 0x6a, 0x6a, 0x03, 0xef, 0xa8, 0x28, 0xcb, 0xb7, 0x5b, 0x6a, 0xf1,
+    0xac, 0x3e, 0x9e, 0x0d, 0x2f, 0xa0, 0x8e, 0x2c, 0x5b, 0xf9, 0x4c, 0xd4,
+    0x34, 0x8c, 0x6a, 0x78, 0xf0, 0x48, 0xbc, 0xd7, 0xda, 0x60, 0x88, 0x50,
+    0x64, 0x08, 0xa1, 0x82, 0x95, 0x03, 0xd0, 0xe4,
+};
+static const uint8_t p_odd_scrambled[188] =
+{
+    0x47, 0x01, 0x00, 0xf0, 0x07, 0x10, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b,
+    0x96, 0x0b, 0x37, 0xe5, 0x62, 0x4a, 0x7b, 0x97, 0xb0, 0xf8, 0x31, 0x61,
+    0x7e, 0x9c, 0x72, 0xcb, 0x36, 0xee, 0x72, 0xbe, 0x3c, 0xe4, 0x18, 0x8e,
+    0xbb, 0x82, 0xf6, 0x23, 0x24, 0x4b, 0x9d, 0xfc, 0xf1, 0x34, 0xcd, 0x6c,
+    0xc6, 0xf5, 0x2d, 0x9a, 0x89, 0x0e, 0xb2, 0x58, 0x90, 0xb0, 0x54, 0x10,
+    0xfa, 0xb7, 0x05, 0x66, 0xb5, 0x1f, 0x1f, 0xf6, 0x84, 0xf7, 0x27, 0x03,
+    0xd3, 0x2b, 0x02, 0xfb, 0x5c, 0x63, 0x68, 0xa3, 0x4a, 0xdf, 0x47, 0x2c,
+    0x9b, 0xfd, 0xbc, 0xa8, 0x38, 0x13, 0x76, 0xad, 0x26, 0xa6, 0xeb, 0x8a,
+    0x16, 0xec, 0x0e, 0x3b, 0xd1, 0x89, 0x0f, 0x34, 0x24, 0xfc, 0x4c, 0xdb,
+    0xcf, 0x86, 0x32, 0xf8, 0x3f, 0x37, 0xac, 0xab, 0x3f, 0x17, 0xe2, 0xcd,
+    0x26, 0x30, 0x82, 0x1c, 0x11, 0x0a, 0x86, 0x3f, 0x30, 0x4f, 0x55, 0x27,
+    0x7f, 0x34, 0xc4, 0x34, 0xdc, 0x4a, 0xc9, 0x86, 0x8a, 0xe4, 0x5d, 0xd8,
+    0xec, 0x7b, 0x2f, 0x2b, 0x3c, 0x5b, 0x96, 0xaf, 0xd4, 0x22, 0xe9, 0x75,
+    0x9d, 0xc5, 0x14, 0x42, 0xc2, 0xbb, 0x87, 0xe7, 0xd6, 0xd1, 0x56, 0xc9,
+    0x2f, 0x3d, 0xfb, 0xbe, 0x73, 0xef, 0xe2, 0xf3, 0x79, 0x2a, 0x70, 0x52,
+    0x38, 0xad, 0x39, 0xcb, 0xdb, 0x12, 0xb9, 0xcd,
+};
+
+static csa_t *create_csa( vlc_object_t *p_obj )
+{
+    char psz_odd[] = "0x0123456789abcdef";
+    char psz_even[] = "0x1122334455667788";
+    csa_t *c = csa_New();
+
+    assert( c != NULL );
+    int i_ret = csa_SetCW( p_obj, c, psz_odd, true );
+    assert( i_ret == VLC_SUCCESS );
+    i_ret = csa_SetCW( p_obj, c, psz_even, false );
+    assert( i_ret == VLC_SUCCESS );
+    return c;
+}
+
+static void test_known_answers( vlc_object_t *p_obj )
+{
+    csa_t *c = create_csa( p_obj );
+    uint8_t *p_data = malloc( PACKETS * 188 );
+    uint8_t *pp_pkt[PACKETS];
+    uint8_t clear[2][188], pkt[188];
+
+    assert( p_data != NULL );
+    fill_clear( clear[0], false );
+    fill_clear( clear[1], true );
+
+    /* Reference path */
+    memcpy( pkt, clear[0], 188 );
+    csa_UseKey( p_obj, c, false );
+    csa_Encrypt( c, pkt, 188 );
+    assert( !memcmp( pkt, p_even_scrambled, 188 ) );
+    csa_Decrypt( c, pkt, 188 );
+    assert( !memcmp( pkt, clear[0], 188 ) );
+
+    memcpy( pkt, clear[1], 188 );
+    csa_UseKey( p_obj, c, true );
+    csa_Encrypt( c, pkt, 188 );
+    assert( !memcmp( pkt, p_odd_scrambled, 188 ) );
+    csa_Decrypt( c, pkt, 188 );
+    assert( !memcmp( pkt, clear[1], 188 ) );
+
+    /* Batch path, with odd and even packets interleaved and every batch
+     * size up to PACKETS */
+    for( int i_count = 1; i_count <= PACKETS; i_count += i_count / 4 + 1 )
+    {
+        for( int i = 0; i < i_count; i++ )
+        {
+            pp_pkt[i] = &p_data[188 * i];
+            memcpy( pp_pkt[i], (i % 3) ? p_even_scrambled : p_odd_scrambled, 188 );
+        }
+        csa_DecryptBatch( c, pp_pkt, i_count, 188 );
+        for( int i = 0; i < i_count; i++ )
+            assert( !memcmp( pp_pkt[i], clear[(i % 3) ? 0 : 1], 188 ) );
+    }
+
+    free( p_data );
+    csa_Delete( c );
+}
+
+/* Random keys, adaptation fields and partial descrambling, checked against
+ * the reference code */
+static void test_random( vlc_object_t *p_obj )
+{
+    csa_t *c = csa_New();
+    uint8_t *p_ref = malloc( PACKETS * 188 );
+    uint8_t *p_data = malloc( PACKETS * 188 );
+    uint8_t *pp_pkt[PACKETS];
+
+    assert( c != NULL && p_ref != NULL && p_data != NULL );
+
+    for( int i_run = 0; i_run < 50; i_run++ )
+    {
+        char psz_odd[17], psz_even[17];
+        const int i_pkt_size = (i_run % 4) ? 188 : 4 + rand() % 185;
+        const int i_count = 1 + rand() % PACKETS;
+
+        for( int i = 0; i < 16; i++ )
+        {
+            psz_odd[i] = "0123456789abcdef"[rand() % 16];
+            psz_even[i] = "0123456789abcdef"[rand() % 16];
+        }
+        psz_odd[16] = psz_even[16] = '\0';
+        csa_SetCW( p_obj, c, psz_odd, true );
+        csa_SetCW( p_obj, c, psz_even, false );
+
+        for( int i = 0; i < i_count; i++ )
+        {
+            uint8_t *p = &p_ref[188 * i];
+
+            for( int j = 0; j < 188; j++ )
+                p[j] = rand();
+            p[0] = 0x47;
+            p[3] = 0x10;
+            if( rand() % 3 == 0 )
+            {
+                p[3] |= 0x20;
+                p[4] = (rand() % 4) ? rand() % 20 : rand() % 184;
+            }
+            if( rand() % 5 )
+            {
+                csa_UseKey( p_obj, c, rand() % 2 );
+                csa_Encrypt( c, p, i_pkt_size );
+            }
+        }
+
+        memcpy( p_data, p_ref, 188 * i_count );
+        for( int i = 0; i < i_count; i++ )
+        {
+            csa_Decrypt( c, &p_ref[188 * i], i_pkt_size );
+            pp_pkt[i] = &p_data[188 * i];
+        }
+        csa_DecryptBatch( c, pp_pkt, i_count, i_pkt_size );
+        assert( !memcmp( p_data, p_ref, 188 * i_count ) );
+    }
+
+    free( p_data );
+    free( p_ref );
+    csa_Delete( c );
+}
+
+static void test_throughput( vlc_object_t *p_obj )
+{
+    csa_t *c = create_csa( p_obj );
+    uint8_t *p_ref = malloc( PACKETS * 188 );
+    uint8_t *p_data = malloc( PACKETS * 188 );
+    uint8_t *pp_pkt[PACKETS];
+    mtime_t i_scalar = 0, i_batch = 0;
+
+    assert( p_ref != NULL && p_data != NULL );
+    for( int i = 0; i < PACKETS; i++ )
+        memcpy( &p_ref[188 * i], (i % 2) ? p_even_scrambled : p_odd_scrambled, 188 );
+
+    for( int i_run = 0; i_run < 10; i_run++ )
+    {
+        mtime_t i_start;
+
+        memcpy( p_data, p_ref, PACKETS * 188 );
+        i_start = mdate();
+        for( int i = 0; i < PACKETS; i++ )
+            csa_Decrypt( c, &p_data[188 * i], 188 );
+        i_scalar += mdate() - i_start;
+
+        memcpy( p_data, p_ref, PACKETS * 188 );
+        for( int i = 0; i < PACKETS; i++ )
+            pp_pkt[i] = &p_data[188 * i];
+        i_start = mdate();
+        csa_DecryptBatch( c, pp_pkt, PACKETS, 188 );
+        i_batch += mdate() - i_start;
+    }
+
+    log( "reference: %"PRId64" kB/s, batch: %"PRId64" kB/s\n",
+         INT64_C(10) * PACKETS * 188 * CLOCK_FREQ / 1024 / __MAX( i_scalar, 1 ),
+         INT64_C(10) * PACKETS * 188 * CLOCK_FREQ / 1024 / __MAX( i_batch, 1 ) );
+
+    free( p_data );
+    free( p_ref );
+    csa_Delete( c );
+}
+
+int main( void )
+{
+    libvlc_instance_t *p_vlc;
+    vlc_object_t *p_obj;
+
+    test_init();
+
+    p_vlc = libvlc_new( test_defaults_nargs, test_defaults_args );
+    assert( p_vlc != NULL );
+    p_obj = VLC_OBJECT( p_vlc->p_libvlc_int );
+
+    log( "Testing CSA known answers\n" );
+    test_known_answers( p_obj );
+
+    log( "Testing CSA batch against the reference\n" );
+    test_random( p_obj );
+
+    log( "Testing CSA throughput\n" );
+    test_throughput( p_obj );
+
+    libvlc_release( p_vlc );
+
+    return 0;
+}
@@ -0,0 +1,95 @@
+/*****************************************************************************
+ * stream.c: test for the stream cache
+ *****************************************************************************
+ * Copyright (C) 2011 the VideoLAN team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <string.h>
+
+#include "../../libvlc/test.h"
+#include <../src/control/libvlc_internal.h>
+
+#include <vlc_stream.h>
+#include <vlc_block.h>
+
+#define TEST_SIZE 16384
+
+static uint8_t p_data[TEST_SIZE];
+
+/* Seeks back into the cache of a non seekable access (a pipe) after some of
+ * the cached data were handed out by stream_Block() and modified */
+static void test_backward_seek( libvlc_int_t *p_libvlc )
+{
+    uint8_t p_read[TEST_SIZE];
+    char psz_url[32];
+    int fds[2];
+
+    for( int i = 0; i < TEST_SIZE; i++ )
+        p_data[i] = i * 7;
+
+    assert( pipe( fds ) == 0 );
+    assert( write( fds[1], p_data, TEST_SIZE ) == TEST_SIZE );
+    close( fds[1] );
+
+    snprintf( psz_url, sizeof(psz_url), "fd://%d", fds[0] );
+    stream_t *s = stream_UrlNew( p_libvlc, psz_url );
+    assert( s != NULL );
+
+    bool b_seek;
+    stream_Control( s, STREAM_CAN_SEEK, &b_seek );
+    assert( !b_seek );
+
+    assert( stream_Read( s, p_read, 1000 ) == 1000 );
+    assert( !memcmp( p_read, p_data, 1000 ) );
+
+    block_t *p_block = stream_Block( s, 1000 );
+    assert( p_block != NULL && p_block->i_buffer == 1000 );
+    assert( !memcmp( p_block->p_buffer, &p_data[1000], 1000 ) );
+    memset( p_block->p_buffer, 0, p_block->i_buffer );
+
+    /* Before the block, while it is still alive */
+    assert( stream_Seek( s, 500 ) == VLC_SUCCESS );
+    assert( stream_Read( s, p_read, 2000 ) == 2000 );
+    assert( !memcmp( p_read, &p_data[500], 2000 ) );
+    block_Release( p_block );
+
+    /* Into the block, once it was released */
+    assert( stream_Seek( s, 1500 ) == VLC_SUCCESS );
+    assert( stream_Tell( s ) == 1500 );
+    assert( stream_Read( s, p_read, TEST_SIZE ) == TEST_SIZE - 1500 );
+    assert( !memcmp( p_read, &p_data[1500], TEST_SIZE - 1500 ) );
+
+    stream_Delete( s );
+    close( fds[0] );
+}
+
+int main( void )
+{
+    libvlc_instance_t *p_vlc;
+
+    test_init();
+
+    log( "Testing the stream cache\n" );
+    p_vlc = libvlc_new( test_defaults_nargs, test_defaults_args );
+    assert( p_vlc != NULL );
+
+    test_backward_seek( p_vlc->p_libvlc_int );
+
+    libvlc_release( p_vlc );
+
+    return 0;
+}
@@ -172,6 +172,7 @@ public class PlayerActivity extends Activity implements
 					if (mMediaPlayerLoaded)
 						mProgressBarPreparing.setVisibility(View.GONE);
 					startMediaPlayer();
+					updateStandbySources();
 					break;
 				}
 				case MEDIA_PLAYER_PROGRESS_UPDATE: {
@@ -386,6 +387,32 @@ public class PlayerActivity extends Activity implements
 		mMediaPlayer.release();
 	}
 
+	/* switch channel on the running player instead of recreating it */
+	protected void switchMediaPlayer(int offset) {
+		int count = mPlayListArray.size();
+		if (mMediaPlayer == null || count <= 1)
+			return;
+		mPlayListSelected = (mPlayListSelected + offset + count) % count;
+		mTime = -1;
+		mLength = -1;
+		mCanSeek = true;
+		mProgressBarPreparing.setVisibility(View.VISIBLE);
+		mMediaPlayer.switchSource(mPlayListArray.get(mPlayListSelected));
+		updateStandbySources();
+	}
+
+	/* keep the next and previous channels tuned in the background */
+	protected void updateStandbySources() {
+		int count = mPlayListArray.size();
+		if (mMediaPlayer == null || count <= 1)
+			return;
+		int next = (mPlayListSelected + 1) % count;
+		int previous = (mPlayListSelected + count - 1) % count;
+		mMediaPlayer.setStandbySource(0, mPlayListArray.get(next));
+		mMediaPlayer.setStandbySource(1,
+				previous != next ? mPlayListArray.get(previous) : null);
+	}
+
 	protected void startMediaPlayer() {
 		if (mMediaPlayerStarted || !mMediaPlayerLoaded)
 			return;
@@ -578,7 +605,7 @@ public class PlayerActivity extends Activity implements
 			break;
 		}
 		case R.id.player_button_previous: {
-
+			switchMediaPlayer(-1);
 			break;
 		}
 		case R.id.player_button_toggle_play: {
@@ -598,6 +625,7 @@ public class PlayerActivity extends Activity implements
 			break;
 		}
 		case R.id.player_button_next: {
+			switchMediaPlayer(1);
 			break;
 		}
 		case R.id.player_button_switch_aspect_ratio: {
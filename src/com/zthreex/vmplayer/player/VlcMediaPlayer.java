@@ -1,7 +1,12 @@
 package com.zthreex.vmplayer.player;
 
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+
 import android.graphics.PixelFormat;
 import android.media.MediaPlayer;
+import android.os.Handler;
+import android.os.Looper;
 import android.util.Log;
 import android.view.Surface;
 import android.view.SurfaceHolder;
@@ -26,6 +31,20 @@ public class VlcMediaPlayer extends AbsMediaPlayer {
 	/* */
 	private int mTime = -1;
 	private static  Boolean bIsOpenFaild = false;
+
+	/* events are fetched from native side in batches, see nativePollEvents() */
+	private static final int EVENT_SIZE = 24;
+	private static final int EVENT_POLL_DELAY = 16;
+	private final Handler mEventHandler = new Handler(Looper.getMainLooper());
+	private final VlcEvent mEvent = new VlcEvent();
+	private ByteBuffer mEventBuffer = null;
+	private boolean mReleased = false;
+	private final Runnable mEventPoller = new Runnable() {
+		@Override
+		public void run() {
+			pollVlcEvents();
+		}
+	};
 	
 	/*  */
 	protected native void nativeAttachSurface(Surface s);
@@ -59,6 +78,12 @@ public class VlcMediaPlayer extends AbsMediaPlayer {
 
 	protected native void nativeSetDataSource(String path);
 
+	protected native void nativeSwitchSource(String path);
+
+	protected native void nativeSetStandbySource(int slot, String path);
+
+	protected native void nativeSetViewSource(VlcMediaPlayer source, int program);
+
 	protected native void nativeSetLooping(boolean looping);
 
 	protected native void nativeStart();
@@ -66,6 +91,10 @@ public class VlcMediaPlayer extends AbsMediaPlayer {
 	protected native void nativeStop();
 	
 	protected native static int  nativeIsTotallyRemoved();
+
+	protected native ByteBuffer nativeGetEventBuffer();
+
+	protected native int nativePollEvents();
 	
 	@SuppressWarnings("unused")
 	private class VlcEvent {
@@ -94,18 +123,39 @@ public class VlcMediaPlayer extends AbsMediaPlayer {
 		public final static int MediaPlayerTitleChanged = 271;
 		public final static int MediaPlayerSnapshotTaken = 272;
 		public final static int MediaPlayerLengthChanged = 273;
+		/* intValue events were lost, the native queue was full */
+		public final static int EventsDropped = 4096;
 		/* the variables we received */
 		public int eventType = -1;
 		public boolean booleanValue = false;
 		public int intValue = -1;
 		public long longValue = -1;
 		public float floatValue = -1.0f;
-		public String stringValue = null;
 	}
 
-	/* called by native side */
+	/* called by native side, from any thread, when events are queued */
+	private void onVlcEventsPending() {
+		mEventHandler.postDelayed(mEventPoller, EVENT_POLL_DELAY);
+	}
+
+	private void pollVlcEvents() {
+		if (mReleased)
+			return;
+		int count = nativePollEvents();
+		for (int i = 0; i < count; i++) {
+			int offset = i * EVENT_SIZE;
+			mEvent.eventType = mEventBuffer.getInt(offset);
+			mEvent.intValue = mEventBuffer.getInt(offset + 4);
+			mEvent.booleanValue = mEvent.intValue > 0;
+			mEvent.longValue = mEventBuffer.getLong(offset + 8);
+			mEvent.floatValue = mEventBuffer.getFloat(offset + 16);
+			onVlcEvent(mEvent);
+			if (mReleased)
+				return;
+		}
+	}
+
 	private void onVlcEvent(VlcEvent ev) {
-		Log.d(LOGTAG, String.format("received vlc event %d", ev.eventType));
 		switch (ev.eventType) {
 		case VlcEvent.MediaParsedChanged: {
 			if (!ev.booleanValue) {
@@ -178,6 +228,10 @@ public class VlcMediaPlayer extends AbsMediaPlayer {
 			}
 			break;
 		}
+		case VlcEvent.EventsDropped: {
+			Log.w("vmplayer", ev.intValue + " events dropped");
+			break;
+		}
 		}
 	}
 
@@ -187,6 +241,7 @@ public class VlcMediaPlayer extends AbsMediaPlayer {
 
 	protected VlcMediaPlayer() {
 		nativeCreate();
+		mEventBuffer = nativeGetEventBuffer().order(ByteOrder.nativeOrder());
 		bIsOpenFaild = false;
 	}
 	
@@ -252,6 +307,8 @@ public class VlcMediaPlayer extends AbsMediaPlayer {
 
 	@Override
 	public void release() {
+		mReleased = true;
+		mEventHandler.removeCallbacks(mEventPoller);
 		nativeRelease();
 	}
 
@@ -270,6 +327,35 @@ public class VlcMediaPlayer extends AbsMediaPlayer {
 		nativeSetDataSource(path);
 	}
 
+	/*
+	 * Switch to another source without releasing the player, the video
+	 * output and the audio output are reused by the new source.
+	 */
+	public void switchSource(String path) {
+		mTime = -1;
+		nativeSwitchSource(path);
+	}
+
+	/*
+	 * Keep a source connected in the background (slot 0 or 1) so that
+	 * switching to it later does not wait for connection and keyframe.
+	 */
+	public void setStandbySource(int slot, String path) {
+		nativeSetStandbySource(slot, path);
+	}
+
+	/*
+	 * Play one program of the stream played by another player, without
+	 * reading it again. That player stops showing the program itself.
+	 * Throws IllegalStateException if the source is not playing; a program
+	 * the source cannot hand over is reported by an error event.
+	 */
+	public void setViewSource(VlcMediaPlayer source, int program)
+			throws IllegalStateException {
+		mTime = -1;
+		nativeSetViewSource(source, program);
+	}
+
 	@Override
 	public void setDisplay(SurfaceHolder holder) {
 		if (holder != null) {